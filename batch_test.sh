@@ -0,0 +1,39 @@
+#!/bin/bash
+# Sprawdza tryb --batch: uruchamia calc_poly --batch na katalogu skryptów
+# i porównuje każdy plik .out i .err z wynikiem calc_poly < skrypt.
+if [ "$#" -ne 1 ]; then
+	echo "Wrong number of parameters";
+	exit 1;
+fi
+if [ ! -x "$1" ]; then
+	echo "Wrong first argument";
+	exit 1;
+fi
+calc="$1";
+dir=$(mktemp -d);
+trap 'rm -rf "$dir"' EXIT;
+mkdir "$dir/scripts" "$dir/out" "$dir/expected";
+printf '(1,1)+(1,0)\nCLONE\nMUL\nPRINT\nDEG\n' > "$dir/scripts/square";
+printf '((1,1),2)+(3,0)\nAT 2\nPRINT\n(2,1)\nCOMPOSE 1\nPRINT\n' > "$dir/scripts/nested";
+printf '(1,2)\nADD\nPOP\nPOP\nIS_ZERO\nWRONG\nDEG_BY x\n(1,1\nPRINT\n' > "$dir/scripts/errors";
+: > "$dir/scripts/empty";
+if ! "$calc" --batch "$dir/scripts" --jobs 2 --out "$dir/out"; then
+	echo "calc_poly --batch failed";
+	exit 1;
+fi
+if [ ! -s "$dir/out/errors.err" ]; then
+	echo "errors.err is empty";
+	exit 1;
+fi
+status=0;
+for f in "$dir/scripts/"*; do
+	name=$(basename "$f");
+	"$calc" < "$f" > "$dir/expected/$name.out" 2> "$dir/expected/$name.err";
+	for ext in out err; do
+		if ! cmp -s "$dir/expected/$name.$ext" "$dir/out/$name.$ext"; then
+			echo "$name.$ext differs from calc_poly < $name";
+			status=1;
+		fi
+	done
+done
+exit $status;
@@ -0,0 +1,241 @@
+/** @file
+  Tryb wsadowy kalkulatora wielomianów.
+  @author Aleksandra Grzyb
+  @copyright Uniwersytet Warszawski
+  @date 2017-05-20
+  */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "batch.h"
+#include "utils.h"
+#define OUT_SUFFIX ".out" ///<rozszerzenie pliku z wyjściem skryptu
+#define ERR_SUFFIX ".err" ///<rozszerzenie pliku z błędami skryptu
+#define MAX_PATH_LENGTH 4096 ///<maksymalna długość ścieżki
+#define LIST_BEG 16 ///<początkowy rozmiar listy plików
+
+/**
+ *Struktura przechowująca pliki do wykonania.
+ *Zbudowana na rosnącej tablicy.
+ **/
+typedef struct FileList {
+	char **names;///<ścieżki plików
+	unsigned size;///<liczba plików
+	unsigned capacity;///<rozmiar tablicy
+} FileList;
+
+/**
+ *Dodaje plik na koniec listy
+ *@param[in] files : lista plików
+ *@param[in] name : ścieżka pliku
+ *@param[in] length : długość ścieżki
+ */
+static void AddFile(FileList *files, const char *name, size_t length) {
+	if (files->size == files->capacity) {
+		files->capacity = files->capacity == 0 ? LIST_BEG : 2 * files->capacity;
+		files->names = (char **)realloc(files->names, files->capacity * sizeof(char *));
+		assert(files->names != NULL);
+	}
+	char *copy = (char *)malloc(length + 1);
+	assert(copy != NULL);
+	memcpy(copy, name, length);
+	copy[length] = '\0';
+	files->names[files->size++] = copy;
+}
+
+/**
+ *Usuwa listę plików
+ *@param[in] files : lista plików
+ */
+static void DestroyFileList(FileList *files) {
+	for (unsigned i = 0 ; i < files->size ; i++)
+		free(files->names[i]);
+	free(files->names);
+}
+
+/**
+ *Sprawdza, czy napis kończy się zadanym sufiksem
+ *@param[in] str : napis
+ *@param[in] suffix : sufiks
+ *@return true jeśli @p str kończy się na @p suffix, false w przeciwnym razie
+ */
+static bool HasSuffix(const char *str, const char *suffix) {
+	size_t length = strlen(str);
+	size_t suffixLength = strlen(suffix);
+	return length >= suffixLength && strcmp(str + length - suffixLength, suffix) == 0;
+}
+
+/**
+ *Porównuje leksykograficznie dwie ścieżki
+ *@param[in] a : pierwsza ścieżka
+ *@param[in] b : druga ścieżka
+ *@return wynik strcmp na ścieżkach
+ */
+static int CompareNames(const void *a, const void *b) {
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/**
+ *Wczytuje zwykłe pliki z katalogu, pomijając pliki wynikowe
+ *@param[in] path : katalog
+ *@param[in] files : lista, do której trafią pliki
+ *@return true jeśli katalog udało się przeczytać, false w przeciwnym razie
+ */
+static bool ReadDirectory(const char *path, FileList *files) {
+	DIR *dir = opendir(path);
+	if (dir == NULL)
+		return false;
+	char name[MAX_PATH_LENGTH];
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL) {
+		struct stat info;
+		int length = snprintf(name, sizeof(name), "%s/%s", path, entry->d_name);
+		if (length < 0 || (size_t)length >= sizeof(name))
+			continue;
+		if (stat(name, &info) == 0 && S_ISREG(info.st_mode)
+				&& !HasSuffix(name, OUT_SUFFIX) && !HasSuffix(name, ERR_SUFFIX))
+			AddFile(files, name, (size_t)length);
+	}
+	closedir(dir);
+	qsort(files->names, files->size, sizeof(char *), CompareNames);
+	return true;
+}
+
+/**
+ *Wczytuje listę plików, po jednej ścieżce w linii
+ *@param[in] path : plik z listą
+ *@param[in] files : lista, do której trafią pliki
+ *@return true jeśli listę udało się przeczytać, false w przeciwnym razie
+ */
+static bool ReadFileList(const char *path, FileList *files) {
+	FILE *list = fopen(path, "r");
+	if (list == NULL)
+		return false;
+	char name[MAX_PATH_LENGTH];
+	while (fgets(name, sizeof(name), list) != NULL) {
+		size_t length = strcspn(name, "\r\n");
+		if (length > 0)
+			AddFile(files, name, length);
+	}
+	fclose(list);
+	return true;
+}
+
+/**
+ *Tworzy nazwę pliku wynikowego
+ *@param[in] result : miejsce na nazwę
+ *@param[in] file : plik ze skryptem
+ *@param[in] outDir : katalog na pliki wynikowe lub NULL
+ *@param[in] suffix : rozszerzenie pliku wynikowego
+ *@return true jeśli nazwa zmieściła się w buforze, false w przeciwnym razie
+ */
+static bool OutputName(char *result, const char *file, const char *outDir, const char *suffix) {
+	int length;
+	if (outDir != NULL) {
+		const char *slash = strrchr(file, '/');
+		length = snprintf(result, MAX_PATH_LENGTH, "%s/%s%s", outDir, slash != NULL ? slash + 1 : file, suffix);
+	}
+	else length = snprintf(result, MAX_PATH_LENGTH, "%s%s", file, suffix);
+	return length >= 0 && length < MAX_PATH_LENGTH;
+}
+
+/**
+ *Wykonuje skrypt z pliku w procesie potomnym i kończy ten proces
+ *@param[in] file : plik ze skryptem
+ *@param[in] outDir : katalog na pliki wynikowe lub NULL
+ *@param[in] script : funkcja wykonująca skrypt
+ */
+static void RunFile(const char *file, const char *outDir, BatchScript script) {
+	char out[MAX_PATH_LENGTH];
+	char err[MAX_PATH_LENGTH];
+	if (!OutputName(out, file, outDir, OUT_SUFFIX) || !OutputName(err, file, outDir, ERR_SUFFIX)
+			|| freopen(file, "r", stdin) == NULL || freopen(out, "w", stdout) == NULL
+			|| freopen(err, "w", stderr) == NULL)
+		_exit(EXIT_FAILURE);
+	exit(script());
+}
+
+/**
+ *Wypisuje błąd: nie udało się wykonać pliku
+ *@param[in] file : plik ze skryptem
+ */
+static void ErrBatch(const char *file) {
+	fprintf(stderr, "%s%s\n", "ERROR BATCH ", file);
+}
+
+int RunBatch(const char *path, const char *outDir, unsigned jobs, BatchScript script) {
+	FileList files = {NULL, 0, 0};
+	struct stat info;
+	if (stat(path, &info) != 0
+			|| !(S_ISDIR(info.st_mode) ? ReadDirectory(path, &files) : ReadFileList(path, &files))) {
+		ErrBatch(path);
+		DestroyFileList(&files);
+		return EXIT_FAILURE;
+	}
+	if (jobs == 0) {
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		jobs = online > 0 ? (unsigned)online : 1;
+	}
+	pid_t *workers = (pid_t *)calloc(jobs, sizeof(pid_t));
+	unsigned *running = (unsigned *)calloc(jobs, sizeof(unsigned));
+	if (workers == NULL || running == NULL) {
+		ErrBatch(path);
+		free(workers);
+		free(running);
+		DestroyFileList(&files);
+		return EXIT_FAILURE;
+	}
+	int result = EXIT_SUCCESS;
+	unsigned busy = 0;
+	unsigned next = 0;
+	/* Bufory dziedziczone przez proces potomny nie mogą zostać wypisane dwukrotnie. */
+	fflush(NULL);
+	while (next < files.size || busy > 0) {
+		if (next < files.size && busy < jobs) {
+			unsigned slot = 0;
+			while (workers[slot] != 0)
+				slot++;
+			pid_t pid = fork();
+			if (pid == 0)
+				RunFile(files.names[next], outDir, script);
+			if (pid < 0) {
+				ErrBatch(files.names[next]);
+				result = EXIT_FAILURE;
+			}
+			else {
+				workers[slot] = pid;
+				running[slot] = next;
+				busy++;
+			}
+			next++;
+		}
+		else {
+			int status;
+			pid_t pid = wait(&status);
+			if (pid < 0)
+				break;
+			for (unsigned slot = 0 ; slot < jobs ; slot++) {
+				if (workers[slot] == pid) {
+					if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+						ErrBatch(files.names[running[slot]]);
+						result = EXIT_FAILURE;
+					}
+					workers[slot] = 0;
+					busy--;
+				}
+			}
+		}
+	}
+	free(workers);
+	free(running);
+	DestroyFileList(&files);
+	return result;
+}
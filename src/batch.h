@@ -0,0 +1,37 @@
+/** @file
+   Interfejs trybu wsadowego kalkulatora wielomianów
+
+   @author Aleksandra Grzyb
+   @copyright Uniwersytet Warszawski
+   @date 2017-05-20
+*/
+
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+/**
+ * Funkcja wykonująca jeden skrypt kalkulatora.
+ * Czyta polecenia ze standardowego wejścia, a wyniki i błędy wypisuje
+ * na standardowe wyjście i standardowe wyjście błędów.
+ * @return kod wyjścia skryptu
+ */
+typedef int (*BatchScript)(void);
+
+/**
+ * Wykonuje skrypty z wielu niezależnych plików.
+ * Jeśli @p path jest katalogiem, wykonywane są wszystkie zwykłe pliki
+ * w nim leżące (poza plikami wynikowymi `.out` i `.err`), w przeciwnym razie
+ * @p path jest listą plików, po jednej ścieżce w linii.
+ * Każdy plik jest wykonywany w osobnym procesie z własnym stosem, co najwyżej
+ * @p jobs plików naraz. Wyjście pliku `f` trafia do `f.out`, a błędy do `f.err`
+ * (w katalogu @p outDir, jeśli jest podany) i jest identyczne z wynikiem
+ * sekwencyjnego uruchomienia kalkulatora na tym pliku.
+ * @param[in] path : katalog lub lista plików
+ * @param[in] outDir : katalog na pliki wynikowe lub NULL
+ * @param[in] jobs : maksymalna liczba równocześnie wykonywanych plików
+ * @param[in] script : funkcja wykonująca jeden skrypt
+ * @return 0 jeśli wszystkie pliki zostały wykonane, 1 w przeciwnym razie
+ */
+int RunBatch(const char *path, const char *outDir, unsigned jobs, BatchScript script);
+
+#endif /* __BATCH_H__ */
@@ -0,0 +1,535 @@
+/** @file
+  Mikrobenchmarki operacji na wielomianach.
+  Wynik jest wypisywany jako tabela rozdzielana tabulatorami, po jednym
+  wierszu na benchmark, tak aby wyniki różnych wersji dało się porównać
+  zwykłym diffem.
+  @author Aleksandra Grzyb
+  @copyright Uniwersytet Warszawski
+  @date 2017-05-20
+  */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#define UTILS_H
+#include "poly.h"
+#include "packed.h"
+#define DEFAULT_SEED 2017 ///<domyślne ziarno generatora
+#define DEFAULT_MIN_TIME 200 ///<domyślny minimalny czas benchmarku w milisekundach
+#define EXP_POWER 3 ///<wykładnik w benchmarku PolyExp
+#define AT_POINT -1 ///<punkt w benchmarku PolyAt
+#define MAX_COEFF 9 ///<maksymalna wartość bezwzględna współczynnika
+#define NS_IN_MS 1000000.0 ///<liczba nanosekund w milisekundzie
+#define NS_IN_S 1000000000.0 ///<liczba nanosekund w sekundzie
+#define CONTEXT_LIMIT (16 << 20) ///<rozmiar kontekstu, po którego przekroczeniu benchmark go czyści
+
+extern Poly ReadPoly(int, int *, char *, bool *);
+extern void Print(Poly *);
+
+/** Liczba alokacji od początku programu */
+static unsigned long allocations = 0;
+
+/** Bufor, z którego czyta atrapa scanf */
+static char *input = NULL;
+static size_t input_position = 0; ///<pozycja czytania z bufora wejścia
+static size_t input_end = 0; ///<długość bufora wejścia
+
+/** Bufor, do którego pisze atrapa printf */
+static char *output = NULL;
+static size_t output_position = 0; ///<długość zapisanego wyjścia
+static size_t output_capacity = 0; ///<rozmiar bufora wyjścia
+
+void *bench_malloc(size_t size) {
+	allocations++;
+	return malloc(size);
+}
+
+void *bench_calloc(size_t number_of_elements, size_t size) {
+	allocations++;
+	return calloc(number_of_elements, size);
+}
+
+void *bench_realloc(void *ptr, size_t size) {
+	if (ptr == NULL)
+		allocations++;
+	return realloc(ptr, size);
+}
+
+/**
+ * Atrapa scanf. Kalkulator czyta wejście wyłącznie znak po znaku ("%c").
+ **/
+int bench_scanf(const char *format, ...) {
+	va_list args;
+	(void)format;
+	if (input_position >= input_end)
+		return EOF;
+	va_start(args, format);
+	*va_arg(args, char *) = input[input_position++];
+	va_end(args);
+	return 1;
+}
+
+int bench_printf(const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(NULL, 0, format, args);
+	va_end(args);
+	if (output_position + length + 1 > output_capacity) {
+		output_capacity = 2 * (output_position + length + 1);
+		output = realloc(output, output_capacity);
+		if (output == NULL)
+			abort();
+	}
+	va_start(args, format);
+	vsnprintf(output + output_position, output_capacity - output_position, format, args);
+	va_end(args);
+	output_position += length;
+	return length;
+}
+
+int bench_fprintf(FILE * const file, const char *format, ...) {
+	(void)file;
+	(void)format;
+	return 0;
+}
+
+/**
+ * Generator liczb pseudolosowych xorshift64*.
+ * Ten sam seed daje te same wielomiany na każdej platformie.
+ */
+typedef struct Random {
+	uint64_t state; ///<stan generatora
+} Random;
+
+/**
+ * Losuje kolejną liczbę.
+ * @param[in] r : generator
+ * @return 64 losowe bity
+ */
+static uint64_t NextRandom(Random *r) {
+	r->state ^= r->state >> 12;
+	r->state ^= r->state << 25;
+	r->state ^= r->state >> 27;
+	return r->state * 2685821657736338717ULL;
+}
+
+/**
+ * Losuje liczbę z przedziału [@p lo, @p hi].
+ * @param[in] r : generator
+ * @param[in] lo : dolne ograniczenie
+ * @param[in] hi : górne ograniczenie
+ * @return losowa liczba
+ */
+static long RandomRange(Random *r, long lo, long hi) {
+	return lo + (long)(NextRandom(r) % (uint64_t)(hi - lo + 1));
+}
+
+/**
+ * Opis kształtu losowanych wielomianów.
+ * Najwyższy poziom ma tyle jednomianów, ile wynosi rozmiar benchmarku,
+ * zagnieżdżone poziomy mają ich po @p terms.
+ */
+typedef struct Shape {
+	const char *name; ///<nazwa kształtu
+	unsigned depth; ///<liczba zmiennych
+	unsigned terms; ///<liczba jednomianów na zagnieżdżonych poziomach
+	bool dense; ///<czy najwyższy poziom ma wszystkie wykładniki od 0
+	poly_exp_t spread; ///<średni odstęp między wykładnikami
+	unsigned maxSize; ///<największy rozmiar, na którym jest uruchamiany
+} Shape;
+
+/** Kształty wielomianów, na których uruchamiane są benchmarki */
+static const Shape shapes[] = {
+	{"sparse", 3, 2, false, 16, 64},
+	{"dense", 1, 0, true, 1, 1024},
+	{"deep", 4, 2, false, 2, 64},
+	{"wide", 2, 8, false, 2, 64},
+};
+
+/** Rozmiary, na których uruchamiane są benchmarki */
+static const unsigned sizes[] = {4, 16, 64, 1024};
+
+/**
+ * Losuje wielomian zadanego kształtu.
+ * Współczynniki jednomianów są niezerowe.
+ * @param[in] r : generator
+ * @param[in] shape : kształt
+ * @param[in] depth : liczba pozostałych zmiennych
+ * @param[in] terms : liczba jednomianów na tym poziomie
+ * @param[in] dense : czy brać wszystkie wykładniki od 0
+ * @return wylosowany wielomian
+ */
+static Poly RandomPoly(Random *r, const Shape *shape, unsigned depth, unsigned terms, bool dense) {
+	if (depth == 0) {
+		long c = RandomRange(r, 1, MAX_COEFF);
+		return PolyFromCoeff(NextRandom(r) % 2 ? c : -c);
+	}
+	Mono *monos = malloc(terms * sizeof(Mono));
+	if (monos == NULL)
+		abort();
+	poly_exp_t range = shape->spread * (poly_exp_t)terms;
+	for (unsigned i = 0 ; i < terms ; i++) {
+		Poly p = RandomPoly(r, shape, depth - 1, shape->terms, false);
+		/* PolyAddMonos nie przyjmuje jednomianów o zerowym współczynniku. */
+		if (PolyIsZero(&p))
+			p = PolyFromCoeff(1);
+		monos[i] = MonoFromPoly(&p, dense ? (poly_exp_t)i : (poly_exp_t)RandomRange(r, 0, range));
+	}
+	Poly result = PolyAddMonos(terms, monos);
+	free(monos);
+	return result;
+}
+
+/**
+ * Liczy jednomiany o stałych współczynnikach w rozwiniętym wielomianie.
+ * @param[in] p : wielomian
+ * @return liczba wyrazów wielomianu
+ */
+static unsigned long CountTerms(const Poly *p) {
+	if (PolyIsCoeff(p))
+		return p->coef != 0;
+	unsigned long result = p->coef != 0;
+	for (List *l = p->monos ; l != NULL ; l = l->next)
+		result += CountTerms(&(l->value.p));
+	return result;
+}
+
+/**
+ * Argumenty benchmarkowanej operacji.
+ */
+typedef struct Operands {
+	Poly a; ///<pierwszy argument
+	Poly b; ///<drugi argument
+	Poly aClone; ///<kopia pierwszego argumentu
+	Poly *x; ///<wielomiany podstawiane w PolyCompose
+	Poly *y; ///<dwumiany podstawiane w PolyCompose
+	unsigned count; ///<liczba podstawianych wielomianów
+	char *text; ///<tekstowa postać pierwszego argumentu
+	size_t textLength; ///<długość tekstowej postaci
+	PackedPoly packedA; ///<pierwszy argument w postaci upakowanej
+	PackedPoly packedB; ///<drugi argument w postaci upakowanej
+	PackedPoly packedAClone; ///<kopia pierwszego argumentu w postaci upakowanej
+	PolyContext *context; ///<kontekst, w którym liczą warianty z przyrostkiem Ctx
+	poly_exp_t half; ///<połowa stopnia iloczynu argumentów, ograniczenie stopnia w PolyMulTrunc
+	poly_coeff_t *points; ///<punkty w PolyMultiAt
+	Poly *values; ///<miejsce na wartości w PolyMultiAt
+	unsigned pointCount; ///<liczba punktów w PolyMultiAt, równa rozmiarowi
+} Operands;
+
+static Poly BenchAdd(Operands *o) {
+	return PolyAdd(&(o->a), &(o->b));
+}
+
+static Poly BenchMul(Operands *o) {
+	return PolyMul(&(o->a), &(o->b));
+}
+
+/**
+ * Mnoży w kontekście, czyszcząc go dopiero po uzbieraniu wielu wyników,
+ * więc czas zawiera zamortyzowany koszt zwolnienia ich naraz.
+ * @param[in] o : argumenty
+ * @return zero; wynik zostaje w kontekście
+ */
+static Poly BenchMulCtx(Operands *o) {
+	PolyMulCtx(o->context, &(o->a), &(o->b));
+	if (PolyContextBytes(o->context) > CONTEXT_LIMIT)
+		PolyContextReset(o->context);
+	return PolyZero();
+}
+
+static Poly BenchMulTrunc(Operands *o) {
+	return PolyMulTrunc(&(o->a), &(o->b), o->half);
+}
+
+static Poly BenchSqr(Operands *o) {
+	return PolySqr(&(o->a));
+}
+
+static Poly BenchExp(Operands *o) {
+	return PolyExp(&(o->a), EXP_POWER);
+}
+
+static Poly BenchCompose(Operands *o) {
+	return PolyCompose(&(o->a), o->count, o->x);
+}
+
+static Poly BenchComposeBinomial(Operands *o) {
+	return PolyCompose(&(o->a), o->count, o->y);
+}
+
+static Poly BenchAt(Operands *o) {
+	return PolyAt(&(o->a), AT_POINT);
+}
+
+/**
+ * Liczy wartości w tylu punktach, ile wynosi rozmiar.
+ * @param[in] o : argumenty
+ * @return zero; wartości są od razu usuwane
+ */
+static Poly BenchMultiAt(Operands *o) {
+	PolyMultiAt(&(o->a), o->pointCount, o->points, o->values);
+	for (unsigned i = 0 ; i < o->pointCount ; i++)
+		PolyDestroy(&(o->values[i]));
+	return PolyZero();
+}
+
+static Poly BenchClone(Operands *o) {
+	return PolyClone(&(o->a));
+}
+
+static Poly BenchIsEq(Operands *o) {
+	return PolyFromCoeff(PolyIsEq(&(o->a), &(o->aClone)));
+}
+
+static Poly BenchParse(Operands *o) {
+	int number = 1;
+	bool proper = true;
+	char c;
+	input = o->text;
+	input_position = 0;
+	input_end = o->textLength;
+	bench_scanf("%c", &c);
+	return ReadPoly(1, &number, &c, &proper);
+}
+
+static Poly BenchPrint(Operands *o) {
+	output_position = 0;
+	Print(&(o->a));
+	return PolyZero();
+}
+
+/**
+ * Zamienia wynik operacji na wielomianach upakowanych na liczbę jego wyrazów.
+ * @param[in] p : wynik
+ * @return liczba wyrazów jako współczynnik
+ */
+static Poly PackedResult(PackedPoly p) {
+	Poly result = PolyFromCoeff((poly_coeff_t)p.size);
+	PackedDestroy(&p);
+	return result;
+}
+
+static Poly BenchPackedAdd(Operands *o) {
+	return PackedResult(PackedAdd(&(o->packedA), &(o->packedB)));
+}
+
+static Poly BenchPackedMul(Operands *o) {
+	return PackedResult(PackedMul(&(o->packedA), &(o->packedB)));
+}
+
+static Poly BenchPackedAt(Operands *o) {
+	return PackedResult(PackedAt(&(o->packedA), AT_POINT));
+}
+
+static Poly BenchPackedIsEq(Operands *o) {
+	return PolyFromCoeff(PackedIsEq(&(o->packedA), &(o->packedAClone)));
+}
+
+static Poly BenchPackedFrom(Operands *o) {
+	return PackedResult(PackedFromPoly(&(o->a)));
+}
+
+static Poly BenchPackedTo(Operands *o) {
+	return PackedToPoly(&(o->packedA));
+}
+
+/**
+ * Opis benchmarku.
+ */
+typedef struct Benchmark {
+	const char *name; ///<nazwa benchmarku
+	Poly (*op)(Operands *); ///<mierzona operacja
+	unsigned maxSize; ///<największy rozmiar, na którym jest uruchamiany
+	bool inputTerms; ///<czy liczyć wyrazy argumentu zamiast wyniku
+	bool packed; ///<czy operacja zwraca liczbę wyrazów wyniku upakowanego
+} Benchmark;
+
+/** Wszystkie benchmarki */
+static const Benchmark benchmarks[] = {
+	{"PolyAdd", BenchAdd, 1024, false, false},
+	{"PolyMul", BenchMul, 1024, false, false},
+	{"PolyMulCtx", BenchMulCtx, 1024, true, false},
+	{"PolyMulTrunc", BenchMulTrunc, 1024, false, false},
+	{"PolySqr", BenchSqr, 1024, false, false},
+	{"PolyExp", BenchExp, 16, false, false},
+	{"PolyCompose", BenchCompose, 16, false, false},
+	{"PolyComposeBinomial", BenchComposeBinomial, 16, false, false},
+	{"PolyAt", BenchAt, 1024, false, false},
+	{"PolyMultiAt", BenchMultiAt, 1024, true, false},
+	{"PolyClone", BenchClone, 64, false, false},
+	{"PolyIsEq", BenchIsEq, 64, true, false},
+	{"parse", BenchParse, 64, true, false},
+	{"print", BenchPrint, 64, true, false},
+	{"PackedAdd", BenchPackedAdd, 64, false, true},
+	{"PackedMul", BenchPackedMul, 64, false, true},
+	{"PackedAt", BenchPackedAt, 64, false, true},
+	{"PackedIsEq", BenchPackedIsEq, 64, true, false},
+	{"PackedFromPoly", BenchPackedFrom, 64, false, true},
+	{"PackedToPoly", BenchPackedTo, 64, false, false},
+};
+
+/**
+ * Losuje argumenty benchmarku.
+ * @param[in] r : generator
+ * @param[in] shape : kształt wielomianów
+ * @param[in] size : rozmiar
+ * @return argumenty
+ */
+static Operands NewOperands(Random *r, const Shape *shape, unsigned size) {
+	Operands o;
+	o.a = RandomPoly(r, shape, shape->depth, size, shape->dense);
+	o.b = RandomPoly(r, shape, shape->depth, size, shape->dense);
+	o.aClone = PolyClone(&(o.a));
+	o.packedA = PackedFromPoly(&(o.a));
+	o.packedB = PackedFromPoly(&(o.b));
+	o.packedAClone = PackedFromPoly(&(o.aClone));
+	o.context = PolyContextNew();
+	o.half = (PolyDeg(&(o.a)) + PolyDeg(&(o.b))) / 2;
+	o.count = shape->depth;
+	o.x = malloc(o.count * sizeof(Poly));
+	o.y = malloc(o.count * sizeof(Poly));
+	o.pointCount = size;
+	o.points = malloc(size * sizeof(poly_coeff_t));
+	o.values = malloc(size * sizeof(Poly));
+	if (o.x == NULL || o.y == NULL || o.points == NULL || o.values == NULL)
+		abort();
+	for (unsigned i = 0 ; i < size ; i++)
+		o.points[i] = (poly_coeff_t)NextRandom(r);
+	/* Podstawiamy `±x` i `1 ± x`, żeby współczynniki wyniku nie przekroczyły zakresu. */
+	for (unsigned i = 0 ; i < o.count ; i++) {
+		Poly c = PolyFromCoeff(NextRandom(r) % 2 ? 1 : -1);
+		Mono m = MonoFromPoly(&c, 1);
+		o.x[i] = PolyAddMonos(1, &m);
+		Poly one = PolyFromCoeff(1);
+		o.y[i] = PolyAdd(&(o.x[i]), &one);
+	}
+	Poly text = PolyClone(&(o.a));
+	output_position = 0;
+	Print(&text);
+	bench_printf("\n");
+	PolyDestroy(&text);
+	o.text = malloc(output_position + 1);
+	if (o.text == NULL)
+		abort();
+	memcpy(o.text, output, output_position + 1);
+	o.textLength = output_position;
+	return o;
+}
+
+/**
+ * Usuwa argumenty benchmarku.
+ * @param[in] o : argumenty
+ */
+static void DestroyOperands(Operands *o) {
+	PolyDestroy(&(o->a));
+	PolyDestroy(&(o->b));
+	PolyDestroy(&(o->aClone));
+	PackedDestroy(&(o->packedA));
+	PackedDestroy(&(o->packedB));
+	PackedDestroy(&(o->packedAClone));
+	for (unsigned i = 0 ; i < o->count ; i++) {
+		PolyDestroy(&(o->x[i]));
+		PolyDestroy(&(o->y[i]));
+	}
+	free(o->x);
+	free(o->y);
+	free(o->points);
+	free(o->values);
+	free(o->text);
+	PolyContextDestroy(o->context);
+}
+
+/**
+ * Zwraca bieżący czas monotoniczny.
+ * @return czas w nanosekundach
+ */
+static double Now() {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * NS_IN_S + t.tv_nsec;
+}
+
+/**
+ * Uruchamia jeden benchmark i wypisuje wiersz z wynikiem.
+ * Czas operacji obejmuje usunięcie jej wyniku.
+ * @param[in] b : benchmark
+ * @param[in] shape : kształt wielomianów
+ * @param[in] size : rozmiar
+ * @param[in] seed : ziarno generatora
+ * @param[in] minTime : minimalny czas pomiaru w nanosekundach
+ */
+static void RunBenchmark(const Benchmark *b, const Shape *shape, unsigned size, uint64_t seed, double minTime) {
+	Random r = {seed * 2654435761ULL + size + 1};
+	Operands o = NewOperands(&r, shape, size);
+	unsigned long terms = b->inputTerms ? CountTerms(&(o.a)) : 0;
+	unsigned long iterations = 0;
+	unsigned long allocationsBefore = allocations;
+	double start = Now();
+	double elapsed = 0;
+	do {
+		Poly result = b->op(&o);
+		if (!b->inputTerms && iterations == 0)
+			terms = b->packed ? (unsigned long)result.coef : CountTerms(&result);
+		PolyDestroy(&result);
+		iterations++;
+		elapsed = Now() - start;
+	} while (elapsed < minTime);
+	double nsPerOp = elapsed / iterations;
+	printf("%s\t%s\t%u\t%llu\t%lu\t%.1f\t%lu\t%.0f\t%.2f\n", b->name, shape->name, size,
+			(unsigned long long)seed, iterations, nsPerOp, terms, terms * NS_IN_S / nsPerOp,
+			(double)(allocations - allocationsBefore) / iterations);
+	fflush(stdout);
+	DestroyOperands(&o);
+}
+
+/** Nazwy sposobów mnożenia dla opcji --strategy, w kolejności @ref MulStrategy */
+static const char *const strategies[] = {"auto", "schoolbook", "dense", "hash"};
+
+/**
+ * Ustawia sposób mnożenia o zadanej nazwie.
+ * @param[in] name : nazwa sposobu
+ * @return czy nazwa jest poprawna
+ */
+static bool SetStrategy(const char *name) {
+	for (unsigned i = 0 ; i < sizeof(strategies) / sizeof(strategies[0]) ; i++)
+		if (strcmp(name, strategies[i]) == 0) {
+			PolyMulSetStrategy((MulStrategy)i);
+			return true;
+		}
+	return false;
+}
+
+int main(int argc, char *argv[]) {
+	uint64_t seed = DEFAULT_SEED;
+	double minTime = DEFAULT_MIN_TIME;
+	const char *filter = NULL;
+	for (int i = 1 ; i < argc ; i++) {
+		if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = strtoull(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+			minTime = strtod(argv[++i], NULL);
+		else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+			filter = argv[++i];
+		else if (strcmp(argv[i], "--strategy") == 0 && i + 1 < argc && SetStrategy(argv[i + 1]))
+			i++;
+		else {
+			fprintf(stderr, "usage: %s [--seed N] [--min-time MS] [--filter NAME]"
+					" [--strategy auto|schoolbook|dense|hash]\n", argv[0]);
+			return 1;
+		}
+	}
+	printf("benchmark\tshape\tsize\tseed\titerations\tns_per_op\tterms_per_op\tterms_per_s\tallocs_per_op\n");
+	for (size_t i = 0 ; i < sizeof(benchmarks) / sizeof(benchmarks[0]) ; i++) {
+		if (filter != NULL && strstr(benchmarks[i].name, filter) == NULL)
+			continue;
+		for (size_t j = 0 ; j < sizeof(shapes) / sizeof(shapes[0]) ; j++)
+			for (size_t k = 0 ; k < sizeof(sizes) / sizeof(sizes[0]) ; k++)
+				if (sizes[k] <= benchmarks[i].maxSize && sizes[k] <= shapes[j].maxSize)
+					RunBenchmark(&benchmarks[i], &shapes[j], sizes[k], seed, minTime * NS_IN_MS);
+	}
+	free(output);
+	return 0;
+}
@@ -0,0 +1,265 @@
+/** @file
+  Ograniczenia zasobów obliczeń na wielomianach i szacowanie rozmiaru
+  ich wyników. Ograniczenia są ustawiane osobno w każdym wątku, a obliczenia
+  sprawdzają je same, więc przerwanie obliczenia niczego nie gubi: każda
+  funkcja kończy się szybko i zwalnia swoje wielomiany pomocnicze.
+  @author Aleksandra Grzyb
+  @copyright Uniwersytet Warszawski
+  @date 2017-05-20
+  */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include "budget.h"
+#include "memory.h"
+#include "stats.h"
+#include "utils.h"
+#define BUDGET_CLOCK_PERIOD 64 ///<co ile sprawdzeń ograniczeń odczytywany jest zegar
+#define NS_IN_MS 1000000 ///<liczba nanosekund w milisekundzie
+#define COST_SATURATED 1.8e19 ///<oszacowania od tej wartości są zastępowane przez UINT64_MAX
+
+static _Thread_local Budget budget; ///<ograniczenia obliczenia bieżącego wątku
+static _Thread_local bool budgetActive = false; ///<czy bieżący wątek liczy z ograniczeniami
+static _Thread_local bool budgetExceeded = false; ///<czy obliczenie przekroczyło ograniczenia
+static _Thread_local size_t startBytes; ///<bilans bajtów wątku na początku obliczenia
+static _Thread_local size_t startNodes; ///<bilans węzłów wątku na początku obliczenia
+static _Thread_local uint64_t startNs; ///<czas początku obliczenia
+static _Thread_local unsigned checks; ///<liczba sprawdzeń od początku obliczenia
+
+void BudgetStart(const Budget *limit) {
+	budget = *limit;
+	budgetActive = limit->terms > 0 || limit->bytes > 0 || limit->ms > 0;
+	budgetExceeded = false;
+	MemThreadBalance(&startBytes, &startNodes);
+	startNs = StatsNow();
+	checks = 0;
+}
+
+/**
+ * Sprawdza, czy przyrost bilansu przekracza ograniczenie. Przyrost może być
+ * ujemny, gdy wątek zwolnił więcej, niż przydzielił.
+ * @param[in] start : bilans na początku obliczenia
+ * @param[in] now : bieżący bilans
+ * @param[in] extra : zużycie spoza bilansu
+ * @param[in] limit : ograniczenie lub 0
+ * @return czy ograniczenie jest przekroczone
+ */
+static bool Over(size_t start, size_t now, size_t extra, uint64_t limit) {
+	long used = (long)(now - start) + (long)extra;
+	return limit > 0 && used > 0 && (uint64_t)used > limit;
+}
+
+/**
+ * Sprawdza ograniczenia obliczenia bieżącego wątku.
+ * @param[in] terms : jednomiany spoza bilansu wątku
+ * @param[in] bytes : bajty spoza bilansu wątku
+ * @param[in] clock : czy sprawdzić też czas
+ * @return czy ograniczenie jest przekroczone
+ */
+static bool Exceeded(size_t terms, size_t bytes, bool clock) {
+	size_t nowBytes, nowNodes;
+	MemThreadBalance(&nowBytes, &nowNodes);
+	if (Over(startNodes, nowNodes, terms, budget.terms) || Over(startBytes, nowBytes, bytes, budget.bytes))
+		return true;
+	return clock && budget.ms > 0 && (StatsNow() - startNs) / NS_IN_MS >= budget.ms;
+}
+
+bool BudgetCheck(size_t terms, size_t bytes) {
+	if (!budgetActive || budgetExceeded)
+		return budgetExceeded;
+	budgetExceeded = Exceeded(terms, bytes, ++checks % BUDGET_CLOCK_PERIOD == 0);
+	return budgetExceeded;
+}
+
+bool BudgetStop(void) {
+	bool exceeded = budgetExceeded || (budgetActive && Exceeded(0, 0, true));
+	budgetActive = false;
+	budgetExceeded = false;
+	return exceeded;
+}
+
+/**
+ * Ogranicza oszacowanie do @ref COST_SATURATED, żeby iloczyny oszacowań
+ * nie stały się nieskończonością.
+ * @param[in] x : oszacowanie
+ * @return oszacowanie nie większe niż @ref COST_SATURATED
+ */
+static double Capped(double x) {
+	return x < COST_SATURATED ? x : COST_SATURATED;
+}
+
+/**
+ * Liczy wyrazy wielomianu po rozwinięciu, czyli niezerowe współczynniki
+ * liczbowe na wszystkich poziomach.
+ * @param[in] p : wielomian
+ * @return liczba wyrazów
+ */
+static double Leaves(const Poly *p) {
+	double result = p->coef != 0;
+	for (List *l = p->monos ; l != NULL ; l = l->next)
+		result += Leaves(&(l->value.p));
+	return result;
+}
+
+/**
+ * Liczy wybory @p e elementów z powtórzeniami spośród @p n, czyli
+ * `C(n + e - 1, e)`; tyle co najwyżej wyrazów ma e-ta potęga wielomianu
+ * o @p n wyrazach. Mnoży przez kolejne ilorazy od strony krótszego z dwóch
+ * równych rozwinięć symbolu Newtona, więc pętla szybko dochodzi do nasycenia.
+ * @param[in] n : liczba elementów
+ * @param[in] e : liczba wyborów
+ * @return liczba wyborów, najwyżej @ref COST_SATURATED
+ */
+static double Multiset(double n, poly_exp_t e) {
+	if (e == 0)
+		return 1;
+	if (n <= 1)
+		return n;
+	double low = (double)e < n - 1 ? (double)e : n - 1;
+	double high = (double)e + n - 1 - low;
+	double result = 1;
+	for (double i = 1 ; i <= low && result < COST_SATURATED ; i++)
+		result = Capped(result * (high + i) / i);
+	return result;
+}
+
+/**
+ * Zamienia oszacowanie wyrazów wyniku na oszacowanie jego rozmiaru.
+ * Jednomiany na poziomie k odpowiadają różnym początkom `x_0^a_0 ... x_k^a_k`
+ * wykładników wyrazów, więc na każdym poziomie jest ich nie więcej niż wyrazów
+ * i nie więcej, niż mieści się wykładników w stopniach pierwszych k + 1 zmiennych.
+ * @param[in] leaves : oszacowanie liczby wyrazów po rozwinięciu
+ * @param[in] depth : największa głębokość wyniku
+ * @param[in] degs : stopnie wyniku względem kolejnych zmiennych, @p depth liczb
+ * @return oszacowanie
+ */
+static BudgetCost Cost(double leaves, unsigned depth, const double degs[]) {
+	double terms = 0, box = 1;
+	for (unsigned var = 0 ; var < depth ; var++) {
+		box = Capped(box * (degs[var] + 1));
+		terms = Capped(terms + (box < leaves ? box : leaves));
+	}
+	BudgetCost cost = {.terms = UINT64_MAX, .bytes = UINT64_MAX};
+	if (terms >= COST_SATURATED)
+		return cost;
+	cost.terms = (uint64_t)terms + ((double)(uint64_t)terms < terms);
+	if ((double)cost.terms * sizeof(List) < COST_SATURATED)
+		cost.bytes = cost.terms * sizeof(List);
+	return cost;
+}
+
+/**
+ * Przydziela tablicę stopni wyniku.
+ * @param[in] depth : liczba zmiennych
+ * @return wyzerowana tablica co najmniej jednej liczby
+ */
+static double *NewDegs(unsigned depth) {
+	double *degs = (double *)calloc((size_t)depth + 1, sizeof(double));
+	assert(degs != NULL);
+	return degs;
+}
+
+BudgetCost BudgetMulCost(const Poly *p, const Poly *q) {
+	double bound = Capped(Leaves(p) * Leaves(q));
+	unsigned depthP = PolyDepth(p);
+	unsigned depthQ = PolyDepth(q);
+	unsigned depth = depthP > depthQ ? depthP : depthQ;
+	double *degs = NewDegs(depth);
+	double box = 1;
+	for (unsigned var = 0 ; var < depth ; var++) {
+		poly_exp_t degP = PolyDegBy(p, var), degQ = PolyDegBy(q, var);
+		degs[var] = (degP > 0 ? degP : 0) + (degQ > 0 ? degQ : 0);
+		box = Capped(box * (degs[var] + 1));
+	}
+	BudgetCost cost = Cost(box < bound ? box : bound, depth, degs);
+	free(degs);
+	return cost;
+}
+
+BudgetCost BudgetExpCost(const Poly *p, poly_exp_t e) {
+	unsigned depth = e == 0 ? 0 : PolyDepth(p);
+	double bound = Multiset(Leaves(p), e);
+	double *degs = NewDegs(depth);
+	double box = 1;
+	for (unsigned var = 0 ; var < depth ; var++) {
+		poly_exp_t deg = PolyDegBy(p, var);
+		degs[var] = Capped((double)(deg > 0 ? deg : 0) * e);
+		box = Capped(box * (degs[var] + 1));
+	}
+	BudgetCost cost = Cost(box < bound ? box : bound, depth, degs);
+	free(degs);
+	return cost;
+}
+
+/**
+ * Dane podstawianych wielomianów potrzebne do oszacowania wyniku podstawienia.
+ */
+typedef struct ComposeShape {
+	unsigned count; ///<liczba podstawianych wielomianów
+	unsigned depth; ///<największa głębokość podstawianych wielomianów
+	double *leaves; ///<liczby wyrazów podstawianych wielomianów
+	double *degs; ///<stopnie wielomianu i względem zmiennej v pod indeksem `i * depth + v`
+	double *bounds; ///<stopnie wyniku względem kolejnych zmiennych, osobno dla każdego poziomu
+} ComposeShape;
+
+/**
+ * Sumuje oszacowania wyrazów po podstawieniu po wyrazach wielomianu.
+ * Wyraz `c x_0^a_0 ... x_k^a_k` daje po podstawieniu co najwyżej tyle
+ * wyrazów, ile jest wyborów z powtórzeniami wyrazów kolejnych potęg,
+ * i nie więcej, niż mieści się wykładników w sumie stopni potęg.
+ * @param[in] p : współczynnik na poziomie zmiennej @p index
+ * @param[in] shape : podstawiane wielomiany
+ * @param[in] index : numer zmiennej
+ * @param[in] product : oszacowanie iloczynu potęg zmiennych poprzednich poziomów
+ * @return oszacowanie liczby wyrazów
+ */
+static double ComposeLeaves(const Poly *p, const ComposeShape *shape, unsigned index, double product) {
+	const double *bound = shape->bounds + (size_t)index * shape->depth;
+	double box = 1;
+	for (unsigned var = 0 ; var < shape->depth && box < product ; var++)
+		box = Capped(box * (bound[var] + 1));
+	if (index >= shape->count)
+		return box < product ? box : product;
+	double result = p->coef == 0 ? 0 : box < product ? box : product;
+	double *next = shape->bounds + ((size_t)index + 1) * shape->depth;
+	const double *degs = shape->degs + (size_t)index * shape->depth;
+	for (List *l = p->monos ; l != NULL ; l = l->next) {
+		for (unsigned var = 0 ; var < shape->depth ; var++)
+			next[var] = Capped(bound[var] + degs[var] * l->value.exp);
+		result = Capped(result + ComposeLeaves(&(l->value.p), shape, index + 1,
+				Capped(product * Multiset(shape->leaves[index], l->value.exp))));
+	}
+	return result;
+}
+
+BudgetCost BudgetComposeCost(const Poly *p, unsigned count, const Poly x[]) {
+	ComposeShape shape = {.count = count, .depth = 0};
+	for (unsigned i = 0 ; i < count ; i++) {
+		unsigned depth = PolyDepth(&(x[i]));
+		if (depth > shape.depth)
+			shape.depth = depth;
+	}
+	shape.leaves = (double *)calloc((size_t)count + 1, sizeof(double));
+	shape.degs = (double *)calloc(((size_t)count + 1) * shape.depth + 1, sizeof(double));
+	shape.bounds = (double *)calloc(((size_t)count + 1) * shape.depth + 1, sizeof(double));
+	assert(shape.leaves != NULL && shape.degs != NULL && shape.bounds != NULL);
+	double *degs = NewDegs(shape.depth);
+	for (unsigned i = 0 ; i < count ; i++) {
+		shape.leaves[i] = Leaves(&(x[i]));
+		poly_exp_t outer = PolyDegBy(p, i);
+		for (unsigned var = 0 ; var < shape.depth ; var++) {
+			poly_exp_t deg = PolyDegBy(&(x[i]), var);
+			shape.degs[(size_t)i * shape.depth + var] = deg > 0 ? deg : 0;
+			if (outer > 0 && deg > 0)
+				degs[var] = Capped(degs[var] + (double)outer * deg);
+		}
+	}
+	double bound = ComposeLeaves(p, &shape, 0, 1);
+	BudgetCost cost = Cost(bound, shape.depth, degs);
+	free(shape.leaves);
+	free(shape.degs);
+	free(shape.bounds);
+	free(degs);
+	return cost;
+}
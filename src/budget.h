@@ -0,0 +1,97 @@
+/** @file
+   Interfejs ograniczeń zasobów obliczeń na wielomianach i szacowania
+   rozmiaru ich wyników
+
+   @author Aleksandra Grzyb
+   @copyright Uniwersytet Warszawski
+   @date 2017-05-20
+*/
+
+#ifndef __BUDGET_H__
+#define __BUDGET_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "poly.h"
+
+/**
+ * Ograniczenia zasobów jednego obliczenia; zero oznacza brak ograniczenia.
+ * Jednomiany są liczone na wszystkich poziomach, czyli jak węzły
+ * w @ref MemoryUsage.
+ */
+typedef struct Budget {
+	uint64_t terms; ///<najwięcej jednomianów przydzielonych ponad zwolnione
+	uint64_t bytes; ///<najwięcej bajtów przydzielonych ponad zwolnione
+	uint64_t ms; ///<najdłuższy czas obliczenia w milisekundach
+} Budget;
+
+/**
+ * Oszacowanie rozmiaru wyniku obliczenia.
+ */
+typedef struct BudgetCost {
+	uint64_t terms; ///<jednomiany wyniku na wszystkich poziomach, najwyżej UINT64_MAX
+	uint64_t bytes; ///<bajty węzłów wyniku, najwyżej UINT64_MAX
+} BudgetCost;
+
+/**
+ * Zaczyna obliczenie z ograniczeniami w bieżącym wątku. Od tej chwili
+ * mnożenie, potęgowanie i podstawianie sprawdzają co jakiś czas
+ * @ref BudgetCheck, a po przekroczeniu ograniczenia kończą się szybko
+ * z niepoprawnym, ale poprawnie zbudowanym wynikiem, który trzeba odrzucić.
+ * @param[in] limit : ograniczenia
+ */
+void BudgetStart(const Budget *limit);
+
+/**
+ * Sprawdza, czy obliczenie bieżącego wątku przekroczyło ograniczenia.
+ * Pamięć jest liczona z bilansu @ref MemThreadBalance od @ref BudgetStart,
+ * a zegar jest odczytywany tylko co kilkadziesiąt sprawdzeń. Raz przekroczone
+ * ograniczenie pozostaje przekroczone do @ref BudgetStop. Bez ograniczeń
+ * zwraca od razu false.
+ * @param[in] terms : jednomiany przydzielone poza @ref MemAlloc, na przykład
+ * w tablicach wyrazów
+ * @param[in] bytes : bajty przydzielone poza @ref MemAlloc
+ * @return czy ograniczenie jest przekroczone
+ */
+bool BudgetCheck(size_t terms, size_t bytes);
+
+/**
+ * Kończy obliczenie z ograniczeniami w bieżącym wątku, sprawdzając je
+ * ostatni raz razem z zegarem.
+ * @return czy ograniczenie zostało przekroczone, a wynik trzeba odrzucić
+ */
+bool BudgetStop(void);
+
+/**
+ * Szacuje z góry rozmiar iloczynu. Liczba wyrazów iloczynu po rozwinięciu
+ * jest ograniczona iloczynem liczb wyrazów czynników i liczbą wykładników
+ * mieszczących się w sumach stopni względem kolejnych zmiennych; jednomianów
+ * na każdym poziomie nie jest więcej niż wyrazów ani niż różnych wykładników
+ * zmiennych tego i wyższych poziomów.
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @return oszacowanie
+ */
+BudgetCost BudgetMulCost(const Poly *p, const Poly *q);
+
+/**
+ * Szacuje z góry rozmiar potęgi jak @ref BudgetMulCost; wyrazy potęgi
+ * odpowiadają wyborom @p e wyrazów z powtórzeniami.
+ * @param[in] p : wielomian
+ * @param[in] e : wykładnik
+ * @return oszacowanie
+ */
+BudgetCost BudgetExpCost(const Poly *p, poly_exp_t e);
+
+/**
+ * Szacuje z góry rozmiar wyniku @ref PolyCompose, sumując po wyrazach @p p
+ * iloczyny oszacowań potęg podstawianych wielomianów.
+ * @param[in] p : wielomian
+ * @param[in] count : liczba podstawianych wielomianów
+ * @param[in] x : podstawiane wielomiany
+ * @return oszacowanie
+ */
+BudgetCost BudgetComposeCost(const Poly *p, unsigned count, const Poly x[]);
+
+#endif /* __BUDGET_H__ */
@@ -0,0 +1,244 @@
+/** @file
+  Pamięć podręczna wyników operacji na wielomianach, usuwająca najdawniej
+  używane wyniki (LRU). Klucz to operacja, skrót struktury argumentów i
+  argument liczbowy; przy trafieniu argumenty są dodatkowo porównywane,
+  więc kolizja skrótów nie zmienia wyniku.
+  @author Aleksandra Grzyb
+  @copyright Uniwersytet Warszawski
+  @date 2017-05-20
+  */
+#include <stdlib.h>
+#include <assert.h>
+#include "cache.h"
+#include "utils.h"
+#define CACHE_BUCKETS 4096 ///<liczba kubełków tablicy haszującej, potęga dwójki
+
+atomic_bool cacheEnabled = false;
+
+/**
+ * Zapamiętany wynik operacji.
+ */
+typedef struct CacheEntry {
+	enum CacheOp op; ///<operacja
+	uint64_t hash; ///<skrót klucza
+	Poly *operands; ///<kopie argumentów
+	unsigned count; ///<liczba argumentów
+	poly_coeff_t arg; ///<argument liczbowy
+	Poly result; ///<kopia wyniku
+	size_t bytes; ///<bajty zajmowane przez wpis
+	struct CacheEntry *newer; ///<później użyty wpis
+	struct CacheEntry *older; ///<wcześniej użyty wpis
+	struct CacheEntry *next; ///<następny wpis w kubełku
+} CacheEntry;
+
+static CacheEntry *buckets[CACHE_BUCKETS]; ///<kubełki tablicy haszującej
+static CacheEntry *newest = NULL; ///<ostatnio użyty wpis
+static CacheEntry *oldest = NULL; ///<najdawniej użyty wpis
+static size_t limit = 0; ///<największa liczba bajtów
+static size_t bytes = 0; ///<bajty we wpisach
+static size_t entries = 0; ///<liczba wpisów
+static unsigned long hits = 0; ///<liczba trafień
+static unsigned long misses = 0; ///<liczba chybień
+
+/** Blokada chroniąca pamięć podręczną */
+static atomic_flag lock = ATOMIC_FLAG_INIT;
+
+/**
+ * Zajmuje blokadę.
+ */
+static void Lock(void) {
+	while (atomic_flag_test_and_set_explicit(&lock, memory_order_acquire));
+}
+
+/**
+ * Zwalnia blokadę.
+ */
+static void Unlock(void) {
+	atomic_flag_clear_explicit(&lock, memory_order_release);
+}
+
+/**
+ * Miesza bity liczby (funkcja końcowa splitmix64).
+ * @param[in] x : liczba
+ * @return wymieszana liczba
+ */
+static uint64_t Mix(uint64_t x) {
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+/**
+ * Liczy skrót struktury wielomianu. Równe wielomiany mają równe skróty.
+ * @param[in] p : wielomian
+ * @return skrót
+ */
+static uint64_t PolyHash(const Poly *p) {
+	uint64_t hash = Mix((uint64_t)p->coef);
+	for (List *l = p->monos ; l != NULL ; l = l->next)
+		hash = Mix(hash ^ Mix((uint64_t)l->value.exp + PolyHash(&(l->value.p))));
+	return hash;
+}
+
+/**
+ * Sprawdza, czy wpis jest wynikiem operacji na zadanych argumentach.
+ * @param[in] e : wpis
+ * @param[in] op : operacja
+ * @param[in] operands : argumenty
+ * @param[in] count : liczba argumentów
+ * @param[in] arg : argument liczbowy
+ * @param[in] hash : skrót klucza
+ * @return czy klucze są równe
+ */
+static bool Matches(const CacheEntry *e, enum CacheOp op, const Poly operands[], unsigned count,
+		poly_coeff_t arg, uint64_t hash) {
+	if (e->hash != hash || e->op != op || e->count != count || e->arg != arg)
+		return false;
+	for (unsigned i = 0 ; i < count ; i++)
+		if (!PolyIsEq(&(e->operands[i]), &(operands[i])))
+			return false;
+	return true;
+}
+
+/**
+ * Szuka wpisu o zadanym kluczu.
+ * @param[in] op : operacja
+ * @param[in] operands : argumenty
+ * @param[in] count : liczba argumentów
+ * @param[in] arg : argument liczbowy
+ * @param[in] hash : skrót klucza
+ * @return wpis albo NULL
+ */
+static CacheEntry *Find(enum CacheOp op, const Poly operands[], unsigned count, poly_coeff_t arg, uint64_t hash) {
+	for (CacheEntry *e = buckets[hash & (CACHE_BUCKETS - 1)] ; e != NULL ; e = e->next)
+		if (Matches(e, op, operands, count, arg, hash))
+			return e;
+	return NULL;
+}
+
+/**
+ * Wypina wpis z listy LRU.
+ * @param[in] e : wpis
+ */
+static void Unlink(CacheEntry *e) {
+	if (e->newer != NULL)
+		e->newer->older = e->older;
+	else
+		newest = e->older;
+	if (e->older != NULL)
+		e->older->newer = e->newer;
+	else
+		oldest = e->newer;
+}
+
+/**
+ * Wpina wpis na początek listy LRU.
+ * @param[in] e : wpis
+ */
+static void PushNewest(CacheEntry *e) {
+	e->newer = NULL;
+	e->older = newest;
+	if (newest != NULL)
+		newest->newer = e;
+	else
+		oldest = e;
+	newest = e;
+}
+
+/**
+ * Usuwa najdawniej używany wpis.
+ */
+static void EvictOldest(void) {
+	CacheEntry *e = oldest;
+	Unlink(e);
+	CacheEntry **link = &(buckets[e->hash & (CACHE_BUCKETS - 1)]);
+	while (*link != e)
+		link = &((*link)->next);
+	*link = e->next;
+	for (unsigned i = 0 ; i < e->count ; i++)
+		PolyDestroy(&(e->operands[i]));
+	free(e->operands);
+	PolyDestroy(&(e->result));
+	bytes -= e->bytes;
+	entries--;
+	free(e);
+}
+
+void CacheSetLimit(size_t newLimit) {
+	Lock();
+	limit = newLimit;
+	while (bytes > limit)
+		EvictOldest();
+	atomic_store_explicit(&cacheEnabled, limit > 0, memory_order_relaxed);
+	Unlock();
+}
+
+void CacheClear(void) {
+	Lock();
+	while (oldest != NULL)
+		EvictOldest();
+	hits = 0;
+	misses = 0;
+	Unlock();
+}
+
+CacheUsage CacheGetUsage(void) {
+	Lock();
+	CacheUsage usage = {.limit = limit, .bytes = bytes, .entries = entries, .hits = hits, .misses = misses};
+	Unlock();
+	return usage;
+}
+
+bool CacheLookup(enum CacheOp op, const Poly operands[], unsigned count, poly_coeff_t arg,
+		uint64_t *hash, Poly *result) {
+	*hash = Mix((uint64_t)op + Mix((uint64_t)arg + count));
+	for (unsigned i = 0 ; i < count ; i++)
+		*hash = Mix(*hash ^ PolyHash(&(operands[i])));
+	Lock();
+	CacheEntry *e = Find(op, operands, count, arg, *hash);
+	if (e != NULL) {
+		hits++;
+		Unlink(e);
+		PushNewest(e);
+		*result = PolyClone(&(e->result));
+	}
+	else
+		misses++;
+	Unlock();
+	return e != NULL;
+}
+
+void CacheInsert(enum CacheOp op, const Poly operands[], unsigned count, poly_coeff_t arg,
+		uint64_t hash, const Poly *result) {
+	size_t size = sizeof(CacheEntry) + count * sizeof(Poly) + PolyNodes(result) * sizeof(List);
+	for (unsigned i = 0 ; i < count ; i++)
+		size += PolyNodes(&(operands[i])) * sizeof(List);
+	Lock();
+	if (size > limit || Find(op, operands, count, arg, hash) != NULL) {
+		Unlock();
+		return;
+	}
+	while (bytes + size > limit)
+		EvictOldest();
+	CacheEntry *e = (CacheEntry *)malloc(sizeof(CacheEntry));
+	assert(e != NULL);
+	e->operands = (Poly *)malloc(count * sizeof(Poly));
+	assert(e->operands != NULL);
+	for (unsigned i = 0 ; i < count ; i++)
+		e->operands[i] = PolyClone(&(operands[i]));
+	e->op = op;
+	e->hash = hash;
+	e->count = count;
+	e->arg = arg;
+	e->result = PolyClone(result);
+	e->bytes = size;
+	e->next = buckets[hash & (CACHE_BUCKETS - 1)];
+	buckets[hash & (CACHE_BUCKETS - 1)] = e;
+	PushNewest(e);
+	bytes += size;
+	entries++;
+	Unlock();
+}
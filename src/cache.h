@@ -0,0 +1,90 @@
+/** @file
+   Interfejs pamięci podręcznej wyników operacji na wielomianach
+
+   @author Aleksandra Grzyb
+   @copyright Uniwersytet Warszawski
+   @date 2017-05-20
+*/
+
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "poly.h"
+
+/** Operacje, których wyniki są zapamiętywane */
+enum CacheOp {
+	CACHE_MUL, ///<PolyMul
+	CACHE_AT, ///<PolyAt
+	CACHE_COMPOSE ///<PolyCompose
+};
+
+/**
+ * Stan pamięci podręcznej.
+ */
+typedef struct CacheUsage {
+	size_t limit; ///<największa liczba bajtów; 0 oznacza wyłączoną pamięć
+	size_t bytes; ///<bajty zajmowane przez zapamiętane wyniki i argumenty
+	size_t entries; ///<liczba zapamiętanych wyników
+	unsigned long hits; ///<liczba trafień
+	unsigned long misses; ///<liczba chybień
+} CacheUsage;
+
+/** Czy pamięć podręczna jest włączona */
+extern atomic_bool cacheEnabled;
+
+/**
+ * Sprawdza, czy pamięć podręczna jest włączona.
+ * @return czy wyniki operacji są zapamiętywane
+ */
+static inline bool CacheActive(void) {
+	return atomic_load_explicit(&cacheEnabled, memory_order_relaxed);
+}
+
+/**
+ * Ustawia największy rozmiar pamięci podręcznej, usuwając najdawniej używane
+ * wyniki, które się nie mieszczą. Rozmiar 0 wyłącza pamięć podręczną.
+ * @param[in] bytes : rozmiar w bajtach
+ */
+void CacheSetLimit(size_t bytes);
+
+/**
+ * Usuwa wszystkie zapamiętane wyniki i zeruje liczniki trafień i chybień.
+ */
+void CacheClear(void);
+
+/**
+ * Zwraca stan pamięci podręcznej.
+ * @return stan pamięci podręcznej
+ */
+CacheUsage CacheGetUsage(void);
+
+/**
+ * Szuka wyniku operacji na równych argumentach.
+ * @param[in] op : operacja
+ * @param[in] operands : argumenty
+ * @param[in] count : liczba argumentów
+ * @param[in] arg : argument liczbowy operacji
+ * @param[out] hash : skrót klucza, do przekazania @ref CacheInsert
+ * @param[out] result : kopia zapamiętanego wyniku, jeśli jest
+ * @return czy wynik był zapamiętany
+ */
+bool CacheLookup(enum CacheOp op, const Poly operands[], unsigned count, poly_coeff_t arg,
+		uint64_t *hash, Poly *result);
+
+/**
+ * Zapamiętuje kopię wyniku operacji wraz z kopiami argumentów.
+ * @param[in] op : operacja
+ * @param[in] operands : argumenty
+ * @param[in] count : liczba argumentów
+ * @param[in] arg : argument liczbowy operacji
+ * @param[in] hash : skrót klucza z @ref CacheLookup
+ * @param[in] result : wynik
+ */
+void CacheInsert(enum CacheOp op, const Poly operands[], unsigned count, poly_coeff_t arg,
+		uint64_t hash, const Poly *result);
+
+#endif /* __CACHE_H__ */
@@ -6,45 +6,184 @@
   */
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <pthread.h>
 #include <string.h>
 #include <limits.h>
+#include <inttypes.h>
 #include "poly.h"
+#include "packed.h"
+#include "budget.h"
+#include "cache.h"
+#include "registers.h"
+#include "ring.h"
+#include "dataflow.h"
+#include "batch.h"
+#include "stats.h"
+#include "memory.h"
+#include "trace.h"
+#include "spill.h"
 #include "utils.h"
-#define MAX_COMMAND_LENGTH 9  ///<maksymalna długość komendy
+#define MAX_COMMAND_LENGTH 13  ///<maksymalna długość komendy
 #define NUM_BEG 1 ///<począktowy numner linii
 #define NEW_LINE '\n' ///<nowa linia
 #define PLUS '+' ///<plus
 #define EMPTY_CHAR '\0' ///<pusty char
+#define MAX_STATS_LINE 256 ///<maksymalna długość wiersza statystyk
+#define MEMORY_TOP 5 ///<domyślna liczba najcięższych elementów stosu w MEMORY
+#define CACHE_REPORT 0 ///<CACHE bez argumentu: wypisanie stanu pamięci podręcznej
+#define CACHE_LIMIT 1 ///<CACHE z liczbą: ustawienie rozmiaru pamięci podręcznej
+#define CACHE_CLEAR 2 ///<CACHE CLEAR: wyczyszczenie pamięci podręcznej
+#define PIPELINE_LINES 1024 ///<pojemność kolejek między wątkami w trybie potokowym
+#define TEXT_BEG 64 ///<początkowa pojemność bufora wyjścia linii
+#define DATAFLOW_WINDOW 64 ///<największa liczba niewykonanych komend zleconych puli wątków
+#define MAX_PATH_LENGTH 255 ///<maksymalna długość ścieżki pliku w MULTI_AT
+#define MAX_POINT_LENGTH 63 ///<dłuższe słowa pliku punktów na pewno nie są liczbą
+#define SPILL_MIN_BYTES 4096 ///<najmniejszy wielomian elementu stosu odkładany do pliku wymiany
+#define MAX_JOBS 1024 ///<największa liczba równocześnie wykonywanych plików w trybie wsadowym
+#define MAX_WORKERS 1024 ///<największa liczba wątków puli w trybie --parallel
+#define TERMS_UNKNOWN UINT64_MAX ///<jednomiany elementu stosu nie zostały jeszcze policzone
+#define LIMIT_TERMS 0 ///<LIMIT TERMS: ograniczenie liczby jednomianów
+#define LIMIT_BYTES 1 ///<LIMIT BYTES: ograniczenie pamięci
+#define LIMIT_MS 2 ///<LIMIT MS: ograniczenie czasu
+#define LIMIT_OFF 3 ///<LIMIT OFF: zniesienie wszystkich ograniczeń
+#define LIMIT_REPORT 4 ///<LIMIT bez argumentu: wypisanie ograniczeń
 /** Przechowuje liczbową reprezentację komend*/
 enum command {
 	ADD = 193450094,
 	AT = 5862138,
+	CACHE = 210669417753,
 	CLONE = 210669826326,
 	COMPOSE = 229419555988923,
 	DEG = 193453397,
 	DEG_BY = 6952134833711,
+	DROP = 6383976602,
+	EXPLAIN = 229422494541846,
+	EXP_TRUNC = 249841097322508957,
 	IS_COEFF = 7571106913169155,
 	IS_ZERO = 229427483033344, 
 	IS_EQ = 210677210550,
+	LIMIT = 210680389476,
+	LOAD = 6384260357,
+	MEMORY = 6952487250974,
 	MUL = 193463731,
+	MULTI_AT = 7571279246277732,
+	MUL_STRATEGY = 13821451085211074021u,
+	MUL_TRUNC = 249852215570254078,
 	NEG = 193464287,
 	POP = 193466804,
 	PRINT = 210685452402,
+	PROB_EQ = 229436464364397,
+	STATS = 210689073524,
+	STORE = 210689088690,
 	SUB = 193470255,
-	ZERO = 638475315 
+	ZERO = 6384753157
 };
 
-Poly ReadPoly(int, int *, char *, bool *);
-void PrintPoly (Poly *, bool);
+/** Nazwy komend w kolejności wypisywania statystyk */
+static const char *const commandNames[] = {
+	"ADD", "AT", "CACHE", "CLONE", "COMPOSE", "DEG", "DEG_BY", "DROP", "EXPLAIN", "EXP_TRUNC", "IS_COEFF",
+	"IS_EQ", "IS_ZERO", "LIMIT", "LOAD", "MEMORY", "MUL", "MULTI_AT", "MUL_STRATEGY", "MUL_TRUNC", "NEG", "POP", "PRINT", "PROB_EQ", "STATS", "STORE", "SUB", "ZERO"
+};
+
+/** Liczba komend */
+#define COMMANDS (sizeof(commandNames) / sizeof(commandNames[0]))
+
+/** Liczbowe reprezentacje komend z tablicy @ref commandNames */
+static unsigned long commandHashes[COMMANDS];
+
+/** Czy wypisać statystyki komend na zakończenie skryptu */
+static bool statsOnExit = false;
+
+/** Czy kalkulator liczy na wielomianach w postaci upakowanej */
+static bool packedEngine = false;
+
+/** Czy czytanie, wykonywanie i wypisywanie działają w osobnych wątkach */
+static bool pipeline = false;
+
+/** Liczba wątków puli wykonującej niezależne komendy równolegle; 0 oznacza wykonanie sekwencyjne */
+static unsigned workers = 0;
+
+/** Czy pula wątków działa */
+static bool dataflow = false;
+
+/** Czy MUL sprawdza, czy współczynniki iloczynu mieszczą się w poly_coeff_t */
+static bool checkOverflow = false;
+
+/** Czy ostatnio wykonany MUL odrzucił iloczyn o zbyt dużym współczynniku */
+static bool mulOverflowed = false;
+
+/** Czy ostatnio wykonany MULTI_AT nie mógł wczytać pliku punktów */
+static bool pointsUnreadable = false;
+
+/** Ograniczenia zasobów MUL, MUL_TRUNC, EXP_TRUNC i COMPOSE ustawione przez LIMIT */
+static Budget limits = {0, 0, 0};
+
+/** Czy ostatnio wykonana komenda przekroczyła ograniczenia i jej wynik został odrzucony */
+static bool limitExceeded = false;
+
+/** Czy następne MUL, MUL_TRUNC, EXP_TRUNC lub COMPOSE ma tylko wypisać oszacowanie wyniku */
+static bool explainNext = false;
+
+/** Bajty pamięci, po których przekroczeniu elementy stosu są odkładane do pliku wymiany; 0 oznacza brak ograniczenia */
+static size_t memLimit = 0;
+
+/** Liczba wykonanych linii skryptu, znacznik czasu ostatniego użycia elementów stosu */
+static unsigned long tick = 0;
 
 /**
- *Struktura przechowująca listę monomianów.
- *Zbudowany na liście jednokierunkowej.
- **/
-typedef struct MonoList {
-	Mono value;///<jednomian
-	struct MonoList *next;///<wskaźnik na następny element
-} MonoList;
+ *Tekst wypisany przez jedną linię skryptu, zbierany w trybie potokowym
+ */
+typedef struct Text {
+	char *data;///<tekst zakończony zerem lub NULL, jeśli pusty
+	size_t size;///<długość tekstu
+	size_t capacity;///<rozmiar bufora
+} Text;
+
+/**
+ *Wyjście jednej linii skryptu: osobno standardowe wyjście i wyjście błędów.
+ *Linia wypisuje albo błędy, albo wyniki, więc kolejność między nimi się nie gubi.
+ */
+typedef struct Output {
+	Text out;///<standardowe wyjście
+	Text err;///<wyjście błędów
+} Output;
+
+/** Wyjście linii przetwarzanej przez bieżący wątek lub NULL, gdy wypisujemy od razu */
+static _Thread_local Output *output = NULL;
+
+/**
+ *Dopisuje sformatowany tekst do bufora
+ *@param[in] t : bufor
+ *@param[in] format : format jak w printf
+ */
+void TextPrintf(Text *t, const char *format, ...) {
+	va_list args, copy;
+	va_start(args, format);
+	va_copy(copy, args);
+	int length = vsnprintf(t->data != NULL ? t->data + t->size : NULL, t->capacity - t->size, format, args);
+	va_end(args);
+	assert(length >= 0);
+	if (t->size + length >= t->capacity) {
+		while (t->size + length >= t->capacity)
+			t->capacity = t->capacity == 0 ? TEXT_BEG : 2 * t->capacity;
+		t->data = (char *)realloc(t->data, t->capacity);
+		assert(t->data != NULL);
+		vsnprintf(t->data + t->size, t->capacity - t->size, format, copy);
+	}
+	va_end(copy);
+	t->size += length;
+}
+
+/** Wypisuje na standardowe wyjście albo do wyjścia bieżącej linii */
+#define OUT(...) (output == NULL ? (void)printf(__VA_ARGS__) : TextPrintf(&(output->out), __VA_ARGS__))
+
+/** Wypisuje na wyjście błędów albo do wyjścia bieżącej linii */
+#define ERR(...) (output == NULL ? (void)fprintf(stderr, __VA_ARGS__) : TextPrintf(&(output->err), __VA_ARGS__))
+
+Poly ReadPoly(int, int *, char *, bool *);
+void PrintPoly (Poly *, bool);
+unsigned long Hash(const char *);
 
 /**
  *Struktura reprezentująca stos.
@@ -52,10 +191,43 @@ typedef struct MonoList {
  **/
 typedef struct Stack {
 	Poly value;///<wielomian
+	PackedPoly packed;///<wielomian w postaci upakowanej, gdy kalkulator liczy na nich
+	RegisterValue *shared;///<wartość rejestru, której wielomiany są pożyczone, lub NULL
+	Task *task;///<zadanie puli liczące wielomian elementu lub NULL, jeśli wielomian jest gotowy
+	SpillHandle *spill;///<miejsce wielomianu w pliku wymiany lub NULL, jeśli wielomian jest w pamięci
+	unsigned long used;///<numer linii, która ostatnio użyła elementu
+	size_t bytes;///<bajty wielomianu policzone przy szukaniu elementów do wymiany lub 0
+	uint64_t terms;///<jednomiany wielomianu na najwyższym poziomie policzone do statystyk lub @ref TERMS_UNKNOWN
+	bool listed;///<czy element jest na liście elementów do wymiany
+	struct Stack *colder;///<dawniej używany element na liście elementów do wymiany
+	struct Stack *warmer;///<później używany element na liście elementów do wymiany
 	unsigned long size;///<rozmiar stosu
 	struct Stack *pop;///<wskaźnik na poprzedni element stosu
 } Stack;
 
+/** Najdawniej używany element stosu, który można odłożyć do pliku wymiany */
+static Stack *coldest = NULL;
+
+/** Ostatnio używany element stosu, który można odłożyć do pliku wymiany */
+static Stack *warmest = NULL;
+
+/**
+ *Wczytana linia skryptu gotowa do wykonania
+ **/
+typedef struct Instruction {
+	int line;///<numer linii
+	bool poly;///<czy linia jest wielomianem, a nie komendą
+	bool proper;///<czy linia jest poprawna
+	Poly value;///<wczytany wielomian
+	PackedPoly packed;///<wczytany wielomian w postaci upakowanej, gdy kalkulator liczy na nich
+	char command[MAX_COMMAND_LENGTH];///<nazwa komendy
+	long arg;///<argument do PolyAt lub rozmiar pamięci podręcznej
+	unsigned arg2;///<argument do PolyDegBy, ilość wielomianów w COMPOSE albo tryb CACHE i MEMORY
+	unsigned argNumb;///<liczba elementów stosu potrzebnych komendzie
+	char name[MAX_PATH_LENGTH + 1];///<nazwa rejestru w STORE, LOAD i DROP, sposobu mnożenia w MUL_STRATEGY albo ścieżka pliku w MULTI_AT
+	Output output;///<wyjście linii w trybie potokowym
+} Instruction;
+
 /**
  *Tworzy nowy element stosu o danym numerze
  *@param[in] p : wielomian
@@ -63,49 +235,23 @@ typedef struct Stack {
  *@return nowy element stosu
  **/
 Stack *NewStack(Poly p, unsigned long size) {
-	Stack *s = (Stack *)malloc(sizeof(Stack));
-	assert (s != NULL);
+	Stack *s = (Stack *)MemAlloc(sizeof(Stack));
 	s->size = size;
 	s->value = p;
+	s->packed = PackedZero();
+	s->shared = NULL;
+	s->task = NULL;
+	s->spill = NULL;
+	s->used = 0;
+	s->bytes = 0;
+	s->terms = TERMS_UNKNOWN;
+	s->listed = false;
+	s->colder = NULL;
+	s->warmer = NULL;
 	s->pop = NULL;
 	return s;
 }
 
-/**
- *Tworzy nowy element listy monomianów
- *@param[in] mono : monomian
- *@return nowy element listy
- **/
-MonoList *NewMonoList(Mono mono) {
-	MonoList *monoList = (MonoList *)malloc(sizeof(MonoList));
-	assert(monoList != NULL);
-	monoList->next = NULL;
-	monoList->value = mono;
-	return monoList;
-}
-
-/**
- *Niszczy listę monomianów
- *@param[in] list : lista monomianów
- **/
-void DestroyMonoList(MonoList *list) {
-	MonoList *tmp = list->next;
-	free(list);
-	if (tmp != NULL)
-		DestroyMonoList(tmp);
-}
-
-/**
- *Oblicza długość listy monomianu
- *@param[in] mono : lista monomianów
- *@return rozmiar listy
- **/
-unsigned SizeMonoList(MonoList *mono) {
-	if (mono != NULL)
-		return 1 + SizeMonoList(mono->next);
-	else return 0;
-}
-
 /**
  *Dodaje do stosu nowy element
  *@param[in] s : stos do którego będzie dodany nowy element
@@ -118,6 +264,35 @@ Stack *AddStack(Stack *s, Poly p) {
 	return tmp;
 }
 
+/**
+ *Dodaje do stosu nowy element z wielomianem w postaci upakowanej
+ *@param[in] s : stos do którego będzie dodany nowy element
+ *@param[in] p : wielomian, który będzie dodany do stosu
+ *@return obecny stos
+ **/
+Stack *AddPackedStack(Stack *s, PackedPoly p) {
+	Stack *tmp = AddStack(s, PolyZero());
+	tmp->packed = p;
+	return tmp;
+}
+
+/**
+ *Usuwa element stosu z listy elementów do wymiany, jeśli na niej jest
+ *@param[in] s : element stosu
+ */
+void Unlist(Stack *s) {
+	if (!s->listed)
+		return;
+	if (s->colder != NULL)
+		s->colder->warmer = s->warmer;
+	else coldest = s->warmer;
+	if (s->warmer != NULL)
+		s->warmer->colder = s->colder;
+	else warmest = s->colder;
+	s->colder = s->warmer = NULL;
+	s->listed = false;
+}
+
 /**
  *Zdejmuje element ze stosu niszczy wierzchołkowy wielomian
  *@param[in] s : stos, z którego będzie zdjęty element
@@ -127,8 +302,18 @@ Stack *AddStack(Stack *s, Poly p) {
 Stack *PopStack(Stack *s, int k) {
 	if (s != NULL) {
 		Stack *tmp  = s->pop;
-		PolyDestroy(&(s->value));
-		free(s);
+		Unlist(s);
+		if (s->task != NULL)
+			TaskRelease(s->task);
+		if (s->shared != NULL)
+			RegisterValueRelease(s->shared);
+		else if (s->spill != NULL)
+			SpillFree(s->spill);
+		else {
+			PolyDestroy(&(s->value));
+			PackedDestroy(&(s->packed));
+		}
+		MemFree(s, sizeof(Stack));
 		if (k > 1) 
 			return PopStack(tmp, k - 1);
 		else return tmp;
@@ -186,13 +371,18 @@ bool ValidateINT (unsigned long a, int sgn) {
  *@param[in] command: liczba reprezentująca metodę do wykonania
  **/
 void ErrArg (int line, unsigned long command) {
-	fprintf(stderr, "%s%d%s", "ERROR ", line, " WRONG");
-	if (command == AT)
-		fprintf(stderr, "%s\n", " VALUE");
+	ERR("%s%d%s", "ERROR ", line, " WRONG");
+	if (command == AT || command == CACHE || command == EXP_TRUNC || command == LIMIT || command == MUL_STRATEGY
+			|| command == MUL_TRUNC)
+		ERR("%s\n", " VALUE");
 	else if (command == DEG_BY)
-		fprintf(stderr, "%s\n", " VARIABLE");
-	else if (command == COMPOSE)
-		fprintf(stderr, "%s\n", " COUNT");
+		ERR("%s\n", " VARIABLE");
+	else if (command == COMPOSE || command == MEMORY || command == PROB_EQ)
+		ERR("%s\n", " COUNT");
+	else if (command == DROP || command == LOAD || command == STORE)
+		ERR("%s\n", " NAME");
+	else if (command == MULTI_AT)
+		ERR("%s\n", " FILE");
 }
 
 /**
@@ -200,7 +390,7 @@ void ErrArg (int line, unsigned long command) {
  *@param[in] line : numer błednej linii 
  **/
 void ErrCommand(int line) {
-	fprintf(stderr, "%s%d%s\n", "ERROR ", line, " WRONG COMMAND");
+	ERR("%s%d%s\n", "ERROR ", line, " WRONG COMMAND");
 }
 
 /**
@@ -209,7 +399,7 @@ void ErrCommand(int line) {
  *@param[in] line : numer błednej linii 
  **/
 void ErrPoly(int number, int line) {
-	fprintf(stderr, "%s%d%s%d\n", "ERROR ", line, " ", number);
+	ERR("%s%d%s%d\n", "ERROR ", line, " ", number);
 }
 
 /**
@@ -217,7 +407,23 @@ void ErrPoly(int number, int line) {
  *@param[in] line : numer błednej linii 
  **/
 void ErrOverflow(int line) {
-	fprintf(stderr, "%s%d%s\n", "ERROR ", line, " STACK UNDERFLOW");
+	ERR("%s%d%s\n", "ERROR ", line, " STACK UNDERFLOW");
+}
+
+/**
+ *Wypisuje błąd: współczynnik iloczynu nie mieści się w poly_coeff_t
+ *@param[in] line : numer błednej linii 
+ **/
+void ErrCoeffOverflow(int line) {
+	ERR("%s%d%s\n", "ERROR ", line, " OVERFLOW");
+}
+
+/**
+ *Wypisuje błąd: komenda przekroczyła ograniczenia zasobów
+ *@param[in] line : numer błednej linii 
+ **/
+void ErrLimit(int line) {
+	ERR("%s%d%s\n", "ERROR ", line, " LIMIT EXCEEDED");
 }
 
 /**
@@ -282,6 +488,62 @@ long ReadNumb(char *c, int *number, bool *proper, bool(*f)(unsigned long, int))
 	return sgn * result;
 }
 
+/**
+ *Wczytuje słowo złożone z liter i sprawdza, czy jest równe zadanemu
+ *@param[in] c : obecnie wczytany znak, pierwsza litera słowa
+ *@param[in] number : licznik kolumn
+ *@param[in] word : oczekiwane słowo
+ *@return true jeśli wczytane słowo jest równe @p word, false w przeciwnym razie
+ */
+bool ReadWord(char *c, int *number, const char *word) {
+	bool equal = true;
+	while (IsLetter(*c)) {
+		equal = equal && *word == *c;
+		if (*word != EMPTY_CHAR)
+			word++;
+		ReadLetter(number, c);
+	}
+	return equal && *word == EMPTY_CHAR;
+}
+
+/**
+ *Wczytuje nazwę rejestru złożoną z liter, cyfr i podkreślników
+ *@param[in] c : obecnie wczytany znak, pierwszy znak nazwy
+ *@param[in] number : licznik kolumn
+ *@param[in] name : miejsce na nazwę, co najmniej @ref REGISTER_NAME_LENGTH + 1 znaków
+ *@return true jeśli nazwa jest niepusta i nie dłuższa niż @ref REGISTER_NAME_LENGTH
+ */
+bool ReadName(char *c, int *number, char *name) {
+	size_t length = 0;
+	while (IsLetter(*c) || IsNumber(*c) || *c == '_') {
+		if (length == REGISTER_NAME_LENGTH)
+			return false;
+		name[length++] = *c;
+		ReadLetter(number, c);
+	}
+	name[length] = EMPTY_CHAR;
+	return length > 0;
+}
+
+/**
+ *Wczytuje ścieżkę pliku: wszystkie znaki do końca linii
+ *@param[in] c : obecnie wczytany znak, pierwszy znak ścieżki
+ *@param[in] number : licznik kolumn
+ *@param[in] path : miejsce na ścieżkę, co najmniej @ref MAX_PATH_LENGTH + 1 znaków
+ *@return true jeśli ścieżka jest niepusta i nie dłuższa niż @ref MAX_PATH_LENGTH
+ */
+bool ReadPath(char *c, int *number, char *path) {
+	size_t length = 0;
+	while (*c != NEW_LINE) {
+		if (length == MAX_PATH_LENGTH)
+			return false;
+		path[length++] = *c;
+		ReadLetter(number, c);
+	}
+	path[length] = EMPTY_CHAR;
+	return length > 0;
+}
+
 /**
  *Wczytuje jednomian
  *@param[in] line : obecna linia
@@ -313,20 +575,6 @@ Mono ReadMono(int line, int *number, char *c, bool *proper) {
 	return MonoFromPoly(&p, resultExp);
 }
 
-/**
- *Zapisuje listę monomianów do tablicy
- *@param[in] monos : tablica monomianów, do których będą zapisane monomiany z listy
- *@param[in] list : lista monomianów 
- **/
-void WriteListToMatrix(Mono monos[], MonoList *list) {
-	int index = 0;
-	while (list != NULL) {
-		monos[index] = list->value;
-		index++;
-		list = list->next;
-	}
-}
-
 /**
  *Wczytuje jednomiany i zwraca stowrzony z nich wielomian
  *@param[in] line : obecna linia
@@ -336,12 +584,10 @@ void WriteListToMatrix(Mono monos[], MonoList *list) {
  *@return stworzony z jednomianów wielomian
  **/
 Poly ReadMonos (int line, int *number, char *c, bool *proper) {
-	Poly p = PolyZero();
-	MonoList *monoList = NewMonoList(MonoFromPoly(&p, 0));
-	MonoList *first = monoList;
+	PolyBuilder builder = PolyBuilderNew(0);
 	do {
-		monoList->next = NewMonoList(ReadMono(line, number, c, proper));
-		monoList = monoList->next;
+		Mono mono = ReadMono(line, number, c, proper);
+		PolyBuilderPush(&builder, &mono);
 		if (*c == '+') {
 			ReadLetter(number, c);
 			if (*c == NEW_LINE)
@@ -350,12 +596,7 @@ Poly ReadMonos (int line, int *number, char *c, bool *proper) {
 		else if (*c == '(')
 			*proper = false;
 	} while (*c == '(' && *proper);
-	unsigned size = SizeMonoList(first->next);
-	Mono monos[size];
-	WriteListToMatrix(monos, first->next);
-	DestroyMonoList(first);
-	p = PolyAddMonos(size, monos);
-	return p;
+	return PolyBuilderFinish(&builder);
 }
 
 /**
@@ -386,13 +627,13 @@ Poly ReadPoly(int line, int *number, char *c, bool *proper) {
  **/
 void PrintMono (Poly p, poly_exp_t e, bool add) {
 	if (add)
-		printf("%c", PLUS);
-	printf("%c", '(');
+		OUT("%c", PLUS);
+	OUT("%c", '(');
 	if (PolyIsCoeff(&p))
-		printf("%ld", p.coef);
+		OUT("%ld", p.coef);
 	else 
 		PrintPoly(&p, EMPTY_CHAR);
-	printf("%c%d%c",',', e, ')');
+	OUT("%c%d%c",',', e, ')');
 }
 
 /**
@@ -402,7 +643,7 @@ void PrintMono (Poly p, poly_exp_t e, bool add) {
  **/
 void PrintPoly(Poly *p, bool add) {
 	List *mono = p->monos;
-	if (mono != NULL && mono->value.exp == 0) {
+	if (mono != NULL && mono->value.exp == 0 && p->coef != 0) {
 		mono->value.p.coef += p->coef;
 		p->coef = 0;
 	}
@@ -423,7 +664,7 @@ void PrintPoly(Poly *p, bool add) {
  */
 void Print(Poly *p) {
 	if (PolyIsCoeff(p) || (p->monos->value.exp == 0 && PolyIsZero(&(p->monos->value.p))))
-		printf("%ld", p->coef);
+		OUT("%ld", p->coef);
 	else PrintPoly(p, false);
 
 }
@@ -475,20 +716,77 @@ bool CanMoveStack(unsigned argNumb, Stack *stack, int line) {
 }
 
 /**
- *Sprawdza czy można wykonać ruch
- *@param[in] comm : komenda do wykonania
- *@param[in] stack : stos z wielomianami
- *@param[in] line : obecna linia
+ *Wczytuje nieujemny argument liczbowy poprzedzony spacją: wykładnik
+ *lub ograniczenie stopnia
+ *@param[in] c : obecnie wczytany znak
+ *@param[in] number : licznik kolumn
+ *@param[in] proper : pamięta poprawność wczytywania
+ *@return wczytana liczba
+ */
+long ReadDegree(char *c, int *number, bool *proper) {
+	if (*c != ' ') {
+		*proper = false;
+		return 0;
+	}
+	ReadLetter(number, c);
+	if (!IsNumber(*c)) {
+		*proper = false;
+		return 0;
+	}
+	return ReadNumb(c, number, proper, ValidateINT);
+}
+
+/** Nazwy sposobów mnożenia w kolejności @ref MulStrategy */
+static const char *const strategyNames[] = {"AUTO", "SCHOOLBOOK", "DENSE", "HASH"};
+
+/**
+ *Zamienia nazwę sposobu mnożenia na jego numer
+ *@param[in] name : nazwa
+ *@param[in] strategy : miejsce na numer sposobu
+ *@return true jeśli nazwa jest poprawna
+ */
+bool ParseStrategy(const char *name, unsigned *strategy) {
+	for (unsigned i = 0 ; i < sizeof(strategyNames) / sizeof(strategyNames[0]) ; i++)
+		if (strcmp(name, strategyNames[i]) == 0) {
+			*strategy = i;
+			return true;
+		}
+	return false;
+}
+
+/** Nazwy ograniczeń w kolejności @ref LIMIT_TERMS, @ref LIMIT_BYTES, @ref LIMIT_MS i @ref LIMIT_OFF */
+static const char *const limitNames[] = {"TERMS", "BYTES", "MS", "OFF"};
+
+/**
+ *Zamienia nazwę ograniczenia na jego numer
+ *@param[in] name : nazwa
+ *@param[in] kind : miejsce na numer ograniczenia
+ *@return true jeśli nazwa jest poprawna
+ */
+bool ParseLimit(const char *name, unsigned *kind) {
+	for (unsigned i = 0 ; i < sizeof(limitNames) / sizeof(limitNames[0]) ; i++)
+		if (strcmp(name, limitNames[i]) == 0) {
+			*kind = i;
+			return true;
+		}
+	return false;
+}
+
+/**
+ *Wczytuje argumenty komendy i sprawdza jej składnię. Warunki zależne
+ *od stanu kalkulatora sprawdza dopiero @ref CanMove przed wykonaniem.
+ *@param[in] ins : linia z wczytaną nazwą komendy, uzupełniana o argumenty
  *@param[in] c : obecnie wczytany znak
- *@param[in] arg : argument do funcji PolyAt
- *@param[in] arg2 : argument do funkcji PolyDegBy lub ilość argumentów w COMPOSE
- *@param[in] proper : pamięta czy wczytywanie się powiodło
  */
-void CanMove(char *comm, Stack *stack, int line, char *c, long *arg, unsigned *arg2, bool *proper) {
+void ParseCommand(Instruction *ins, char *c) {
 	int number = NUM_BEG;
+	int line = ins->line;
+	bool *proper = &(ins->proper);
+	long *arg = &(ins->arg);
+	unsigned *arg2 = &(ins->arg2);
 	unsigned argNumb = 0;
 	*arg2 = 0;
-	unsigned long command = Hash(comm);		
+	unsigned long command = Hash(ins->command);
 	switch (command) {
 		case AT:
 			if (*c == ' ') {
@@ -521,6 +819,55 @@ void CanMove(char *comm, Stack *stack, int line, char *c, long *arg, unsigned *a
 		case DEG: case CLONE: case IS_COEFF: case IS_ZERO: case NEG: case POP: case PRINT:
 			argNumb = 1;
 			break;
+		case EXPLAIN: case STATS:
+			argNumb = 0;
+			break;
+		case LIMIT:
+			*arg2 = LIMIT_REPORT;
+			if (*c == ' ') {
+				ReadLetter(&number, c);
+				*proper = ReadName(c, &number, ins->name) && ParseLimit(ins->name, arg2);
+				if (*proper && *arg2 != LIMIT_OFF) {
+					if (*c == ' ')
+						ReadLetter(&number, c);
+					else *proper = false;
+					if (*proper && IsNumber(*c))
+						*arg = ReadNumb(c, &number, proper, ValidateLONG);
+					else *proper = false;
+				}
+			}
+			if (!*proper)
+				ErrArg(line, command);
+			argNumb = 0;
+			break;
+		case CACHE:
+			*arg2 = CACHE_REPORT;
+			if (*c == ' ') {
+				ReadLetter(&number, c);
+				if (IsNumber(*c)) {
+					*arg = ReadNumb(c, &number, proper, ValidateLONG);
+					*arg2 = CACHE_LIMIT;
+				}
+				else if (ReadWord(c, &number, "CLEAR"))
+					*arg2 = CACHE_CLEAR;
+				else *proper = false;
+			}
+			if (!*proper)
+				ErrArg(line, command);
+			argNumb = 0;
+			break;
+		case MEMORY:
+			*arg2 = MEMORY_TOP;
+			if (*c == ' ') {
+				ReadLetter(&number, c);
+				if (IsNumber(*c))
+					*arg2 = ReadNumb(c, &number, proper, ValidateUNSIGNED);
+				else *proper = false;
+			}
+			if (!*proper)
+				ErrArg(line, command);
+			argNumb = 0;
+			break;
 		case DEG_BY:
 			if (*c == ' ') {
 				ReadLetter(&number, c);
@@ -533,6 +880,66 @@ void CanMove(char *comm, Stack *stack, int line, char *c, long *arg, unsigned *a
 				ErrArg(line, command);
 			argNumb = 1;
 			break;
+		case PROB_EQ:
+			if (*c == ' ') {
+				ReadLetter(&number, c);
+				if (IsNumber(*c))
+					*arg2 = ReadNumb(c, &number, proper, ValidateUNSIGNED);
+				else *proper = false;
+			}
+			else *proper = false;
+			if (*proper && *arg2 == 0)
+				*proper = false;
+			if (!*proper)
+				ErrArg(line, command);
+			argNumb = 2;
+			break;
+		case MUL_TRUNC:
+			*arg = ReadDegree(c, &number, proper);
+			if (!*proper)
+				ErrArg(line, command);
+			argNumb = 2;
+			break;
+		case EXP_TRUNC:
+			*arg2 = (unsigned)ReadDegree(c, &number, proper);
+			if (*proper)
+				*arg = ReadDegree(c, &number, proper);
+			if (!*proper)
+				ErrArg(line, command);
+			argNumb = 1;
+			break;
+		case MUL_STRATEGY:
+			if (*c == ' ') {
+				ReadLetter(&number, c);
+				*proper = ReadName(c, &number, ins->name);
+			}
+			else *proper = false;
+			if (*proper && !ParseStrategy(ins->name, arg2))
+				*proper = false;
+			if (!*proper)
+				ErrArg(line, command);
+			argNumb = 0;
+			break;
+		case MULTI_AT:
+			if (*c == ' ') {
+				ReadLetter(&number, c);
+				*proper = ReadPath(c, &number, ins->name);
+			}
+			else *proper = false;
+			if (!*proper)
+				ErrArg(line, command);
+			argNumb = 1;
+			break;
+		case DROP: case LOAD: case STORE:
+			if (*c == ' ') {
+				ReadLetter(&number, c);
+				*proper = ReadName(c, &number, ins->name);
+			}
+			else *proper = false;
+			if (!*proper)
+				ErrArg(line, command);
+			argNumb = command == STORE;
+			break;
 		case ZERO:
 			argNumb = 0;
 			break;
@@ -543,15 +950,30 @@ void CanMove(char *comm, Stack *stack, int line, char *c, long *arg, unsigned *a
 	}
 	if (*proper && *c != NEW_LINE) {
 		*proper = false;
-		if (command != AT && command != DEG_BY && command != COMPOSE)
+		if (command != AT && command != DEG_BY && command != COMPOSE && command != MEMORY && command != CACHE
+				&& command != DROP && command != EXP_TRUNC && command != LIMIT && command != LOAD && command != MUL_STRATEGY
+				&& command != MUL_TRUNC && command != PROB_EQ && command != STORE)
 			ErrCommand(line);
 		else
 			ErrArg(line, command);
 	}
-	if (*proper)
-		*proper = *proper & CanMoveStack(argNumb, stack, line);
+	ins->argNumb = argNumb;
+}
 
-} 
+/**
+ *Sprawdza czy można wykonać poprawnie wczytaną komendę w obecnym stanie kalkulatora
+ *@param[in] ins : linia z komendą
+ *@param[in] stack : stos z wielomianami
+ *@return true jeśli można wykonać komendę
+ */
+bool CanMove(const Instruction *ins, Stack *stack) {
+	unsigned long command = Hash(ins->command);
+	if ((command == DROP || command == LOAD) && RegisterFind(ins->name) == NULL) {
+		ErrArg(ins->line, command);
+		return false;
+	}
+	return CanMoveStack(ins->argNumb, stack, ins->line);
+}
 
 /**
  *Uzupełnia tablicę wielomianów wartościami ze stosu
@@ -569,57 +991,364 @@ void GetPolies(Stack *stack, unsigned count, Poly polies[]) {
 }
 
 /**
- *Wykonuje ruch
- *@param[in] comm : komenda do wykonania
+ *Przygotowuje stan kalkulatora przed wykonaniem skryptu
+ */
+void Init() {
+	for (unsigned i = 0 ; i < COMMANDS ; i++)
+		commandHashes[i] = Hash(commandNames[i]);
+	StatsReset();
+	CacheSetLimit(0);
+	CacheClear();
+	RegisterClear();
+	PolyMulSetStrategy(MUL_AUTO);
+	limits = (Budget) {0, 0, 0};
+	explainNext = false;
+	packedEngine = false;
+	statsOnExit = false;
+	pipeline = false;
+	workers = 0;
+	checkOverflow = false;
+	memLimit = 0;
+}
+
+/**
+ *Zwraca numer komendy w tablicy @ref commandNames
+ *@param[in] command : liczbowa reprezentacja komendy
+ *@return numer komendy
+ */
+unsigned CommandIndex(unsigned long command) {
+	unsigned i = 0;
+	while (i + 1 < COMMANDS && commandHashes[i] != command)
+		i++;
+	return i;
+}
+
+/**
+ *Liczy jednomiany wielomianu na najwyższym poziomie, wliczając wyraz wolny
+ *@param[in] p : wielomian
+ *@return liczba jednomianów
+ */
+uint64_t Terms(const Poly *p) {
+	uint64_t result = p->coef != 0;
+	for (List *l = p->monos ; l != NULL ; l = l->next)
+		result++;
+	return result;
+}
+
+/**
+ *Liczy jednomiany wielomianu z elementu stosu; w postaci upakowanej
+ *są to wszystkie wyrazy wielomianu. Wielomiany na stosie się nie zmieniają,
+ *więc liczba jest zapamiętywana w elemencie i każdy wielomian jest
+ *przeglądany najwyżej raz, a komendy takie jak IS_ZERO pozostają stałego czasu.
+ *@param[in] s : element stosu
+ *@return liczba jednomianów
+ */
+uint64_t SlotTerms(Stack *s) {
+	if (packedEngine)
+		return s->packed.size;
+	if (s->terms == TERMS_UNKNOWN)
+		s->terms = Terms(&(s->value));
+	return s->terms;
+}
+
+/**
+ *Liczy jednomiany argumentów komendy leżących na wierzchu stosu
+ *@param[in] command : liczbowa reprezentacja komendy
  *@param[in] stack : stos wielomianów
- *@param[in] arg : argument do PolyAt
- *@param[in] arg2 : argument do PolyDegBy ilość wielomianów w COMPOSE
+ *@param[in] arg2 : ilość wielomianów w COMPOSE
+ *@return liczba jednomianów argumentów
  */
-void Move(char *comm, Stack **stack, long arg, unsigned arg2) {
-	Poly result, tmp;
-	Poly polies[arg2];
-	unsigned long command = Hash(comm);
-	switch(command) {
-		case ADD:
-			result = PolyAdd(&((*stack)->value), &((*stack)->pop->value));
-			*stack = PopStack(*stack, 2);
-			*stack = AddStack(*stack, result);
-			break;
-		case AT:
-			result = PolyAt(&((*stack)->value), arg);		
-			*stack = PopStack(*stack, 1);
-			*stack = AddStack(*stack, result);		
-			break;
-		case CLONE:
-			*stack = AddStack(*stack, PolyClone(&((*stack)->value)));
-			break;
-		case COMPOSE:	
-			tmp = (*stack)->value;
-			GetPolies(*stack, arg2, polies);
-			result = PolyCompose(&tmp, arg2, polies);
-			*stack = PopStack(*stack, arg2 + 1);
-			*stack = AddStack(*stack, result);
+uint64_t ArgTerms(unsigned long command, Stack *stack, unsigned arg2) {
+	unsigned long count;
+	switch (command) {
+		case ADD: case IS_EQ: case MUL: case MUL_TRUNC: case PROB_EQ: case SUB:
+			count = 2;
 			break;
-		case DEG:
-			printf("%d\n", PolyDeg(&((*stack)->value)));
+		case COMPOSE:
+			count = (unsigned long)arg2 + 1;
 			break;
-		case DEG_BY:
-			printf("%d\n", PolyDegBy(&((*stack)->value),arg2));
+		case CACHE: case DROP: case EXPLAIN: case LIMIT: case LOAD: case MEMORY: case MUL_STRATEGY: case STATS: case ZERO:
+			count = 0;
 			break;
-		case IS_COEFF:
-			printf("%d\n", PolyIsCoeff(&((*stack)->value)));
+		default:
+			count = 1;
+	}
+	uint64_t result = 0;
+	for (; count > 0 && stack->pop != NULL ; count--, stack = stack->pop)
+		result += SlotTerms(stack);
+	return result;
+}
+
+/**
+ *Sprawdza, czy komenda kładzie wynik na stosie
+ *@param[in] command : liczbowa reprezentacja komendy
+ *@return true jeśli komenda kładzie wynik na stosie, false w przeciwnym razie
+ */
+bool PushesResult(unsigned long command) {
+	switch (command) {
+		case ADD: case AT: case CLONE: case COMPOSE: case EXP_TRUNC: case LOAD: case MUL: case MUL_TRUNC:
+		case NEG: case SUB: case ZERO:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/**
+ *Wypisuje statystyki wykonanych komend, po jednym wierszu na komendę
+ *@param[in] err : czy wypisać je na standardowe wyjście błędów
+ */
+void PrintStats(bool err) {
+	char line[MAX_STATS_LINE];
+	for (unsigned i = 0 ; i < COMMANDS ; i++) {
+		const CommandStats *s = StatsGet(i);
+		if (s->count == 0)
+			continue;
+		snprintf(line, sizeof(line), "%s %s count=%" PRIu64 " total_ns=%" PRIu64
+				" p50_ns=%" PRIu64 " p90_ns=%" PRIu64 " p99_ns=%" PRIu64 " max_ns=%" PRIu64
+				" terms_in=%" PRIu64 " terms_out=%" PRIu64,
+				"STATS", commandNames[i], s->count, s->totalNs,
+				StatsPercentile(s, 50), StatsPercentile(s, 90), StatsPercentile(s, 99), s->maxNs,
+				s->termsIn, s->termsOut);
+		if (err)
+			ERR("%s\n", line);
+		else OUT("%s\n", line);
+	}
+}
+
+/**
+ *Zużycie pamięci przez element stosu
+ */
+typedef struct SlotMemory {
+	unsigned long slot;///<numer elementu licząc od wierzchołka stosu
+	size_t bytes;///<bajty zajmowane przez element razem z wielomianem
+	size_t nodes;///<liczba węzłów elementu razem z wielomianem
+} SlotMemory;
+
+/**
+ *Wypisuje zużycie pamięci procesu i najcięższe elementy stosu
+ *@param[in] stack : stos wielomianów
+ *@param[in] top : ile najcięższych elementów wypisać
+ */
+void PrintMemory(Stack *stack, unsigned top) {
+	MemoryUsage usage = MemUsage();
+	OUT("MEMORY live_bytes=%zu peak_bytes=%zu live_nodes=%zu peak_nodes=%zu stack=%lu\n",
+			usage.liveBytes, usage.peakBytes, usage.liveNodes, usage.peakNodes, stack->size);
+	if (top > stack->size)
+		top = (unsigned)stack->size;
+	if (top == 0)
+		return;
+	SlotMemory *heaviest = (SlotMemory *)malloc(top * sizeof(SlotMemory));
+	assert(heaviest != NULL);
+	unsigned found = 0;
+	unsigned long slot = 0;
+	for (Stack *s = stack ; s->pop != NULL ; s = s->pop, slot++) {
+		SlotMemory m;
+		if (packedEngine)
+			m = (SlotMemory) {slot, PackedBytes(&(s->packed)) + sizeof(Stack), (s->packed.terms != NULL) + 1};
+		else {
+			size_t listNodes = PolyNodes(&(s->value));
+			m = (SlotMemory) {slot, listNodes * sizeof(List) + sizeof(Stack), listNodes + 1};
+		}
+		if (found == top && heaviest[top - 1].bytes >= m.bytes)
+			continue;
+		unsigned i = found < top ? found++ : top - 1;
+		while (i > 0 && heaviest[i - 1].bytes < m.bytes) {
+			heaviest[i] = heaviest[i - 1];
+			i--;
+		}
+		heaviest[i] = m;
+	}
+	for (unsigned i = 0 ; i < found ; i++)
+		OUT("MEMORY TOP %u slot=%lu bytes=%zu nodes=%zu\n",
+				i + 1, heaviest[i].slot, heaviest[i].bytes, heaviest[i].nodes);
+	free(heaviest);
+}
+
+/**
+ *Wykonuje komendę CACHE: ustawia rozmiar pamięci podręcznej wyników,
+ *czyści ją albo wypisuje jej stan
+ *@param[in] mode : @ref CACHE_REPORT, @ref CACHE_LIMIT lub @ref CACHE_CLEAR
+ *@param[in] limit : rozmiar pamięci podręcznej w bajtach dla @ref CACHE_LIMIT
+ */
+void Cache(unsigned mode, long limit) {
+	if (mode == CACHE_LIMIT)
+		CacheSetLimit((size_t)limit);
+	else if (mode == CACHE_CLEAR)
+		CacheClear();
+	else {
+		CacheUsage usage = CacheGetUsage();
+		OUT("CACHE limit_bytes=%zu bytes=%zu entries=%zu hits=%lu misses=%lu\n",
+				usage.limit, usage.bytes, usage.entries, usage.hits, usage.misses);
+	}
+}
+
+/**
+ *Wykonuje komendę LIMIT: ustawia lub znosi ograniczenia zasobów albo je wypisuje
+ *@param[in] kind : @ref LIMIT_TERMS, @ref LIMIT_BYTES, @ref LIMIT_MS, @ref LIMIT_OFF lub @ref LIMIT_REPORT
+ *@param[in] value : wartość ograniczenia, 0 znosi je
+ */
+void Limit(unsigned kind, long value) {
+	if (kind == LIMIT_TERMS)
+		limits.terms = (uint64_t)value;
+	else if (kind == LIMIT_BYTES)
+		limits.bytes = (uint64_t)value;
+	else if (kind == LIMIT_MS)
+		limits.ms = (uint64_t)value;
+	else if (kind == LIMIT_OFF)
+		limits = (Budget) {0, 0, 0};
+	else OUT("LIMIT terms=%" PRIu64 " bytes=%" PRIu64 " ms=%" PRIu64 "\n", limits.terms, limits.bytes, limits.ms);
+}
+
+/**
+ *Sprawdza, czy komenda mnoży, potęguje lub podstawia, czyli czy podlega
+ *ograniczeniom z LIMIT i oszacowaniu z EXPLAIN
+ *@param[in] command : liczbowa reprezentacja komendy
+ *@return true dla MUL, MUL_TRUNC, EXP_TRUNC i COMPOSE
+ */
+bool IsLimitable(unsigned long command) {
+	return command == COMPOSE || command == EXP_TRUNC || command == MUL || command == MUL_TRUNC;
+}
+
+/**
+ *Sprawdza, czy komenda liczy z ograniczeniami zasobów ustawionymi przez LIMIT
+ *@param[in] command : liczbowa reprezentacja komendy
+ *@return true jeśli jakieś ograniczenie jest ustawione, a komenda mu podlega
+ */
+bool IsLimited(unsigned long command) {
+	return (limits.terms > 0 || limits.bytes > 0 || limits.ms > 0) && IsLimitable(command);
+}
+
+/**
+ *Kończy liczenie komendy z ograniczeniami zasobów. Przerwane obliczenie
+ *zostawia wynik do odrzucenia, a stos bez zmian.
+ *@param[in] limited : czy komenda liczyła z ograniczeniami
+ *@return true jeśli komenda przekroczyła ograniczenia
+ */
+bool OverLimit(bool limited) {
+	if (!limited || !BudgetStop())
+		return false;
+	limitExceeded = true;
+	return true;
+}
+
+/**
+ *Wypisuje oszacowanie rozmiaru wyniku MUL, MUL_TRUNC, EXP_TRUNC lub COMPOSE
+ *zamiast ją wykonywać; stos się nie zmienia
+ *@param[in] command : liczbowa reprezentacja komendy
+ *@param[in] stack : stos wielomianów z argumentami na wierzchu
+ *@param[in] arg2 : wykładnik w EXP_TRUNC albo ilość wielomianów w COMPOSE
+ */
+void Explain(unsigned long command, Stack *stack, unsigned arg2) {
+	size_t count = command == COMPOSE ? (size_t)arg2 + 1 : command == EXP_TRUNC ? 1 : 2;
+	ScratchMark mark = ScratchSave();
+	Poly *polies = (Poly *)ScratchAlloc(count * sizeof(Poly));
+	Stack *s = stack;
+	for (size_t i = 0 ; i < count ; i++, s = s->pop)
+		polies[i] = packedEngine ? PackedToPoly(&(s->packed)) : s->value;
+	BudgetCost cost;
+	if (command == COMPOSE)
+		cost = BudgetComposeCost(&(polies[0]), arg2, polies + 1);
+	else if (command == EXP_TRUNC)
+		cost = BudgetExpCost(&(polies[0]), (poly_exp_t)arg2);
+	else cost = BudgetMulCost(&(polies[0]), &(polies[1]));
+	OUT("EXPLAIN terms=%" PRIu64 " bytes=%" PRIu64 "\n", cost.terms, cost.bytes);
+	for (size_t i = 0 ; packedEngine && i < count ; i++)
+		PolyDestroy(&(polies[i]));
+	ScratchRestore(mark);
+}
+
+/**
+ *Wykonuje ruch na wielomianach rekurencyjnych
+ *@param[in] command : liczbowa reprezentacja komendy
+ *@param[in] stack : stos wielomianów
+ *@param[in] arg : argument do PolyAt
+ *@param[in] arg2 : argument do PolyDegBy ilość wielomianów w COMPOSE
+ */
+void Execute(unsigned long command, Stack **stack, long arg, unsigned arg2) {
+	Poly result, tmp;
+	Poly *polies;
+	ScratchMark mark;
+	bool exact = true;
+	bool limited = IsLimited(command);
+	if (limited)
+		BudgetStart(&limits);
+	switch(command) {
+		case ADD:
+			result = PolyAdd(&((*stack)->value), &((*stack)->pop->value));
+			*stack = PopStack(*stack, 2);
+			*stack = AddStack(*stack, result);
+			break;
+		case AT:
+			result = PolyAt(&((*stack)->value), arg);		
+			*stack = PopStack(*stack, 1);
+			*stack = AddStack(*stack, result);		
+			break;
+		case CLONE:
+			*stack = AddStack(*stack, PolyClone(&((*stack)->value)));
+			break;
+		case COMPOSE:	
+			tmp = (*stack)->value;
+			mark = ScratchSave();
+			polies = (Poly *)ScratchAlloc(((size_t)arg2 + 1) * sizeof(Poly));
+			GetPolies(*stack, arg2, polies);
+			result = PolyCompose(&tmp, arg2, polies);
+			ScratchRestore(mark);
+			if (OverLimit(limited)) {
+				PolyDestroy(&result);
+				break;
+			}
+			*stack = PopStack(*stack, arg2 + 1);
+			*stack = AddStack(*stack, result);
+			break;
+		case DEG:
+			OUT("%d\n", PolyDeg(&((*stack)->value)));
+			break;
+		case DEG_BY:
+			OUT("%d\n", PolyDegBy(&((*stack)->value),arg2));
+			break;
+		case IS_COEFF:
+			OUT("%d\n", PolyIsCoeff(&((*stack)->value)));
 			break;
 		case IS_ZERO:
-			printf("%d\n", PolyIsZero(&((*stack)->value)));
+			OUT("%d\n", PolyIsZero(&((*stack)->value)));
 			break;
 		case IS_EQ:
-			printf("%d\n", PolyIsEq(&((*stack)->value), &((*stack)->pop->value)));
+			OUT("%d\n", PolyIsEq(&((*stack)->value), &((*stack)->pop->value)));
+			break;
+		case PROB_EQ:
+			OUT("%d\n", PolyProbablyEq(&((*stack)->value), &((*stack)->pop->value), arg2));
 			break;
 		case MUL:
-			result = PolyMul(&((*stack)->value), &((*stack)->pop->value));
+			if (!checkOverflow)
+				result = PolyMul(&((*stack)->value), &((*stack)->pop->value));
+			else exact = PolyMulChecked(&((*stack)->value), &((*stack)->pop->value), &result);
+			if (OverLimit(limited) || !exact) {
+				PolyDestroy(&result);
+				mulOverflowed = !limitExceeded;
+				break;
+			}
+			*stack = PopStack(*stack, 2);
+			*stack = AddStack(*stack, result);
+			break;
+		case MUL_TRUNC:
+			result = PolyMulTrunc(&((*stack)->value), &((*stack)->pop->value), (poly_exp_t)arg);
+			if (OverLimit(limited)) {
+				PolyDestroy(&result);
+				break;
+			}
 			*stack = PopStack(*stack, 2);
 			*stack = AddStack(*stack, result);
 			break;
+		case EXP_TRUNC:
+			result = PolyExpTrunc(&((*stack)->value), (poly_exp_t)arg2, (poly_exp_t)arg);
+			if (OverLimit(limited)) {
+				PolyDestroy(&result);
+				break;
+			}
+			*stack = PopStack(*stack, 1);
+			*stack = AddStack(*stack, result);
+			break;
 		case NEG:
 			result = PolyNeg(&((*stack)->value));
 			*stack = PopStack(*stack, 1);
@@ -630,7 +1359,25 @@ void Move(char *comm, Stack **stack, long arg, unsigned arg2) {
 			break;
 		case PRINT:
 			Print(&((*stack)->value));
-			printf("\n");
+			OUT("\n");
+			break;
+		case STATS:
+			PrintStats(false);
+			break;
+		case MEMORY:
+			PrintMemory(*stack, arg2);
+			break;
+		case CACHE:
+			Cache(arg2, arg);
+			break;
+		case MUL_STRATEGY:
+			PolyMulSetStrategy((MulStrategy)arg2);
+			break;
+		case LIMIT:
+			Limit(arg2, arg);
+			break;
+		case EXPLAIN:
+			explainNext = true;
 			break;
 		case SUB:
 			result = PolySub(&((*stack)->value), &((*stack)->pop->value));
@@ -642,51 +1389,895 @@ void Move(char *comm, Stack **stack, long arg, unsigned arg2) {
 			break;
 	}
 }
-//\cond
-int main() {
-	Init();
+
+/**
+ *Drukuje wielomian w postaci upakowanej
+ *@param[in] p : wielomian do wydrukowania
+ */
+void PrintPacked(const PackedPoly *p) {
+	Poly tmp = PackedToPoly(p);
+	Print(&tmp);
+	PolyDestroy(&tmp);
+}
+
+/**
+ *Składa wielomiany w postaci upakowanej, przechodząc przez wielomiany rekurencyjne
+ *@param[in] stack : stos, na którego wierzchu leży składany wielomian, a pod nim podstawiane
+ *@param[in] count : liczba wielomianów do podstawienia
+ *@return wielomian po podstawieniu
+ */
+PackedPoly ComposePacked(Stack *stack, unsigned count) {
+	ScratchMark mark = ScratchSave();
+	Poly *polies = (Poly *)ScratchAlloc(((size_t)count + 1) * sizeof(Poly));
+	polies[count] = PackedToPoly(&(stack->packed));
+	Stack *s = stack->pop;
+	for (unsigned i = 0 ; i < count ; i++, s = s->pop)
+		polies[i] = PackedToPoly(&(s->packed));
+	Poly composed = PolyCompose(&(polies[count]), count, polies);
+	PackedPoly result = PackedFromPoly(&composed);
+	PolyDestroy(&composed);
+	for (unsigned i = 0 ; i <= count ; i++)
+		PolyDestroy(&(polies[i]));
+	ScratchRestore(mark);
+	return result;
+}
+
+/**
+ *Liczy MUL_TRUNC albo EXP_TRUNC na wielomianach w postaci upakowanej,
+ *przechodząc przez wielomiany rekurencyjne
+ *@param[in] command : liczbowa reprezentacja komendy
+ *@param[in] stack : stos, na którego wierzchu leżą argumenty
+ *@param[in] arg : ograniczenie stopnia
+ *@param[in] arg2 : wykładnik w EXP_TRUNC
+ *@return obcięty iloczyn albo obcięta potęga
+ */
+PackedPoly TruncPacked(unsigned long command, Stack *stack, long arg, unsigned arg2) {
+	Poly a = PackedToPoly(&(stack->packed));
+	Poly result;
+	if (command == MUL_TRUNC) {
+		Poly b = PackedToPoly(&(stack->pop->packed));
+		result = PolyMulTrunc(&a, &b, (poly_exp_t)arg);
+		PolyDestroy(&b);
+	}
+	else result = PolyExpTrunc(&a, (poly_exp_t)arg2, (poly_exp_t)arg);
+	PackedPoly packed = PackedFromPoly(&result);
+	PolyDestroy(&a);
+	PolyDestroy(&result);
+	return packed;
+}
+
+/**
+ *Sprawdza probabilistycznie równość wielomianów w postaci upakowanej,
+ *przechodząc przez wielomiany rekurencyjne
+ *@param[in] p : wielomian
+ *@param[in] q : wielomian
+ *@param[in] k : liczba prób
+ *@return wynik PolyProbablyEq
+ */
+bool ProbablyEqPacked(const PackedPoly *p, const PackedPoly *q, unsigned k) {
+	Poly a = PackedToPoly(p);
+	Poly b = PackedToPoly(q);
+	bool result = PolyProbablyEq(&a, &b, k);
+	PolyDestroy(&a);
+	PolyDestroy(&b);
+	return result;
+}
+
+/**
+ *Wykonuje ruch na wielomianach w postaci upakowanej
+ *@param[in] command : liczbowa reprezentacja komendy
+ *@param[in] stack : stos wielomianów
+ *@param[in] arg : argument do PackedAt
+ *@param[in] arg2 : argument do PackedDegBy ilość wielomianów w COMPOSE
+ */
+void ExecutePacked(unsigned long command, Stack **stack, long arg, unsigned arg2) {
+	PackedPoly result;
+	PackedPoly *top = &((*stack)->packed);
+	bool exact = true;
+	bool limited = IsLimited(command);
+	if (limited)
+		BudgetStart(&limits);
+	switch(command) {
+		case ADD:
+			result = PackedAdd(top, &((*stack)->pop->packed));
+			*stack = PopStack(*stack, 2);
+			*stack = AddPackedStack(*stack, result);
+			break;
+		case AT:
+			result = PackedAt(top, arg);
+			*stack = PopStack(*stack, 1);
+			*stack = AddPackedStack(*stack, result);
+			break;
+		case CLONE:
+			*stack = AddPackedStack(*stack, PackedClone(top));
+			break;
+		case COMPOSE:
+			result = ComposePacked(*stack, arg2);
+			if (OverLimit(limited)) {
+				PackedDestroy(&result);
+				break;
+			}
+			*stack = PopStack(*stack, arg2 + 1);
+			*stack = AddPackedStack(*stack, result);
+			break;
+		case DEG:
+			OUT("%d\n", PackedDeg(top));
+			break;
+		case DEG_BY:
+			OUT("%d\n", PackedDegBy(top, arg2));
+			break;
+		case IS_COEFF:
+			OUT("%d\n", PackedIsCoeff(top));
+			break;
+		case IS_ZERO:
+			OUT("%d\n", PackedIsZero(top));
+			break;
+		case IS_EQ:
+			OUT("%d\n", PackedIsEq(top, &((*stack)->pop->packed)));
+			break;
+		case PROB_EQ:
+			OUT("%d\n", ProbablyEqPacked(top, &((*stack)->pop->packed), arg2));
+			break;
+		case MUL:
+			if (!checkOverflow)
+				result = PackedMul(top, &((*stack)->pop->packed));
+			else result = PackedMulChecked(top, &((*stack)->pop->packed), &exact);
+			if (OverLimit(limited) || !exact) {
+				PackedDestroy(&result);
+				mulOverflowed = !limitExceeded;
+				break;
+			}
+			*stack = PopStack(*stack, 2);
+			*stack = AddPackedStack(*stack, result);
+			break;
+		case MUL_TRUNC: case EXP_TRUNC:
+			result = TruncPacked(command, *stack, arg, arg2);
+			if (OverLimit(limited)) {
+				PackedDestroy(&result);
+				break;
+			}
+			*stack = PopStack(*stack, command == MUL_TRUNC ? 2 : 1);
+			*stack = AddPackedStack(*stack, result);
+			break;
+		case NEG:
+			result = PackedNeg(top);
+			*stack = PopStack(*stack, 1);
+			*stack = AddPackedStack(*stack, result);
+			break;
+		case POP:
+			*stack = PopStack(*stack, 1);
+			break;
+		case PRINT:
+			PrintPacked(top);
+			OUT("\n");
+			break;
+		case STATS:
+			PrintStats(false);
+			break;
+		case MEMORY:
+			PrintMemory(*stack, arg2);
+			break;
+		case CACHE:
+			Cache(arg2, arg);
+			break;
+		case MUL_STRATEGY:
+			PolyMulSetStrategy((MulStrategy)arg2);
+			break;
+		case LIMIT:
+			Limit(arg2, arg);
+			break;
+		case EXPLAIN:
+			explainNext = true;
+			break;
+		case SUB:
+			result = PackedSub(top, &((*stack)->pop->packed));
+			*stack = PopStack(*stack, 2);
+			*stack = AddPackedStack(*stack, result);
+			break;
+		case ZERO:
+			*stack = AddPackedStack(*stack, PackedZero());
+			break;
+	}
+}
+
+/**
+ *Wykonuje ruch na rejestrach, wspólny dla obu postaci wielomianów.
+ *STORE przenosi wierzchołek stosu do rejestru, a LOAD kładzie na stosie
+ *element pożyczający wielomiany rejestru; żaden z nich nie kopiuje wielomianu.
+ *@param[in] command : liczbowa reprezentacja komendy
+ *@param[in] stack : stos wielomianów
+ *@param[in] name : nazwa rejestru
+ */
+void ExecuteRegister(unsigned long command, Stack **stack, const char *name) {
+	RegisterValue *v;
+	switch(command) {
+		case STORE:
+			if ((*stack)->shared != NULL)
+				v = RegisterValueRetain((*stack)->shared);
+			else {
+				v = RegisterValueNew((*stack)->value, (*stack)->packed, (*stack)->terms);
+				(*stack)->value = PolyZero();
+				(*stack)->packed = PackedZero();
+			}
+			*stack = PopStack(*stack, 1);
+			RegisterStore(name, v);
+			break;
+		case LOAD:
+			v = RegisterFind(name);
+			*stack = AddStack(*stack, v->value);
+			(*stack)->packed = v->packed;
+			(*stack)->terms = v->terms;
+			(*stack)->shared = RegisterValueRetain(v);
+			break;
+		case DROP:
+			RegisterDrop(name);
+			break;
+	}
+}
+
+/**
+ *Zamienia słowo pliku punktów na liczbę, sprawdzając zakres jak argument AT
+ *@param[in] word : słowo
+ *@param[in] x : miejsce na liczbę
+ *@return true jeśli słowo jest poprawną liczbą
+ */
+bool ParsePoint(const char *word, poly_coeff_t *x) {
+	unsigned long result = 0;
+	int sgn = 1;
+	if (*word == '-') {
+		sgn = -1;
+		word++;
+	}
+	if (!IsNumber(*word))
+		return false;
+	for (; IsNumber(*word) ; word++) {
+		result = 10 * result + (unsigned long)(*word - '0');
+		if (!ValidateLONG(result, sgn))
+			return false;
+	}
+	*x = sgn * (long)result;
+	return *word == EMPTY_CHAR;
+}
+
+/**
+ *Wczytuje punkty z pliku: liczby rozdzielone białymi znakami
+ *@param[in] path : ścieżka pliku
+ *@param[in] count : miejsce na liczbę punktów
+ *@return tablica punktów do zwolnienia przez free albo NULL, jeśli pliku
+ *nie da się odczytać lub zawiera coś innego niż liczby
+ */
+poly_coeff_t *ReadPoints(const char *path, size_t *count) {
+	FILE *f = fopen(path, "r");
+	if (f == NULL)
+		return NULL;
+	size_t capacity = TEXT_BEG;
+	poly_coeff_t *points = (poly_coeff_t *)malloc(capacity * sizeof(poly_coeff_t));
+	assert(points != NULL);
+	char word[MAX_POINT_LENGTH + 1];
+	bool proper = true;
+	*count = 0;
+	while (proper && fscanf(f, "%63s", word) == 1) {
+		if (*count == capacity) {
+			capacity *= 2;
+			points = (poly_coeff_t *)realloc(points, capacity * sizeof(poly_coeff_t));
+			assert(points != NULL);
+		}
+		proper = strlen(word) < MAX_POINT_LENGTH && ParsePoint(word, &(points[(*count)++]));
+	}
+	proper = proper && !ferror(f);
+	fclose(f);
+	if (!proper) {
+		free(points);
+		return NULL;
+	}
+	return points;
+}
+
+/**
+ *Wykonuje MULTI_AT: wypisuje wartości wierzchołkowego wielomianu we wszystkich
+ *punktach z pliku, po jednej w linii, tak jak AT i PRINT
+ *@param[in] stack : stos wielomianów
+ *@param[in] path : ścieżka pliku z punktami
+ */
+void ExecuteMultiAt(Stack *stack, const char *path) {
+	size_t count;
+	poly_coeff_t *points = ReadPoints(path, &count);
+	if (points == NULL) {
+		pointsUnreadable = true;
+		return;
+	}
+	Poly *values = (Poly *)malloc((count + 1) * sizeof(Poly));
+	assert(values != NULL);
+	if (packedEngine) {
+		Poly p = PackedToPoly(&(stack->packed));
+		PolyMultiAt(&p, count, points, values);
+		PolyDestroy(&p);
+	}
+	else PolyMultiAt(&(stack->value), count, points, values);
+	for (size_t i = 0 ; i < count ; i++) {
+		Print(&(values[i]));
+		OUT("\n");
+		PolyDestroy(&(values[i]));
+	}
+	free(values);
+	free(points);
+}
+
+/**
+ *Wykonuje ruch i zapisuje jego czas oraz liczby jednomianów w statystykach
+ *@param[in] comm : komenda do wykonania
+ *@param[in] stack : stos wielomianów
+ *@param[in] arg : argument do PolyAt
+ *@param[in] arg2 : argument do PolyDegBy ilość wielomianów w COMPOSE
+ *@param[in] name : nazwa rejestru w STORE, LOAD i DROP albo ścieżka pliku w MULTI_AT
+ */
+void Move(char *comm, Stack **stack, long arg, unsigned arg2, const char *name) {
+	unsigned long command = Hash(comm);
+	uint64_t termsIn = ArgTerms(command, *stack, arg2);
+	uint64_t start = StatsNow();
+	if (command == DROP || command == LOAD || command == STORE)
+		ExecuteRegister(command, stack, name);
+	else if (command == MULTI_AT)
+		ExecuteMultiAt(*stack, name);
+	else if (packedEngine)
+		ExecutePacked(command, stack, arg, arg2);
+	else Execute(command, stack, arg, arg2);
+	uint64_t ns = StatsNow() - start;
+	StatsRecord(CommandIndex(command), ns, termsIn, PushesResult(command) ? SlotTerms(*stack) : 0);
+}
+/**
+ *Komenda wykonywana przez pulę wątków na odłączonych elementach stosu
+ */
+typedef struct Job {
+	unsigned long command;///<liczbowa reprezentacja komendy
+	long arg;///<argument do PolyAt
+	unsigned arg2;///<ilość wielomianów w COMPOSE
+	int line;///<numer linii
+	Stack *operands;///<odłączone elementy stosu z argumentami, od wierzchołka
+	Stack *result;///<element stosu, do którego trafi wynik
+} Job;
+
+/**
+ *Sprawdza, czy komendę może wykonać pula wątków: komenda tylko liczy
+ *nowy wielomian ze zdjętych ze stosu argumentów i niczego nie wypisuje
+ *@param[in] command : liczbowa reprezentacja komendy
+ *@return true jeśli komendę może wykonać pula wątków
+ */
+bool IsDataflow(unsigned long command) {
+	switch (command) {
+		case MUL:
+			return !checkOverflow && !IsLimited(command);
+		case COMPOSE: case EXP_TRUNC: case MUL_TRUNC:
+			return !IsLimited(command);
+		case ADD: case AT: case NEG: case SUB:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/**
+ *Wykonuje komendę zleconą puli wątków. Argumenty są już policzone, więc
+ *wystarczy dołożyć pod nimi dno stosu, wykonać komendę jak zwykle
+ *i przenieść wynik do elementu czekającego na stosie kalkulatora.
+ *@param[in] data : komenda
+ */
+void RunJob(void *data) {
+	Job *job = (Job *)data;
+	Stack *operands = job->operands;
+	Stack *last = operands;
+	for (Stack *s = operands ; s != NULL ; last = s, s = s->pop)
+		if (s->task != NULL) {
+			TaskRelease(s->task);
+			s->task = NULL;
+		}
+	Stack *base = NewStack(PolyZero(), 0);
+	last->pop = base;
+	TraceBegin(commandNames[CommandIndex(job->command)], "line", job->line);
+	uint64_t termsIn = ArgTerms(job->command, operands, job->arg2);
+	uint64_t start = StatsNow();
+	if (packedEngine)
+		ExecutePacked(job->command, &operands, job->arg, job->arg2);
+	else Execute(job->command, &operands, job->arg, job->arg2);
+	uint64_t ns = StatsNow() - start;
+	StatsRecord(CommandIndex(job->command), ns, termsIn, SlotTerms(operands));
+	TraceEnd();
+	job->result->value = operands->value;
+	job->result->packed = operands->packed;
+	job->result->terms = operands->terms;
+	MemFree(operands, sizeof(Stack));
+	DeleteStack(base);
+	free(job);
+}
+
+/**
+ *Zleca komendę puli wątków: odłącza od stosu elementy z argumentami
+ *i kładzie na stosie element, którego wielomian policzy zadanie.
+ *Zadanie zależy od zadań liczących argumenty.
+ *@param[in] ins : linia z komendą
+ *@param[in] stack : stos wielomianów
+ */
+void Spawn(const Instruction *ins, Stack **stack) {
+	Job *job = (Job *)malloc(sizeof(Job));
+	Task **inputs = (Task **)malloc(ins->argNumb * sizeof(Task *));
+	assert(job != NULL && inputs != NULL);
+	*job = (Job) {Hash(ins->command), ins->arg, ins->arg2, ins->line, *stack, NULL};
+	Stack *last = *stack;
+	for (unsigned i = 0 ; i < ins->argNumb ; i++) {
+		inputs[i] = (*stack)->task;
+		Unlist(*stack);
+		last = *stack;
+		*stack = (*stack)->pop;
+	}
+	last->pop = NULL;
+	job->result = NewStack(PolyZero(), (*stack)->size + 1);
+	job->result->pop = *stack;
+	*stack = job->result;
+	(*stack)->task = TaskSubmit(RunJob, job, ins->argNumb, inputs);
+	free(inputs);
+}
+
+/**
+ *Czeka, aż pula wątków policzy wielomiany potrzebne komendzie wykonywanej
+ *na bieżącym wątku. Komendy wypisujące stan całego kalkulatora czekają
+ *na wszystkie zlecone zadania.
+ *@param[in] ins : linia z komendą
+ *@param[in] stack : stos wielomianów
+ */
+void Resolve(const Instruction *ins, Stack *stack) {
+	unsigned long command = Hash(ins->command);
+	if (command == CACHE || command == LIMIT || command == MEMORY || command == MUL_STRATEGY || command == STATS) {
+		DataflowDrain();
+		return;
+	}
+	for (unsigned i = 0 ; i < ins->argNumb ; i++, stack = stack->pop)
+		if (stack->task != NULL) {
+			TaskWait(stack->task);
+			TaskRelease(stack->task);
+			stack->task = NULL;
+		}
+}
+
+/**
+ *Liczy bajty wielomianu elementu stosu i zapamiętuje je w elemencie;
+ *wielomiany na stosie się nie zmieniają
+ *@param[in] s : element stosu
+ *@return liczba bajtów
+ */
+size_t SlotBytes(Stack *s) {
+	if (s->bytes == 0)
+		s->bytes = packedEngine ? PackedBytes(&(s->packed)) : PolyNodes(&(s->value)) * sizeof(List);
+	return s->bytes;
+}
+
+/**
+ *Odkłada wielomian elementu stosu do pliku wymiany w postaci upakowanej
+ *i zwalnia go z pamięci
+ *@param[in] s : element stosu
+ *@return true jeśli udało się go zapisać
+ */
+bool SpillSlot(Stack *s) {
+	TraceBegin("spill", "bytes", (long)s->bytes);
+	if (packedEngine) {
+		s->spill = SpillStore(&(s->packed));
+		if (s->spill != NULL)
+			PackedDestroy(&(s->packed));
+	}
+	else {
+		PackedPoly packed = PackedFromPoly(&(s->value));
+		s->spill = SpillStore(&packed);
+		PackedDestroy(&packed);
+		if (s->spill != NULL) {
+			PolyDestroy(&(s->value));
+			s->value = PolyZero();
+		}
+	}
+	TraceEnd();
+	return s->spill != NULL;
+}
+
+/**
+ *Zapisuje użycie elementu stosu w bieżącej linii i przenosi go na koniec
+ *listy elementów do wymiany. Na liście są tylko elementy, które można
+ *odłożyć: gotowe, w pamięci, nie pożyczone z rejestru i nie mniejsze niż
+ *@ref SPILL_MIN_BYTES. Stan elementu zmienia się tylko wtedy, gdy jest
+ *używany, więc lista nie wymaga przeglądania stosu.
+ *@param[in] s : element stosu
+ */
+void Touch(Stack *s) {
+	s->used = tick;
+	if (memLimit == 0)
+		return;
+	Unlist(s);
+	if (s->spill != NULL || s->shared != NULL || s->task != NULL || SlotBytes(s) < SPILL_MIN_BYTES)
+		return;
+	s->colder = warmest;
+	if (warmest != NULL)
+		warmest->warmer = s;
+	else coldest = s;
+	warmest = s;
+	s->listed = true;
+}
+
+/**
+ *Wczytuje z powrotem elementy stosu potrzebne komendzie, odwzorowując
+ *je z pliku wymiany, i zapisuje ich użycie
+ *@param[in] stack : stos wielomianów
+ *@param[in] count : liczba elementów od wierzchołka
+ */
+void Reload(Stack *stack, unsigned count) {
+	for (unsigned i = 0 ; i < count && stack->pop != NULL ; i++, stack = stack->pop) {
+		if (stack->spill == NULL) {
+			Touch(stack);
+			continue;
+		}
+		TraceBegin("reload", "bytes", (long)stack->bytes);
+		PackedPoly view = SpillView(stack->spill);
+		if (packedEngine)
+			stack->packed = PackedClone(&view);
+		else stack->value = PackedToPoly(&view);
+		SpillFree(stack->spill);
+		stack->spill = NULL;
+		TraceEnd();
+		Touch(stack);
+	}
+}
+
+/**
+ *Odkłada do pliku wymiany najdawniej używane elementy z listy elementów
+ *do wymiany, dopóki zużycie pamięci przekracza @ref memLimit. Pomija
+ *elementy użyte w bieżącej linii.
+ */
+void SpillCold(void) {
+	while (MemUsage().liveBytes > memLimit && coldest != NULL && coldest->used < tick) {
+		Stack *s = coldest;
+		if (!SpillSlot(s))
+			return;
+		Unlist(s);
+	}
+}
+
+/**
+ *Wczytuje jedną linię skryptu: wielomian razem z upakowaniem go albo komendę
+ *z argumentami. Błędy składni są wypisywane od razu.
+ *@param[in] ins : miejsce na wczytaną linię
+ *@param[in] line : numer linii
+ *@return false jeśli wejście się skończyło
+ */
+bool ParseLine(Instruction *ins, int line) {
 	char c;
-	int line = NUM_BEG;
 	int number = NUM_BEG;
-	bool poly = false;
-	bool command = false;
-	Poly p;
-	long arg = 0;
-	unsigned arg2 = 0;
-	char commandName[MAX_COMMAND_LENGTH];
-	bool proper = true;
-	Stack *stack = (NewStack(PolyZero(), 0));
-	while(scanf("%c", &c) > 0) {
-		if (IsLetter(c)) 
-			command = true;
-		else poly = true;	
-		if (poly) {
-			proper = true;
-			p = ReadPoly(line, &number, &c, &proper);
-			if (proper && c == NEW_LINE) 
-				stack = AddStack(stack, p);
-			else {
-				ErrPoly(number, line);
-				PolyDestroy(&p);
-			}	
+	if (scanf("%c", &c) <= 0)
+		return false;
+	ins->line = line;
+	ins->poly = !IsLetter(c);
+	ins->proper = true;
+	if (ins->poly) {
+		TraceBegin("parse", "line", line);
+		ins->value = ReadPoly(line, &number, &c, &(ins->proper));
+		TraceEnd();
+		if (ins->proper && c == NEW_LINE && packedEngine) {
+			ins->packed = PackedFromPoly(&(ins->value));
+			PolyDestroy(&(ins->value));
+		}
+		else if (!ins->proper || c != NEW_LINE) {
+			ins->proper = false;
+			ErrPoly(number, line);
+			PolyDestroy(&(ins->value));
+		}
+	}
+	else {
+		memset(ins->command, 0, sizeof(ins->command));
+		GetCommandName(ins->command, &c, &(ins->proper), 0);
+		ParseCommand(ins, &c);
+	}
+	while (c != NEW_LINE) {
+		ReadLetter(&number, &c);
+	}
+	return true;
+}
+
+/**
+ *Wykonuje wczytaną linię skryptu: kładzie wielomian na stosie albo wykonuje komendę.
+ *W trybie równoległym komendy liczące zleca puli wątków, a pozostałe
+ *wykonuje po policzeniu potrzebnych im wielomianów, więc wyjście i błędy
+ *pojawiają się w kolejności linii.
+ *Z ograniczeniem pamięci wczytuje odłożone argumenty komendy z pliku wymiany,
+ *a po wykonaniu linii odkłada do niego najdawniej używane elementy stosu.
+ *Po EXPLAIN najbliższa komenda mnożąca, potęgująca lub podstawiająca
+ *wypisuje tylko oszacowanie wyniku.
+ *@param[in] ins : wczytana linia
+ *@param[in] stack : stos wielomianów
+ */
+void Run(Instruction *ins, Stack **stack) {
+	if (!ins->proper)
+		return;
+	tick++;
+	if (ins->poly && packedEngine)
+		*stack = AddPackedStack(*stack, ins->packed);
+	else if (ins->poly)
+		*stack = AddStack(*stack, ins->value);
+	else if (!CanMove(ins, *stack))
+		return;
+	else if (explainNext && IsLimitable(Hash(ins->command))) {
+		explainNext = false;
+		if (dataflow)
+			Resolve(ins, *stack);
+		Reload(*stack, ins->argNumb);
+		Explain(Hash(ins->command), *stack, ins->arg2);
+	}
+	else if (dataflow && IsDataflow(Hash(ins->command))) {
+		Reload(*stack, ins->argNumb);
+		Spawn(ins, stack);
+	}
+	else {
+		if (dataflow)
+			Resolve(ins, *stack);
+		Reload(*stack, ins->argNumb);
+		TraceBegin(commandNames[CommandIndex(Hash(ins->command))], "line", ins->line);
+		Move(ins->command, stack, ins->arg, ins->arg2, ins->name);
+		TraceEnd();
+		if (mulOverflowed) {
+			mulOverflowed = false;
+			ErrCoeffOverflow(ins->line);
 		}
-		else if (command) {
-			memset(commandName, 0, sizeof(commandName));
-			proper = true;
-			GetCommandName(commandName, &c, &proper, 0);
-			CanMove(commandName, stack, line, &c, &arg, &arg2, &proper);
-			if (proper)
-				Move(commandName, &stack, arg, arg2);
+		if (pointsUnreadable) {
+			pointsUnreadable = false;
+			ErrArg(ins->line, MULTI_AT);
 		}
-		while (c != NEW_LINE) {
-			ReadLetter(&number, &c);
+		if (limitExceeded) {
+			limitExceeded = false;
+			ErrLimit(ins->line);
 		}
-		line++;
-		number = NUM_BEG;
-		poly = false;
-		command = false;	
 	}
+	if (memLimit > 0) {
+		Touch(*stack);
+		SpillCold();
+	}
+}
+
+/**
+ *Kończy skrypt: czeka na pulę wątków, zwalnia stos i rejestry, wypisuje statystyki
+ *@param[in] stack : stos wielomianów
+ *@return kod wyjścia programu
+ */
+int Finish(Stack *stack) {
+	if (dataflow)
+		DataflowStop();
+	dataflow = false;
 	DeleteStack(stack);
-	return 0;	
+	SpillStop();
+	RegisterClear();
+	ScratchRelease();
+	if (statsOnExit)
+		PrintStats(true);
+	return 0;
+}
+
+/**
+ *Wykonuje skrypt kalkulatora: czyta polecenia ze standardowego wejścia
+ *i wykonuje je na nowym stosie
+ *@return kod wyjścia programu
+ */
+int Calculate() {
+	Instruction ins;
+	Stack *stack = NewStack(PolyZero(), 0);
+	dataflow = workers > 0 && DataflowStart(workers, DATAFLOW_WINDOW);
+	for (int line = NUM_BEG ; ParseLine(&ins, line) ; line++)
+		Run(&ins, &stack);
+	return Finish(stack);
+}
+
+/**
+ *Wątek czytający: wczytuje linie skryptu i przekazuje je do wykonania.
+ *Błędy składni trafiają do wyjścia linii, a koniec wejścia oznacza NULL.
+ *@param[in] ring : kolejka wczytanych linii
+ *@return NULL
+ */
+void *Reader(void *ring) {
+	for (int line = NUM_BEG ; ; line++) {
+		Instruction *ins = (Instruction *)malloc(sizeof(Instruction));
+		assert(ins != NULL);
+		ins->output = (Output) {{NULL, 0, 0}, {NULL, 0, 0}};
+		output = &(ins->output);
+		bool read = ParseLine(ins, line);
+		output = NULL;
+		if (!read) {
+			free(ins);
+			break;
+		}
+		RingPush((Ring *)ring, ins);
+	}
+	RingPush((Ring *)ring, NULL);
+	return NULL;
+}
+
+/**
+ *Wątek wypisujący: wypisuje wyjścia wykonanych linii w kolejności linii
+ *i zwalnia je. Koniec oznacza NULL.
+ *@param[in] ring : kolejka wykonanych linii
+ *@return NULL
+ */
+void *Writer(void *ring) {
+	Instruction *ins;
+	while ((ins = (Instruction *)RingPop((Ring *)ring)) != NULL) {
+		if (ins->output.err.size > 0)
+			fprintf(stderr, "%s", ins->output.err.data);
+		if (ins->output.out.size > 0)
+			printf("%s", ins->output.out.data);
+		free(ins->output.err.data);
+		free(ins->output.out.data);
+		free(ins);
+	}
+	return NULL;
+}
+
+/**
+ *Wykonuje skrypt kalkulatora potokowo: osobny wątek czyta linie i buduje
+ *wielomiany, bieżący wątek wykonuje komendy, a trzeci wypisuje wyniki.
+ *Wątki łączą kolejki bez blokad, a wyjście każdej linii jest zbierane
+ *w buforze, więc kolejność wyników i błędów jest taka jak w @ref Calculate.
+ *Gdy nie da się uruchomić wątków, wykonuje skrypt sekwencyjnie.
+ *@return kod wyjścia programu
+ */
+int CalculatePipelined() {
+	Ring parsed, executed;
+	pthread_t reader, writer;
+	RingInit(&parsed, PIPELINE_LINES);
+	RingInit(&executed, PIPELINE_LINES);
+	bool started = pthread_create(&writer, NULL, Writer, &executed) == 0;
+	if (started && pthread_create(&reader, NULL, Reader, &parsed) != 0) {
+		RingPush(&executed, NULL);
+		pthread_join(writer, NULL);
+		started = false;
+	}
+	if (!started) {
+		RingDestroy(&parsed);
+		RingDestroy(&executed);
+		return Calculate();
+	}
+	Stack *stack = NewStack(PolyZero(), 0);
+	dataflow = workers > 0 && DataflowStart(workers, DATAFLOW_WINDOW);
+	Instruction *ins;
+	while ((ins = (Instruction *)RingPop(&parsed)) != NULL) {
+		output = &(ins->output);
+		Run(ins, &stack);
+		output = NULL;
+		RingPush(&executed, ins);
+	}
+	RingPush(&executed, NULL);
+	pthread_join(reader, NULL);
+	pthread_join(writer, NULL);
+	RingDestroy(&parsed);
+	RingDestroy(&executed);
+	return Finish(stack);
+}
+
+/**
+ *Odczytuje wartość opcji z linii poleceń w postaci `--opcja wartość`
+ *lub `--opcja=wartość`
+ *@param[in] argc : liczba argumentów
+ *@param[in] argv : argumenty
+ *@param[in] i : indeks bieżącego argumentu, przesuwany za wartość opcji
+ *@param[in] name : nazwa opcji
+ *@return wartość opcji lub NULL, jeśli argument nie jest tą opcją
+ */
+const char *OptionValue(int argc, char *argv[], int *i, const char *name) {
+	size_t length = strlen(name);
+	if (strncmp(argv[*i], name, length) != 0)
+		return NULL;
+	if (argv[*i][length] == '=')
+		return argv[*i] + length + 1;
+	if (argv[*i][length] == EMPTY_CHAR && *i + 1 < argc)
+		return argv[++*i];
+	return NULL;
+}
+
+/**
+ *Odczytuje liczbową wartość opcji: same cyfry dziesiętne, bez znaku
+ *i nie więcej niż @p max
+ *@param[in] value : wartość opcji
+ *@param[in] max : największa dopuszczalna wartość
+ *@param[out] result : odczytana liczba
+ *@return czy wartość jest poprawna
+ */
+bool OptionNumber(const char *value, unsigned long long max, unsigned long long *result) {
+	unsigned long long number = 0;
+	if (*value == EMPTY_CHAR)
+		return false;
+	for ( ; *value != EMPTY_CHAR ; value++) {
+		if (!IsNumber(*value) || number > (max - (unsigned long long)(*value - '0')) / 10)
+			return false;
+		number = number * 10 + (unsigned long long)(*value - '0');
+	}
+	*result = number;
+	return true;
+}
+
+/**
+ *Wypisuje błąd: zła opcja programu
+ *@param[in] option : błędna opcja
+ **/
+void ErrOption(const char *option) {
+	fprintf(stderr, "%s%s\n", "ERROR WRONG OPTION ", option);
+}
+
+/**
+ *Wypisuje błąd: nie można zapisać przebiegu do pliku
+ *@param[in] file : plik przebiegu
+ **/
+void ErrTrace(const char *file) {
+	fprintf(stderr, "%s%s\n", "ERROR TRACE ", file);
+}
+
+//\cond
+int main(int argc, char *argv[]) {
+	Init();
+	const char *batch = NULL;
+	const char *outDir = NULL;
+	const char *trace = NULL;
+	unsigned jobs = 0;
+	unsigned long long number;
+	const char *value;
+	for (int i = 1 ; i < argc ; i++) {
+		if ((value = OptionValue(argc, argv, &i, "--batch")) != NULL)
+			batch = value;
+		else if ((value = OptionValue(argc, argv, &i, "--out")) != NULL)
+			outDir = value;
+		else if ((value = OptionValue(argc, argv, &i, "--jobs")) != NULL) {
+			if (!OptionNumber(value, MAX_JOBS, &number)) {
+				ErrOption("--jobs");
+				return 1;
+			}
+			jobs = (unsigned)number;
+		}
+		else if ((value = OptionValue(argc, argv, &i, "--parallel")) != NULL) {
+			if (!OptionNumber(value, MAX_WORKERS, &number)) {
+				ErrOption("--parallel");
+				return 1;
+			}
+			workers = (unsigned)number;
+		}
+		else if ((value = OptionValue(argc, argv, &i, "--mem-limit")) != NULL) {
+			if (!OptionNumber(value, SIZE_MAX, &number)) {
+				ErrOption("--mem-limit");
+				return 1;
+			}
+			memLimit = (size_t)number;
+		}
+		else if ((value = OptionValue(argc, argv, &i, "--trace")) != NULL)
+			trace = value;
+		else if ((value = OptionValue(argc, argv, &i, "--engine")) != NULL) {
+			if (strcmp(value, "packed") != 0 && strcmp(value, "recursive") != 0) {
+				ErrOption("--engine");
+				return 1;
+			}
+			packedEngine = strcmp(value, "packed") == 0;
+		}
+		else if (strcmp(argv[i], "--stats-on-exit") == 0)
+			statsOnExit = true;
+		else if (strcmp(argv[i], "--pipeline") == 0)
+			pipeline = true;
+		else if (strcmp(argv[i], "--check-overflow") == 0)
+			checkOverflow = true;
+		else {
+			ErrOption(argv[i]);
+			return 1;
+		}
+	}
+	if (batch != NULL && trace != NULL) {
+		ErrOption("--trace");
+		return 1;
+	}
+	if (batch != NULL)
+		return RunBatch(batch, outDir, jobs, pipeline ? CalculatePipelined : Calculate);
+	if (trace != NULL && !TraceStart(trace)) {
+		ErrTrace(trace);
+		return 1;
+	}
+	int result = pipeline ? CalculatePipelined() : Calculate();
+	TraceStop();
+	CacheSetLimit(0);
+	return result;
 }
 //\endcond
@@ -0,0 +1,173 @@
+/** @file
+  Pula wątków wykonująca graf zadań. Każde zadanie liczy niewykonane
+  zadania, od których zależy; ostatnie z nich po zakończeniu wstawia je
+  do kolejki gotowych zadań. Stan puli chroni jeden mutex, a długie
+  obliczenia zadań odbywają się poza nim.
+  @author Aleksandra Grzyb
+  @copyright Uniwersytet Warszawski
+  @date 2017-05-20
+  */
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <pthread.h>
+#include <assert.h>
+#include "dataflow.h"
+#include "utils.h"
+#define DEPENDENTS_BEG 2 ///<początkowa pojemność tablicy zadań zależnych
+
+/**
+ * Zadanie razem z krawędziami grafu wychodzącymi z niego.
+ */
+struct Task {
+	TaskFunction run; ///<funkcja wykonująca zadanie
+	void *data; ///<argument funkcji
+	unsigned pending; ///<liczba niewykonanych zadań, od których zależy
+	unsigned refs; ///<liczba odwołań: zlecającego i puli do czasu wykonania
+	bool done; ///<czy zadanie zostało wykonane
+	Task **dependents; ///<zadania czekające na to zadanie
+	unsigned dependentCount; ///<liczba zadań czekających
+	unsigned dependentCapacity; ///<rozmiar tablicy zadań czekających
+	Task *next; ///<następne zadanie w kolejce gotowych
+};
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER; ///<chroni stan puli
+static pthread_cond_t readyCond = PTHREAD_COND_INITIALIZER; ///<sygnał dla wątków puli: jest gotowe zadanie
+static pthread_cond_t doneCond = PTHREAD_COND_INITIALIZER; ///<sygnał dla czekających: zadanie się wykonało
+static Task *readyHead = NULL; ///<początek kolejki gotowych zadań
+static Task *readyTail = NULL; ///<koniec kolejki gotowych zadań
+static unsigned inFlight = 0; ///<liczba zleconych i niewykonanych zadań
+static unsigned windowSize = 0; ///<największa dozwolona wartość @ref inFlight
+static bool stopping = false; ///<czy wątki puli mają się zakończyć
+static pthread_t *threads = NULL; ///<wątki puli
+static unsigned threadCount = 0; ///<liczba wątków puli
+
+/**
+ * Wstawia zadanie do kolejki gotowych. Wymaga blokady puli.
+ * @param[in] t : zadanie
+ */
+static void Enqueue(Task *t) {
+	t->next = NULL;
+	if (readyTail == NULL)
+		readyHead = t;
+	else readyTail->next = t;
+	readyTail = t;
+	pthread_cond_signal(&readyCond);
+}
+
+/**
+ * Oddaje odwołanie do zadania. Wymaga blokady puli.
+ * @param[in] t : zadanie
+ */
+static void ReleaseLocked(Task *t) {
+	if (--t->refs > 0)
+		return;
+	free(t->dependents);
+	free(t);
+}
+
+/**
+ * Pętla wątku puli: wykonuje gotowe zadania i budzi zależne od nich.
+ * @param[in] unused : nieużywany
+ * @return NULL
+ */
+static void *Worker(void *unused) {
+	(void)unused;
+	pthread_mutex_lock(&mutex);
+	while (true) {
+		while (readyHead == NULL && !stopping)
+			pthread_cond_wait(&readyCond, &mutex);
+		if (readyHead == NULL)
+			break;
+		Task *t = readyHead;
+		readyHead = t->next;
+		if (readyHead == NULL)
+			readyTail = NULL;
+		pthread_mutex_unlock(&mutex);
+		t->run(t->data);
+		pthread_mutex_lock(&mutex);
+		t->done = true;
+		inFlight--;
+		for (unsigned i = 0 ; i < t->dependentCount ; i++)
+			if (--t->dependents[i]->pending == 0)
+				Enqueue(t->dependents[i]);
+		ReleaseLocked(t);
+		pthread_cond_broadcast(&doneCond);
+	}
+	pthread_mutex_unlock(&mutex);
+	return NULL;
+}
+
+bool DataflowStart(unsigned threadsWanted, unsigned window) {
+	assert(threadsWanted > 0 && window > 0 && threadCount == 0);
+	threads = (pthread_t *)malloc(threadsWanted * sizeof(pthread_t));
+	if (threads == NULL)
+		return false;
+	windowSize = window;
+	stopping = false;
+	while (threadCount < threadsWanted && pthread_create(&threads[threadCount], NULL, Worker, NULL) == 0)
+		threadCount++;
+	if (threadCount == threadsWanted)
+		return true;
+	DataflowStop();
+	return false;
+}
+
+void DataflowStop(void) {
+	DataflowDrain();
+	pthread_mutex_lock(&mutex);
+	stopping = true;
+	pthread_cond_broadcast(&readyCond);
+	pthread_mutex_unlock(&mutex);
+	for (unsigned i = 0 ; i < threadCount ; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+	threads = NULL;
+	threadCount = 0;
+	stopping = false;
+}
+
+void DataflowDrain(void) {
+	pthread_mutex_lock(&mutex);
+	while (inFlight > 0)
+		pthread_cond_wait(&doneCond, &mutex);
+	pthread_mutex_unlock(&mutex);
+}
+
+Task *TaskSubmit(TaskFunction run, void *data, unsigned count, Task *const inputs[]) {
+	Task *t = (Task *)malloc(sizeof(Task));
+	assert(t != NULL);
+	*t = (Task) {run, data, 0, 2, false, NULL, 0, 0, NULL};
+	pthread_mutex_lock(&mutex);
+	while (inFlight >= windowSize)
+		pthread_cond_wait(&doneCond, &mutex);
+	for (unsigned i = 0 ; i < count ; i++) {
+		Task *input = inputs[i];
+		if (input == NULL || input->done)
+			continue;
+		if (input->dependentCount == input->dependentCapacity) {
+			input->dependentCapacity = input->dependentCapacity == 0 ? DEPENDENTS_BEG : 2 * input->dependentCapacity;
+			input->dependents = (Task **)realloc(input->dependents, input->dependentCapacity * sizeof(Task *));
+			assert(input->dependents != NULL);
+		}
+		input->dependents[input->dependentCount++] = t;
+		t->pending++;
+	}
+	inFlight++;
+	if (t->pending == 0)
+		Enqueue(t);
+	pthread_mutex_unlock(&mutex);
+	return t;
+}
+
+void TaskWait(Task *t) {
+	pthread_mutex_lock(&mutex);
+	while (!t->done)
+		pthread_cond_wait(&doneCond, &mutex);
+	pthread_mutex_unlock(&mutex);
+}
+
+void TaskRelease(Task *t) {
+	pthread_mutex_lock(&mutex);
+	ReleaseLocked(t);
+	pthread_mutex_unlock(&mutex);
+}
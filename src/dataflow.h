@@ -0,0 +1,66 @@
+/** @file
+   Interfejs puli wątków wykonującej zadania w kolejności wyznaczonej
+   przez zależności między nimi
+
+   @author Aleksandra Grzyb
+   @copyright Uniwersytet Warszawski
+   @date 2017-05-20
+*/
+
+#ifndef __DATAFLOW_H__
+#define __DATAFLOW_H__
+
+#include <stdbool.h>
+
+/** Zadanie puli wątków */
+typedef struct Task Task;
+
+/** Funkcja wykonująca zadanie */
+typedef void (*TaskFunction)(void *data);
+
+/**
+ * Uruchamia pulę wątków.
+ * @param[in] threads : liczba wątków, dodatnia
+ * @param[in] window : największa liczba zadań zleconych i jeszcze nie wykonanych
+ * @return czy udało się uruchomić wszystkie wątki
+ */
+bool DataflowStart(unsigned threads, unsigned window);
+
+/**
+ * Czeka na wykonanie wszystkich zadań i zatrzymuje pulę wątków.
+ */
+void DataflowStop(void);
+
+/**
+ * Czeka na wykonanie wszystkich zleconych zadań.
+ */
+void DataflowDrain(void);
+
+/**
+ * Zleca zadanie, które zostanie wykonane po wszystkich zadaniach
+ * z @p inputs. Czeka, jeśli niewykonanych zadań jest już tyle, ile
+ * wynosi okno puli. Zadania zlecone wcześniej nie zależą od późniejszych,
+ * więc pula zawsze może zrobić postęp.
+ * @param[in] run : funkcja wykonująca zadanie
+ * @param[in] data : argument funkcji
+ * @param[in] count : liczba zadań, od których zależy nowe
+ * @param[in] inputs : zadania, od których zależy nowe; NULL oznacza brak zależności
+ * @return zadanie z jednym odwołaniem należącym do zlecającego
+ */
+Task *TaskSubmit(TaskFunction run, void *data, unsigned count, Task *const inputs[]);
+
+/**
+ * Czeka na wykonanie zadania. Po powrocie wyniki zadania są widoczne
+ * w wątku wywołującym.
+ * @param[in] t : zadanie
+ */
+void TaskWait(Task *t);
+
+/**
+ * Oddaje odwołanie do zadania. Zadanie jest zwalniane po wykonaniu
+ * i oddaniu wszystkich odwołań.
+ * @param[in] t : zadanie
+ */
+void TaskRelease(Task *t);
+
+#endif /* __DATAFLOW_H__ */
@@ -0,0 +1,340 @@
+/** @file
+  Operacje na gęstych tablicach współczynników wielomianów jednej zmiennej.
+  Współczynniki są liczone w arytmetyce modulo 2^64, tak jak przy przepełnieniu
+  w wielomianach rekurencyjnych; pętle nie mają zależności między iteracjami,
+  więc kompilator może je zwektoryzować.
+  @author Aleksandra Grzyb
+  @copyright Uniwersytet Warszawski
+  @date 2017-05-20
+  */
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "dense.h"
+#include "memory.h"
+#include "utils.h"
+#define KARATSUBA_MIN 32 ///<najkrótszy czynnik mnożony algorytmem Karatsuby
+#define MULTIPOINT_LEAF 32 ///<liczba punktów w liściu drzewa podiloczynów
+#define DIVISION_FAST_MIN 64 ///<najkrótszy iloraz i dzielnik dzielone przez odwrotność Newtona
+
+void DenseAdd(uint64_t *restrict r, const uint64_t *restrict a, size_t n) {
+	for (size_t i = 0 ; i < n ; i++)
+		r[i] += a[i];
+}
+
+void DenseSub(uint64_t *restrict r, const uint64_t *restrict a, size_t n) {
+	for (size_t i = 0 ; i < n ; i++)
+		r[i] -= a[i];
+}
+
+void DenseScale(uint64_t *r, size_t n, uint64_t c) {
+	for (size_t i = 0 ; i < n ; i++)
+		r[i] *= c;
+}
+
+uint64_t DenseHorner(const uint64_t *a, size_t n, uint64_t x) {
+	uint64_t result = 0;
+	while (n > 0)
+		result = result * x + a[--n];
+	return result;
+}
+
+/**
+ * Mnoży dwa wielomiany algorytmem szkolnym.
+ * @param[out] r : współczynniki iloczynu, miejsce na `n + m - 1` wartości
+ * @param[in] a : współczynniki pierwszego czynnika
+ * @param[in] n : liczba współczynników pierwszego czynnika
+ * @param[in] b : współczynniki drugiego czynnika
+ * @param[in] m : liczba współczynników drugiego czynnika
+ */
+static void MulBasecase(uint64_t *restrict r, const uint64_t *restrict a, size_t n,
+		const uint64_t *restrict b, size_t m) {
+	memset(r, 0, (n + m - 1) * sizeof(uint64_t));
+	for (size_t i = 0 ; i < n ; i++) {
+		uint64_t coef = a[i];
+		uint64_t *row = r + i;
+		for (size_t j = 0 ; j < m ; j++)
+			row[j] += coef * b[j];
+	}
+}
+
+/**
+ * Podnosi wielomian do kwadratu algorytmem szkolnym: każdy iloczyn
+ * różnych współczynników jest liczony raz i podwajany.
+ * @param[out] r : współczynniki kwadratu, miejsce na `2n - 1` wartości
+ * @param[in] a : współczynniki wielomianu
+ * @param[in] n : liczba współczynników
+ */
+static void SqrBasecase(uint64_t *restrict r, const uint64_t *restrict a, size_t n) {
+	memset(r, 0, (2 * n - 1) * sizeof(uint64_t));
+	for (size_t i = 0 ; i < n ; i++) {
+		uint64_t coef = a[i];
+		uint64_t *row = r + i;
+		for (size_t j = i + 1 ; j < n ; j++)
+			row[j] += coef * a[j];
+	}
+	for (size_t i = 0 ; i < 2 * n - 1 ; i++)
+		r[i] *= 2;
+	for (size_t i = 0 ; i < n ; i++)
+		r[2 * i] += a[i] * a[i];
+}
+
+/**
+ * Liczy, ile miejsca na wyniki pośrednie potrzebuje @ref Karatsuba.
+ * @param[in] n : liczba współczynników czynników
+ * @return liczba współczynników pamięci pomocniczej
+ */
+static size_t ScratchSize(size_t n) {
+	size_t result = 0;
+	while (n >= KARATSUBA_MIN) {
+		n -= n / 2;
+		result += 4 * n - 1;
+	}
+	return result;
+}
+
+/**
+ * Mnoży dwa wielomiany o tej samej liczbie współczynników algorytmem
+ * Karatsuby: `(a0 + a1 x^h)(b0 + b1 x^h) = z0 + (z1 - z0 - z2) x^h + z2 x^2h`,
+ * gdzie `z1 = (a0 + a1)(b0 + b1)`.
+ * @param[out] r : współczynniki iloczynu, miejsce na `2n - 1` wartości
+ * @param[in] a : współczynniki pierwszego czynnika
+ * @param[in] b : współczynniki drugiego czynnika
+ * @param[in] n : liczba współczynników czynników
+ * @param[in] scratch : pamięć pomocnicza na @ref ScratchSize(n) wartości
+ */
+static void Karatsuba(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t n, uint64_t *scratch) {
+	if (n < KARATSUBA_MIN) {
+		MulBasecase(r, a, n, b, n);
+		return;
+	}
+	size_t h = n / 2;
+	size_t k = n - h;
+	uint64_t *sumA = scratch;
+	uint64_t *sumB = sumA + k;
+	uint64_t *middle = sumB + k;
+	Karatsuba(r, a, b, h, scratch);
+	r[2 * h - 1] = 0;
+	Karatsuba(r + 2 * h, a + h, b + h, k, scratch);
+	memcpy(sumA, a + h, k * sizeof(uint64_t));
+	DenseAdd(sumA, a, h);
+	memcpy(sumB, b + h, k * sizeof(uint64_t));
+	DenseAdd(sumB, b, h);
+	Karatsuba(middle, sumA, sumB, k, middle + 2 * k - 1);
+	DenseSub(middle, r, 2 * h - 1);
+	DenseSub(middle, r + 2 * h, 2 * k - 1);
+	DenseAdd(r + h, middle, 2 * k - 1);
+}
+
+/**
+ * Podnosi wielomian do kwadratu algorytmem Karatsuby:
+ * `(a0 + a1 x^h)^2 = z0 + (z1 - z0 - z2) x^h + z2 x^2h`, gdzie `z1 = (a0 + a1)^2`.
+ * @param[out] r : współczynniki kwadratu, miejsce na `2n - 1` wartości
+ * @param[in] a : współczynniki wielomianu
+ * @param[in] n : liczba współczynników
+ * @param[in] scratch : pamięć pomocnicza na @ref ScratchSize(n) wartości
+ */
+static void KaratsubaSqr(uint64_t *r, const uint64_t *a, size_t n, uint64_t *scratch) {
+	if (n < KARATSUBA_MIN) {
+		SqrBasecase(r, a, n);
+		return;
+	}
+	size_t h = n / 2;
+	size_t k = n - h;
+	uint64_t *sum = scratch;
+	uint64_t *middle = sum + k;
+	KaratsubaSqr(r, a, h, scratch);
+	r[2 * h - 1] = 0;
+	KaratsubaSqr(r + 2 * h, a + h, k, scratch);
+	memcpy(sum, a + h, k * sizeof(uint64_t));
+	DenseAdd(sum, a, h);
+	KaratsubaSqr(middle, sum, k, middle + 2 * k - 1);
+	DenseSub(middle, r, 2 * h - 1);
+	DenseSub(middle, r + 2 * h, 2 * k - 1);
+	DenseAdd(r + h, middle, 2 * k - 1);
+}
+
+void DenseSqr(uint64_t *r, const uint64_t *a, size_t n) {
+	if (n < KARATSUBA_MIN) {
+		SqrBasecase(r, a, n);
+		return;
+	}
+	ScratchMark mark = ScratchSave();
+	uint64_t *scratch = (uint64_t *)ScratchAlloc(ScratchSize(n) * sizeof(uint64_t));
+	KaratsubaSqr(r, a, n, scratch);
+	ScratchRestore(mark);
+}
+
+void DenseMul(uint64_t *r, const uint64_t *a, size_t n, const uint64_t *b, size_t m) {
+	if (n < m) {
+		const uint64_t *swap = a;
+		a = b;
+		b = swap;
+		size_t length = n;
+		n = m;
+		m = length;
+	}
+	if (m < KARATSUBA_MIN) {
+		MulBasecase(r, a, n, b, m);
+		return;
+	}
+	/* Dłuższy czynnik mnożymy kawałkami o długości krótszego. */
+	ScratchMark mark = ScratchSave();
+	uint64_t *scratch = (uint64_t *)ScratchAlloc((ScratchSize(m) + 2 * m - 1) * sizeof(uint64_t));
+	uint64_t *product = scratch + ScratchSize(m);
+	memset(r, 0, (n + m - 1) * sizeof(uint64_t));
+	size_t i = 0;
+	for ( ; i + m <= n ; i += m) {
+		Karatsuba(product, a + i, b, m, scratch);
+		DenseAdd(r + i, product, 2 * m - 1);
+	}
+	if (i < n) {
+		DenseMul(product, b, m, a + i, n - i);
+		DenseAdd(r + i, product, m + n - i - 1);
+	}
+	ScratchRestore(mark);
+}
+
+/**
+ * Liczy odwrotność szeregu potęgowego o wyrazie wolnym 1 metodą Newtona:
+ * `h' = h + h(1 - gh) mod x^2k`, podwajając dokładność w każdym kroku.
+ * @param[out] h : odwrotność, miejsce na @p n wartości
+ * @param[in] g : współczynniki szeregu, co najmniej @p n wartości, `g[0] = 1`
+ * @param[in] n : liczba liczonych współczynników odwrotności, dodatnia
+ */
+static void Inverse(uint64_t *h, const uint64_t *g, size_t n) {
+	ScratchMark mark = ScratchSave();
+	uint64_t *product = (uint64_t *)ScratchAlloc(2 * n * sizeof(uint64_t));
+	uint64_t *correction = (uint64_t *)ScratchAlloc(2 * n * sizeof(uint64_t));
+	h[0] = 1;
+	for (size_t k = 1 ; k < n ; ) {
+		size_t next = 2 * k < n ? 2 * k : n;
+		/* Wyrazy gh poniżej x^k są równe 1, 0, 0, ..., więc liczymy tylko wyższe. */
+		DenseMul(product, g, next, h, k);
+		for (size_t i = k ; i < next ; i++)
+			product[i] = -product[i];
+		DenseMul(correction, h, next - k, product + k, next - k);
+		memcpy(h + k, correction, (next - k) * sizeof(uint64_t));
+		k = next;
+	}
+	ScratchRestore(mark);
+}
+
+/**
+ * Liczy resztę z dzielenia przez wielomian unormowany. Dzielenie nie wymaga
+ * odwracania współczynników, więc działa modulo 2^64. Krótkie ilorazy są
+ * liczone szkolnie, długie przez odwrotność odwróconego dzielnika.
+ * @param[out] r : reszta, miejsce na @p m wartości
+ * @param[in] a : współczynniki dzielnej
+ * @param[in] n : liczba współczynników dzielnej
+ * @param[in] b : współczynniki dzielnika, `b[m] = 1`
+ * @param[in] m : stopień dzielnika, dodatni
+ */
+static void Remainder(uint64_t *r, const uint64_t *a, size_t n, const uint64_t *b, size_t m) {
+	if (n <= m) {
+		memcpy(r, a, n * sizeof(uint64_t));
+		memset(r + n, 0, (m - n) * sizeof(uint64_t));
+		return;
+	}
+	size_t l = n - m;
+	ScratchMark mark = ScratchSave();
+	if (l < DIVISION_FAST_MIN || m < DIVISION_FAST_MIN) {
+		uint64_t *rest = (uint64_t *)ScratchAlloc(n * sizeof(uint64_t));
+		memcpy(rest, a, n * sizeof(uint64_t));
+		for (size_t i = n ; i-- > m ; ) {
+			uint64_t q = rest[i];
+			for (size_t j = 0 ; j < m ; j++)
+				rest[i - m + j] -= q * b[j];
+		}
+		memcpy(r, rest, m * sizeof(uint64_t));
+		ScratchRestore(mark);
+		return;
+	}
+	/* rev(q) = rev(a) / rev(b) mod x^l, a rev(b) ma wyraz wolny 1. */
+	size_t length = l < m + 1 ? l : m + 1;
+	uint64_t *reversed = (uint64_t *)ScratchAlloc(l * sizeof(uint64_t));
+	memset(reversed, 0, l * sizeof(uint64_t));
+	for (size_t i = 0 ; i < length ; i++)
+		reversed[i] = b[m - i];
+	uint64_t *inverse = (uint64_t *)ScratchAlloc(l * sizeof(uint64_t));
+	Inverse(inverse, reversed, l);
+	for (size_t i = 0 ; i < l ; i++)
+		reversed[i] = a[n - 1 - i];
+	uint64_t *quotient = (uint64_t *)ScratchAlloc(2 * l * sizeof(uint64_t));
+	DenseMul(quotient, reversed, l, inverse, l);
+	for (size_t i = 0 ; i < l / 2 ; i++) {
+		uint64_t swap = quotient[i];
+		quotient[i] = quotient[l - 1 - i];
+		quotient[l - 1 - i] = swap;
+	}
+	uint64_t *product = (uint64_t *)ScratchAlloc((m + l - 1) * sizeof(uint64_t));
+	DenseMul(product, b, m, quotient, l);
+	memcpy(r, a, m * sizeof(uint64_t));
+	DenseSub(r, product, m);
+	ScratchRestore(mark);
+}
+
+void DenseMultiEval(uint64_t *values, const uint64_t *a, size_t n, const uint64_t *x, size_t k) {
+	if (k <= MULTIPOINT_LEAF || n <= MULTIPOINT_LEAF) {
+		for (size_t i = 0 ; i < k ; i++)
+			values[i] = DenseHorner(a, n, x[i]);
+		return;
+	}
+	ScratchMark mark = ScratchSave();
+	/* Poziom j drzewa podiloczynów to iloczyny (X - x_i) po blokach
+	 * MULTIPOINT_LEAF * 2^j kolejnych punktów, każdy z wiodącą jedynką,
+	 * zapisane w jednej tablicy co rozmiar bloku plus jeden. */
+	size_t levels = 1;
+	while (((size_t)MULTIPOINT_LEAF << (levels - 1)) < k)
+		levels++;
+	uint64_t **tree = (uint64_t **)ScratchAlloc(levels * sizeof(uint64_t *));
+	for (size_t j = 0 ; j < levels ; j++) {
+		size_t block = (size_t)MULTIPOINT_LEAF << j;
+		size_t nodes = (k + block - 1) / block;
+		tree[j] = (uint64_t *)ScratchAlloc((k + nodes) * sizeof(uint64_t));
+		for (size_t i = 0 ; i < nodes ; i++) {
+			size_t start = i * block;
+			size_t size = k - start < block ? k - start : block;
+			uint64_t *node = tree[j] + i * (block + 1);
+			if (j == 0) {
+				node[0] = 1;
+				for (size_t t = 0 ; t < size ; t++) {
+					node[t + 1] = node[t];
+					for (size_t u = t ; u > 0 ; u--)
+						node[u] = node[u - 1] - x[start + t] * node[u];
+					node[0] *= -x[start + t];
+				}
+			}
+			else if (size <= block / 2)
+				memcpy(node, tree[j - 1] + 2 * i * (block / 2 + 1), (size + 1) * sizeof(uint64_t));
+			else DenseMul(node, tree[j - 1] + 2 * i * (block / 2 + 1), block / 2 + 1,
+					tree[j - 1] + (2 * i + 1) * (block / 2 + 1), size - block / 2 + 1);
+		}
+	}
+	/* Reszty z dzielenia przez węzły poziomu zajmują miejsca ich punktów. */
+	uint64_t *rest = (uint64_t *)ScratchAlloc(k * sizeof(uint64_t));
+	uint64_t *next = (uint64_t *)ScratchAlloc(k * sizeof(uint64_t));
+	Remainder(rest, a, n, tree[levels - 1], k);
+	for (size_t j = levels - 1 ; j > 0 ; j--) {
+		size_t half = (size_t)MULTIPOINT_LEAF << (j - 1);
+		for (size_t start = 0 ; start < k ; start += 2 * half) {
+			size_t size = k - start < 2 * half ? k - start : 2 * half;
+			const uint64_t *left = tree[j - 1] + start / half * (half + 1);
+			if (size <= half) {
+				memcpy(next + start, rest + start, size * sizeof(uint64_t));
+				continue;
+			}
+			Remainder(next + start, rest + start, size, left, half);
+			Remainder(next + start + half, rest + start, size, left + half + 1, size - half);
+		}
+		uint64_t *swap = rest;
+		rest = next;
+		next = swap;
+	}
+	for (size_t start = 0 ; start < k ; start += MULTIPOINT_LEAF) {
+		size_t size = k - start < MULTIPOINT_LEAF ? k - start : MULTIPOINT_LEAF;
+		for (size_t i = start ; i < start + size ; i++)
+			values[i] = DenseHorner(rest + start, size, x[i]);
+	}
+	ScratchRestore(mark);
+}
@@ -0,0 +1,82 @@
+/** @file
+   Interfejs operacji na gęstych tablicach współczynników wielomianów
+   jednej zmiennej
+
+   @author Aleksandra Grzyb
+   @copyright Uniwersytet Warszawski
+   @date 2017-05-20
+*/
+
+#ifndef __DENSE_H__
+#define __DENSE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Dodaje tablicę współczynników do tablicy wynikowej: `r[i] += a[i]`.
+ * @param[in,out] r : współczynniki wyniku
+ * @param[in] a : dodawane współczynniki
+ * @param[in] n : liczba współczynników
+ */
+void DenseAdd(uint64_t *restrict r, const uint64_t *restrict a, size_t n);
+
+/**
+ * Odejmuje tablicę współczynników od tablicy wynikowej: `r[i] -= a[i]`.
+ * @param[in,out] r : współczynniki wyniku
+ * @param[in] a : odejmowane współczynniki
+ * @param[in] n : liczba współczynników
+ */
+void DenseSub(uint64_t *restrict r, const uint64_t *restrict a, size_t n);
+
+/**
+ * Mnoży współczynniki przez liczbę: `r[i] *= c`.
+ * @param[in,out] r : współczynniki
+ * @param[in] n : liczba współczynników
+ * @param[in] c : mnożnik
+ */
+void DenseScale(uint64_t *r, size_t n, uint64_t c);
+
+/**
+ * Wylicza wartość wielomianu schematem Hornera.
+ * @param[in] a : współczynniki, od wyrazu wolnego
+ * @param[in] n : liczba współczynników
+ * @param[in] x : punkt
+ * @return wartość wielomianu w punkcie @p x
+ */
+uint64_t DenseHorner(const uint64_t *a, size_t n, uint64_t x);
+
+/**
+ * Mnoży dwa wielomiany algorytmem Karatsuby, dla krótkich czynników
+ * szkolnym.
+ * @param[out] r : współczynniki iloczynu, miejsce na `n + m - 1` wartości
+ * @param[in] a : współczynniki pierwszego czynnika
+ * @param[in] n : liczba współczynników pierwszego czynnika, dodatnia
+ * @param[in] b : współczynniki drugiego czynnika
+ * @param[in] m : liczba współczynników drugiego czynnika, dodatnia
+ */
+void DenseMul(uint64_t *r, const uint64_t *a, size_t n, const uint64_t *b, size_t m);
+
+/**
+ * Podnosi wielomian do kwadratu, korzystając z symetrii iloczynów
+ * `a[i] * a[j] = a[j] * a[i]`.
+ * @param[out] r : współczynniki kwadratu, miejsce na `2n - 1` wartości
+ * @param[in] a : współczynniki wielomianu
+ * @param[in] n : liczba współczynników, dodatnia
+ */
+void DenseSqr(uint64_t *r, const uint64_t *a, size_t n);
+
+/**
+ * Wylicza wartości wielomianu w wielu punktach drzewem podiloczynów:
+ * dzieli wielomian przez iloczyny `(X - x_i)` coraz mniejszych bloków
+ * punktów, aż reszty są krótkie, i dopiero je liczy schematem Hornera.
+ * Wartości są takie same jak z @ref DenseHorner.
+ * @param[out] values : wartości, miejsce na @p k wartości
+ * @param[in] a : współczynniki wielomianu, od wyrazu wolnego
+ * @param[in] n : liczba współczynników
+ * @param[in] x : punkty
+ * @param[in] k : liczba punktów
+ */
+void DenseMultiEval(uint64_t *values, const uint64_t *a, size_t n, const uint64_t *x, size_t k);
+
+#endif /* __DENSE_H__ */
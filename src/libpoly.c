@@ -0,0 +1,308 @@
+/** @file
+  Biblioteka libpoly: uchwyty wielomianów, wczytywanie i zapisywanie
+  w formacie kalkulatora oraz operacje zlecane tablicami.
+  @author Aleksandra Grzyb
+  @copyright Uniwersytet Warszawski
+  @date 2017-05-20
+  */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <errno.h>
+#include <assert.h>
+#include "libpoly.h"
+#include "poly.h"
+#include "utils.h"
+
+/**
+ * Wielomian za uchwytem.
+ */
+struct LibPoly {
+	Poly value; ///<wielomian
+};
+
+/**
+ * Bufor, do którego zapisywany jest tekst wielomianu.
+ */
+typedef struct Writer {
+	char *buffer; ///<bufor lub NULL
+	size_t size; ///<rozmiar bufora
+	size_t length; ///<długość całego tekstu, także tej części, która się nie zmieściła
+} Writer;
+
+/**
+ * Opakowuje wielomian w uchwyt. Przejmuje na własność wielomian.
+ * @param[in] p : wielomian
+ * @return uchwyt
+ */
+static LibPoly *Wrap(Poly p) {
+	LibPoly *result = (LibPoly *)malloc(sizeof(LibPoly));
+	assert(result != NULL);
+	result->value = p;
+	return result;
+}
+
+int LibPolyVersion(void) {
+	return LIBPOLY_VERSION;
+}
+
+LibPoly *LibPolyFromCoeff(long c) {
+	return Wrap(PolyFromCoeff(c));
+}
+
+/**
+ * Wczytuje liczbę całkowitą bez znaku plus.
+ * @param[in] s : wskaźnik na tekst, przesuwany za liczbę
+ * @param[in] min : najmniejsza dopuszczalna wartość
+ * @param[in] max : największa dopuszczalna wartość
+ * @param[out] value : wczytana liczba
+ * @return czy liczba jest poprawna
+ */
+static bool ParseNumber(const char **s, long min, long max, long *value) {
+	const char *digits = **s == '-' && min < 0 ? *s + 1 : *s;
+	if (*digits < '0' || *digits > '9')
+		return false;
+	char *end;
+	errno = 0;
+	*value = strtol(*s, &end, 10);
+	*s = end;
+	return errno == 0 && *value >= min && *value <= max;
+}
+
+static bool ParsePoly(const char **s, Poly *result);
+
+/**
+ * Wczytuje jednomian `(p,e)`.
+ * @param[in] s : wskaźnik na tekst, przesuwany za jednomian
+ * @param[out] m : wczytany jednomian
+ * @return czy jednomian jest poprawny
+ */
+static bool ParseMono(const char **s, Mono *m) {
+	Poly p;
+	long e = 0;
+	if (**s != '(')
+		return false;
+	(*s)++;
+	if (!ParsePoly(s, &p))
+		return false;
+	bool proper = **s == ',';
+	if (proper) {
+		(*s)++;
+		proper = ParseNumber(s, 0, INT_MAX, &e) && **s == ')';
+	}
+	if (!proper) {
+		PolyDestroy(&p);
+		return false;
+	}
+	(*s)++;
+	*m = MonoFromPoly(&p, PolyIsZero(&p) ? 0 : (poly_exp_t)e);
+	return true;
+}
+
+/**
+ * Wczytuje sumę jednomianów `(p,e)+(p,e)+...`.
+ * @param[in] s : wskaźnik na tekst, przesuwany za sumę
+ * @param[out] result : wczytany wielomian
+ * @return czy suma jest poprawna
+ */
+static bool ParseMonos(const char **s, Poly *result) {
+	PolyBuilder builder = PolyBuilderNew(0);
+	Mono m;
+	bool proper;
+	while ((proper = ParseMono(s, &m))) {
+		PolyBuilderPush(&builder, &m);
+		if (**s != '+')
+			break;
+		(*s)++;
+	}
+	*result = PolyBuilderFinish(&builder);
+	if (!proper)
+		PolyDestroy(result);
+	return proper;
+}
+
+/**
+ * Wczytuje wielomian: współczynnik albo sumę jednomianów.
+ * @param[in] s : wskaźnik na tekst, przesuwany za wielomian
+ * @param[out] result : wczytany wielomian
+ * @return czy wielomian jest poprawny
+ */
+static bool ParsePoly(const char **s, Poly *result) {
+	if (**s == '(')
+		return ParseMonos(s, result);
+	long c;
+	*result = PolyZero();
+	if (!ParseNumber(s, LONG_MIN, LONG_MAX, &c))
+		return false;
+	*result = PolyFromCoeff(c);
+	return true;
+}
+
+LibPoly *LibPolyParse(const char *text) {
+	Poly p;
+	if (text == NULL || !ParsePoly(&text, &p))
+		return NULL;
+	if (*text != '\0') {
+		PolyDestroy(&p);
+		return NULL;
+	}
+	return Wrap(p);
+}
+
+size_t LibPolyParseBatch(size_t count, const char *const texts[], LibPoly *results[]) {
+	size_t parsed = 0;
+	for (size_t i = 0 ; i < count ; i++)
+		if ((results[i] = LibPolyParse(texts[i])) != NULL)
+			parsed++;
+	return parsed;
+}
+
+/**
+ * Dopisuje sformatowany tekst do bufora, obcinając go do rozmiaru bufora.
+ * @param[in] w : bufor
+ * @param[in] format : format jak w printf
+ * @param[in] value : wypisywana liczba
+ */
+static void Write(Writer *w, const char *format, long value) {
+	size_t left = w->length < w->size ? w->size - w->length : 0;
+	int length = snprintf(left > 0 ? w->buffer + w->length : NULL, left, format, value);
+	assert(length >= 0);
+	w->length += (size_t)length;
+}
+
+/**
+ * Zapisuje wielomian, który nie jest współczynnikiem, jak PrintPoly kalkulatora.
+ * @param[in] w : bufor
+ * @param[in] p : wielomian
+ */
+static void WriteMonos(Writer *w, const Poly *p) {
+	const List *l = p->monos;
+	bool add = false;
+	if (p->coef != 0 && l->value.exp != 0) {
+		Write(w, "(%ld,0)", p->coef);
+		add = true;
+	}
+	for (; l != NULL ; l = l->next, add = true) {
+		Write(w, add ? "+(" : "(", 0);
+		Poly coef = l->value.p;
+		if (l == p->monos && l->value.exp == 0)
+			coef.coef += p->coef;
+		if (PolyIsCoeff(&coef))
+			Write(w, "%ld", coef.coef);
+		else WriteMonos(w, &coef);
+		Write(w, ",%ld)", l->value.exp);
+	}
+}
+
+size_t LibPolyFormat(const LibPoly *p, char *buffer, size_t size) {
+	Writer w = {buffer, size, 0};
+	const Poly *value = &(p->value);
+	if (PolyIsCoeff(value) || (value->monos->value.exp == 0 && PolyIsZero(&(value->monos->value.p))))
+		Write(&w, "%ld", value->coef);
+	else WriteMonos(&w, value);
+	if (size > 0 && w.length >= size)
+		buffer[size - 1] = '\0';
+	return w.length;
+}
+
+void LibPolyFree(LibPoly *p) {
+	if (p == NULL)
+		return;
+	PolyDestroy(&(p->value));
+	free(p);
+}
+
+void LibPolyFreeBatch(size_t count, LibPoly *const polys[]) {
+	for (size_t i = 0 ; i < count ; i++)
+		LibPolyFree(polys[i]);
+}
+
+LibPoly *LibPolyCompose(const LibPoly *p, size_t count, const LibPoly *const x[]) {
+	assert(count <= UINT_MAX);
+	Poly *values = (Poly *)malloc((count + 1) * sizeof(Poly));
+	assert(values != NULL);
+	for (size_t i = 0 ; i < count ; i++)
+		values[i] = x[i]->value;
+	Poly result = PolyCompose(&(p->value), (unsigned)count, values);
+	free(values);
+	return Wrap(result);
+}
+
+/**
+ * Wykonuje jedną operację z @ref LibPolyRun.
+ * @param[in] op : kod operacji
+ * @param[in] p : pierwszy argument
+ * @param[in] q : drugi argument lub NULL
+ * @param[in] arg : argument liczbowy
+ * @param[in] hasArg : czy argument liczbowy został podany
+ * @param[out] result : wynik wielomianowy lub NULL
+ * @param[out] value : wynik liczbowy lub NULL
+ * @return czy operację udało się wykonać
+ */
+static bool RunOne(int op, const LibPoly *p, const LibPoly *q, long arg, bool hasArg, LibPoly **result, long *value) {
+	bool binary = op == LIBPOLY_ADD || op == LIBPOLY_SUB || op == LIBPOLY_MUL || op == LIBPOLY_IS_EQ;
+	bool numeric = op >= LIBPOLY_DEG;
+	if (op < LIBPOLY_CLONE || op > LIBPOLY_IS_COEFF || p == NULL || (binary && q == NULL)
+			|| (numeric ? value == NULL : result == NULL))
+		return false;
+	if ((op == LIBPOLY_AT || op == LIBPOLY_EXP || op == LIBPOLY_DEG_BY) && !hasArg)
+		return false;
+	if ((op == LIBPOLY_EXP && (arg < 0 || arg > INT_MAX)) || (op == LIBPOLY_DEG_BY && (arg < 0 || (unsigned long)arg > UINT_MAX)))
+		return false;
+	const Poly *a = &(p->value);
+	const Poly *b = q != NULL ? &(q->value) : NULL;
+	if (numeric && result != NULL)
+		*result = NULL;
+	else if (!numeric && value != NULL)
+		*value = 0;
+	switch (op) {
+		case LIBPOLY_CLONE:
+			*result = Wrap(PolyClone(a));
+			break;
+		case LIBPOLY_ADD:
+			*result = Wrap(PolyAdd(a, b));
+			break;
+		case LIBPOLY_SUB:
+			*result = Wrap(PolySub(a, b));
+			break;
+		case LIBPOLY_MUL:
+			*result = Wrap(a == b ? PolySqr(a) : PolyMul(a, b));
+			break;
+		case LIBPOLY_NEG:
+			*result = Wrap(PolyNeg(a));
+			break;
+		case LIBPOLY_AT:
+			*result = Wrap(PolyAt(a, arg));
+			break;
+		case LIBPOLY_EXP:
+			*result = Wrap(PolyExp(a, (poly_exp_t)arg));
+			break;
+		case LIBPOLY_DEG:
+			*value = PolyDeg(a);
+			break;
+		case LIBPOLY_DEG_BY:
+			*value = PolyDegBy(a, (unsigned)arg);
+			break;
+		case LIBPOLY_IS_EQ:
+			*value = PolyIsEq(a, b);
+			break;
+		case LIBPOLY_IS_ZERO:
+			*value = PolyIsZero(a);
+			break;
+		case LIBPOLY_IS_COEFF:
+			*value = PolyIsCoeff(a);
+			break;
+	}
+	return true;
+}
+
+size_t LibPolyRun(size_t count, const int ops[], const LibPoly *const p[], const LibPoly *const q[],
+		const long args[], LibPoly *results[], long values[]) {
+	size_t i;
+	for (i = 0 ; i < count ; i++)
+		if (!RunOne(ops[i], p[i], q != NULL ? q[i] : NULL, args != NULL ? args[i] : 0, args != NULL,
+				results != NULL ? &results[i] : NULL, values != NULL ? &values[i] : NULL))
+			break;
+	return i;
+}
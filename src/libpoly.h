@@ -0,0 +1,130 @@
+/** @file
+   Interfejs biblioteki libpoly dla programów w innych językach.
+   Wielomiany są dostępne przez nieprzezroczyste uchwyty, a operacje
+   można zlecać całymi tablicami, żeby koszt jednego wywołania przez FFI
+   rozłożył się na wiele operacji. Układ typów i wartości kodów operacji
+   nie zmieniają się w obrębie jednej wersji @ref LIBPOLY_VERSION.
+
+   @author Aleksandra Grzyb
+   @copyright Uniwersytet Warszawski
+   @date 2017-05-20
+*/
+
+#ifndef __LIBPOLY_H__
+#define __LIBPOLY_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LIBPOLY_VERSION 1 ///<wersja interfejsu binarnego biblioteki
+
+/** Uchwyt wielomianu */
+typedef struct LibPoly LibPoly;
+
+/**
+ * Kody operacji dla @ref LibPolyRun. Operacje do @ref LIBPOLY_EXP włącznie
+ * tworzą wielomian, pozostałe liczbę.
+ */
+enum LibPolyOp {
+	LIBPOLY_CLONE = 0, ///<kopia `p`
+	LIBPOLY_ADD = 1, ///<`p + q`
+	LIBPOLY_SUB = 2, ///<`p - q`
+	LIBPOLY_MUL = 3, ///<`p * q`
+	LIBPOLY_NEG = 4, ///<`-p`
+	LIBPOLY_AT = 5, ///<wartość `p` w punkcie `arg`
+	LIBPOLY_EXP = 6, ///<`p` do potęgi `arg`
+	LIBPOLY_DEG = 7, ///<stopień `p`
+	LIBPOLY_DEG_BY = 8, ///<stopień `p` ze względu na zmienną `arg`
+	LIBPOLY_IS_EQ = 9, ///<1, jeśli `p = q`, 0 w przeciwnym razie
+	LIBPOLY_IS_ZERO = 10, ///<1, jeśli `p` jest zerem, 0 w przeciwnym razie
+	LIBPOLY_IS_COEFF = 11 ///<1, jeśli `p` jest stałą, 0 w przeciwnym razie
+};
+
+/**
+ * Zwraca wersję interfejsu binarnego biblioteki.
+ * @return @ref LIBPOLY_VERSION, z którą biblioteka została zbudowana
+ */
+int LibPolyVersion(void);
+
+/**
+ * Tworzy wielomian stały.
+ * @param[in] c : współczynnik
+ * @return uchwyt wielomianu
+ */
+LibPoly *LibPolyFromCoeff(long c);
+
+/**
+ * Wczytuje wielomian w formacie kalkulatora, np. `(1,2)+((3,1),4)`.
+ * @param[in] text : tekst zakończony zerem, bez znaku nowej linii
+ * @return uchwyt wielomianu albo NULL, jeśli tekst jest niepoprawny
+ */
+LibPoly *LibPolyParse(const char *text);
+
+/**
+ * Wczytuje tablicę wielomianów.
+ * @param[in] count : liczba tekstów
+ * @param[in] texts : teksty
+ * @param[out] results : uchwyty wielomianów; NULL dla niepoprawnych tekstów
+ * @return liczba poprawnie wczytanych wielomianów
+ */
+size_t LibPolyParseBatch(size_t count, const char *const texts[], LibPoly *results[]);
+
+/**
+ * Zapisuje wielomian w formacie kalkulatora, tak jak robi to PRINT.
+ * Zapisuje co najwyżej @p size bajtów razem z kończącym zerem.
+ * @param[in] p : wielomian
+ * @param[out] buffer : bufor lub NULL, gdy @p size jest zerem
+ * @param[in] size : rozmiar bufora
+ * @return długość całego tekstu bez kończącego zera
+ */
+size_t LibPolyFormat(const LibPoly *p, char *buffer, size_t size);
+
+/**
+ * Zwalnia wielomian.
+ * @param[in] p : uchwyt wielomianu lub NULL
+ */
+void LibPolyFree(LibPoly *p);
+
+/**
+ * Zwalnia tablicę wielomianów.
+ * @param[in] count : liczba uchwytów
+ * @param[in] polys : uchwyty wielomianów; NULL są pomijane
+ */
+void LibPolyFreeBatch(size_t count, LibPoly *const polys[]);
+
+/**
+ * Składa wielomiany: podstawia @p x[i] w miejsce i-tej zmiennej @p p.
+ * @param[in] p : wielomian
+ * @param[in] count : liczba podstawianych wielomianów
+ * @param[in] x : podstawiane wielomiany
+ * @return uchwyt wyniku
+ */
+LibPoly *LibPolyCompose(const LibPoly *p, size_t count, const LibPoly *const x[]);
+
+/**
+ * Wykonuje @p count operacji w jednym wywołaniu. Operacja `i` ma kod
+ * `ops[i]`, argumenty `p[i]`, `q[i]` i `args[i]`. Wynik wielomianowy trafia
+ * do `results[i]`, a liczbowy do `values[i]`; drugie z tych miejsc dostaje
+ * NULL albo 0. Tablice niepotrzebne żadnej z operacji mogą być NULL.
+ * Przetwarzanie kończy się na pierwszej operacji o nieznanym kodzie
+ * lub z brakującym argumentem.
+ * @param[in] count : liczba operacji
+ * @param[in] ops : kody operacji z @ref LibPolyOp
+ * @param[in] p : pierwsze argumenty
+ * @param[in] q : drugie argumenty operacji dwuargumentowych
+ * @param[in] args : argumenty liczbowe AT, EXP i DEG_BY
+ * @param[out] results : wyniki wielomianowe, zwalniane przez wołającego
+ * @param[out] values : wyniki liczbowe
+ * @return liczba wykonanych operacji; mniejsza od @p count oznacza błąd
+ */
+size_t LibPolyRun(size_t count, const int ops[], const LibPoly *const p[], const LibPoly *const q[],
+		const long args[], LibPoly *results[], long values[]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LIBPOLY_H__ */
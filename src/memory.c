@@ -0,0 +1,298 @@
+/** @file
+  Licznik pamięci zajmowanej przez wielomiany i stos.
+  Liczniki są atomowe, więc węzły mogą być alokowane z wielu wątków.
+  Obszar pamięci jest przypisany do wątku, który go ustawił, i przydziela
+  węzły przesuwając wskaźnik w kawałkach; do liczników doliczane są całe
+  kawałki. Bufor roboczy wątku działa jak stos kawałków: kawałki zostają
+  w wątku po zwolnieniu tablic, a kawałek za mały dla nowej tablicy jest
+  zastępowany większym.
+  @author Aleksandra Grzyb
+  @copyright Uniwersytet Warszawski
+  @date 2017-05-20
+  */
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <assert.h>
+#include "memory.h"
+#include "utils.h"
+#define ARENA_CHUNK 65536 ///<najmniejszy rozmiar kawałka obszaru w bajtach
+#define ARENA_ALIGN alignof(max_align_t) ///<wyrównanie węzłów przydzielanych z obszaru
+#define SCRATCH_CHUNK 65536 ///<najmniejszy rozmiar kawałka bufora roboczego w bajtach
+
+static atomic_size_t liveBytes; ///<bajty w żywych węzłach
+static atomic_size_t peakBytes; ///<szczytowa liczba bajtów
+static atomic_size_t liveNodes; ///<liczba żywych węzłów
+static atomic_size_t peakNodes; ///<szczytowa liczba węzłów
+
+/**
+ * Podnosi maksimum do zadanej wartości.
+ * @param[in] peak : maksimum
+ * @param[in] value : nowa wartość
+ */
+static void RaisePeak(atomic_size_t *peak, size_t value) {
+	size_t old = atomic_load_explicit(peak, memory_order_relaxed);
+	while (value > old
+			&& !atomic_compare_exchange_weak_explicit(peak, &old, value,
+				memory_order_relaxed, memory_order_relaxed));
+}
+
+/**
+ * Kawałek obszaru pamięci.
+ */
+typedef struct ArenaChunk {
+	struct ArenaChunk *next; ///<poprzednio przydzielony kawałek
+	size_t size; ///<rozmiar danych kawałka
+	size_t used; ///<liczba zajętych bajtów danych
+	alignas(ARENA_ALIGN) unsigned char data[]; ///<dane
+} ArenaChunk;
+
+/**
+ * Obszar pamięci: lista kawałków, od najnowszego.
+ */
+struct MemArena {
+	ArenaChunk *chunks; ///<kawałki obszaru
+	size_t bytes; ///<łączny rozmiar kawałków
+};
+
+/** Obszar, z którego przydziela bieżący wątek, lub NULL */
+static _Thread_local MemArena *arena = NULL;
+
+/** Bajty przydzielone przez bieżący wątek minus przez niego zwolnione, modulo 2^64 */
+static _Thread_local size_t threadBytes = 0;
+
+/** Węzły przydzielone przez bieżący wątek minus przez niego zwolnione, modulo 2^64 */
+static _Thread_local size_t threadNodes = 0;
+
+/**
+ * Dolicza pamięć do liczników.
+ * @param[in] size : liczba bajtów
+ */
+static void Count(size_t size) {
+	threadBytes += size;
+	threadNodes++;
+	RaisePeak(&peakBytes, atomic_fetch_add_explicit(&liveBytes, size, memory_order_relaxed) + size);
+	RaisePeak(&peakNodes, atomic_fetch_add_explicit(&liveNodes, 1, memory_order_relaxed) + 1);
+}
+
+/**
+ * Odlicza pamięć od liczników.
+ * @param[in] size : liczba bajtów
+ */
+static void Uncount(size_t size) {
+	threadBytes -= size;
+	threadNodes--;
+	atomic_fetch_sub_explicit(&liveBytes, size, memory_order_relaxed);
+	atomic_fetch_sub_explicit(&liveNodes, 1, memory_order_relaxed);
+}
+
+/**
+ * Przydziela węzeł z obszaru, dokładając kawałek, gdy w ostatnim brakuje miejsca.
+ * @param[in] a : obszar
+ * @param[in] size : rozmiar węzła
+ * @return przydzielona pamięć
+ */
+static void *ArenaAlloc(MemArena *a, size_t size) {
+	size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+	ArenaChunk *c = a->chunks;
+	if (c == NULL || c->size - c->used < size) {
+		size_t capacity = size > ARENA_CHUNK ? size : ARENA_CHUNK;
+		c = (ArenaChunk *)malloc(sizeof(ArenaChunk) + capacity);
+		assert(c != NULL);
+		c->next = a->chunks;
+		c->size = capacity;
+		c->used = 0;
+		a->chunks = c;
+		a->bytes += capacity;
+		Count(capacity);
+	}
+	void *ptr = c->data + c->used;
+	c->used += size;
+	return ptr;
+}
+
+void *MemAlloc(size_t size) {
+	if (arena != NULL)
+		return ArenaAlloc(arena, size);
+	void *ptr = malloc(size);
+	assert(ptr != NULL);
+	Count(size);
+	return ptr;
+}
+
+void MemFree(void *ptr, size_t size) {
+	if (ptr == NULL || arena != NULL)
+		return;
+	Uncount(size);
+	free(ptr);
+}
+
+MemArena *MemArenaNew(void) {
+	MemArena *a = (MemArena *)malloc(sizeof(MemArena));
+	assert(a != NULL);
+	a->chunks = NULL;
+	a->bytes = 0;
+	return a;
+}
+
+void MemArenaReset(MemArena *a) {
+	while (a->chunks != NULL) {
+		ArenaChunk *c = a->chunks;
+		a->chunks = c->next;
+		Uncount(c->size);
+		free(c);
+	}
+	a->bytes = 0;
+}
+
+void MemArenaDestroy(MemArena *a) {
+	if (a == NULL)
+		return;
+	MemArenaReset(a);
+	free(a);
+}
+
+MemArena *MemArenaSwitch(MemArena *a) {
+	MemArena *previous = arena;
+	arena = a;
+	return previous;
+}
+
+size_t MemArenaBytes(const MemArena *a) {
+	return a->bytes;
+}
+
+/**
+ * Kawałek bufora roboczego.
+ */
+typedef struct ScratchChunk {
+	struct ScratchChunk *next; ///<następny kawałek, wolny, gdy ten jest wierzchołkiem
+	size_t size; ///<rozmiar danych kawałka
+	size_t used; ///<liczba zajętych bajtów danych
+	alignas(ARENA_ALIGN) unsigned char data[]; ///<dane
+} ScratchChunk;
+
+static _Thread_local ScratchChunk *scratchFirst = NULL; ///<pierwszy kawałek bufora roboczego wątku
+static _Thread_local ScratchChunk *scratchTop = NULL; ///<kawałek z wierzchołkiem bufora lub NULL, gdy bufor jest pusty
+static _Thread_local size_t scratchBytes = 0; ///<rozmiar kawałków bufora roboczego wątku
+static pthread_key_t scratchKey; ///<klucz, którego destruktor zwalnia kawałki kończącego się wątku
+static pthread_once_t scratchOnce = PTHREAD_ONCE_INIT; ///<jednorazowe utworzenie @ref scratchKey
+
+/**
+ * Zwalnia listę kawałków bufora roboczego.
+ * @param[in] first : pierwszy kawałek
+ */
+static void ScratchFree(void *first) {
+	ScratchChunk *c = (ScratchChunk *)first;
+	while (c != NULL) {
+		ScratchChunk *next = c->next;
+		free(c);
+		c = next;
+	}
+}
+
+/**
+ * Tworzy klucz wątku zwalniający bufor roboczy.
+ */
+static void ScratchKeyCreate(void) {
+	int error = pthread_key_create(&scratchKey, ScratchFree);
+	assert(error == 0);
+	(void)error;
+}
+
+ScratchMark ScratchSave(void) {
+	return (ScratchMark) {scratchTop, scratchTop != NULL ? scratchTop->used : 0};
+}
+
+void *ScratchAlloc(size_t size) {
+	size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+	ScratchChunk *c = scratchTop;
+	if (c == NULL || c->size - c->used < size) {
+		ScratchChunk **link = c == NULL ? &scratchFirst : &(c->next);
+		ScratchChunk *next = *link;
+		if (next == NULL || next->size < size) {
+			size_t capacity = c != NULL ? 2 * c->size : SCRATCH_CHUNK;
+			if (capacity < size)
+				capacity = size;
+			ScratchChunk *fresh = (ScratchChunk *)malloc(sizeof(ScratchChunk) + capacity);
+			assert(fresh != NULL);
+			fresh->size = capacity;
+			fresh->next = NULL;
+			if (next != NULL) {
+				fresh->next = next->next;
+				scratchBytes -= next->size;
+				free(next);
+			}
+			scratchBytes += capacity;
+			*link = fresh;
+			if (link == &scratchFirst) {
+				pthread_once(&scratchOnce, ScratchKeyCreate);
+				pthread_setspecific(scratchKey, fresh);
+			}
+		}
+		c = *link;
+		c->used = 0;
+		scratchTop = c;
+	}
+	void *ptr = c->data + c->used;
+	c->used += size;
+	return ptr;
+}
+
+void *ScratchGrow(void *ptr, size_t oldSize, size_t newSize) {
+	size_t old = (oldSize + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+	size_t size = (newSize + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+	ScratchChunk *c = scratchTop;
+	if (ptr != NULL && c != NULL && c->used >= old && ptr == c->data + c->used - old
+			&& c->size - c->used >= size - old) {
+		c->used += size - old;
+		return ptr;
+	}
+	void *result = ScratchAlloc(newSize);
+	if (ptr != NULL)
+		memcpy(result, ptr, oldSize);
+	return result;
+}
+
+void ScratchRestore(ScratchMark mark) {
+	scratchTop = mark.chunk;
+	if (mark.chunk != NULL)
+		mark.chunk->used = mark.used;
+}
+
+void ScratchRelease(void) {
+	assert(scratchTop == NULL);
+	if (scratchFirst == NULL)
+		return;
+	ScratchFree(scratchFirst);
+	scratchFirst = NULL;
+	scratchBytes = 0;
+	pthread_setspecific(scratchKey, NULL);
+}
+
+size_t ScratchBytes(void) {
+	return scratchBytes;
+}
+
+MemoryUsage MemUsage(void) {
+	MemoryUsage usage;
+	usage.liveBytes = atomic_load_explicit(&liveBytes, memory_order_relaxed);
+	usage.peakBytes = atomic_load_explicit(&peakBytes, memory_order_relaxed);
+	usage.liveNodes = atomic_load_explicit(&liveNodes, memory_order_relaxed);
+	usage.peakNodes = atomic_load_explicit(&peakNodes, memory_order_relaxed);
+	return usage;
+}
+
+void MemThreadBalance(size_t *bytes, size_t *nodes) {
+	*bytes = threadBytes;
+	*nodes = threadNodes;
+}
+
+void MemResetPeak(void) {
+	atomic_store_explicit(&peakBytes, atomic_load_explicit(&liveBytes, memory_order_relaxed), memory_order_relaxed);
+	atomic_store_explicit(&peakNodes, atomic_load_explicit(&liveNodes, memory_order_relaxed), memory_order_relaxed);
+}
@@ -0,0 +1,157 @@
+/** @file
+   Interfejs licznika pamięci zajmowanej przez wielomiany i stos
+
+   @author Aleksandra Grzyb
+   @copyright Uniwersytet Warszawski
+   @date 2017-05-20
+*/
+
+#ifndef __MEMORY_H__
+#define __MEMORY_H__
+
+#include <stddef.h>
+
+/**
+ * Zużycie pamięci przez węzły list jednomianów, stosu i list wczytywanych
+ * jednomianów. Liczone są rozmiary węzłów, bez narzutu alokatora.
+ */
+typedef struct MemoryUsage {
+	size_t liveBytes; ///<bajty w żywych węzłach
+	size_t peakBytes; ///<największa dotychczasowa wartość @p liveBytes
+	size_t liveNodes; ///<liczba żywych węzłów
+	size_t peakNodes; ///<największa dotychczasowa wartość @p liveNodes
+} MemoryUsage;
+
+/**
+ * Alokuje węzeł i dolicza go do zużycia pamięci.
+ * @param[in] size : rozmiar węzła
+ * @return zaalokowana pamięć
+ */
+void *MemAlloc(size_t size);
+
+/**
+ * Zwalnia węzeł zaalokowany przez @ref MemAlloc.
+ * @param[in] ptr : węzeł
+ * @param[in] size : rozmiar węzła podany przy alokacji
+ */
+void MemFree(void *ptr, size_t size);
+
+/**
+ * Obszar pamięci, z którego węzły są przydzielane kolejno i zwalniane
+ * wszystkie naraz.
+ */
+typedef struct MemArena MemArena;
+
+/**
+ * Tworzy pusty obszar pamięci.
+ * @return obszar
+ */
+MemArena *MemArenaNew(void);
+
+/**
+ * Zwalnia wszystkie węzły przydzielone z obszaru. Obszar można dalej używać.
+ * @param[in] a : obszar
+ */
+void MemArenaReset(MemArena *a);
+
+/**
+ * Zwalnia obszar razem z jego węzłami.
+ * @param[in] a : obszar
+ */
+void MemArenaDestroy(MemArena *a);
+
+/**
+ * Ustawia obszar, z którego bieżący wątek przydziela węzły. Dopóki jest
+ * ustawiony, @ref MemAlloc przydziela z niego, a @ref MemFree nic nie robi,
+ * więc węzły zwalniane w tym czasie muszą pochodzić z tego obszaru.
+ * @param[in] a : obszar lub NULL, żeby wrócić do zwykłej alokacji
+ * @return poprzednio ustawiony obszar
+ */
+MemArena *MemArenaSwitch(MemArena *a);
+
+/**
+ * Zwraca liczbę bajtów zajętych przez obszar.
+ * @param[in] a : obszar
+ * @return rozmiar kawałków obszaru
+ */
+size_t MemArenaBytes(const MemArena *a);
+
+/**
+ * Stan bufora roboczego wątku zapamiętany przez @ref ScratchSave.
+ */
+typedef struct ScratchMark {
+	struct ScratchChunk *chunk; ///<kawałek z wierzchołkiem bufora lub NULL, gdy bufor był pusty
+	size_t used; ///<liczba zajętych bajtów tego kawałka
+} ScratchMark;
+
+/**
+ * Zapamiętuje stan bufora roboczego bieżącego wątku. Bufor roboczy służy
+ * do tablic tymczasowych: przydziela je kolejno z kawałków, które zostają
+ * w wątku i są używane przez kolejne wywołania, a zwalnia wszystkie tablice
+ * przydzielone po zapamiętaniu stanu naraz, w kolejności odwrotnej do
+ * zapamiętywania. Kawałki są zwalniane po zakończeniu wątku albo przez
+ * @ref ScratchRelease.
+ * @return stan bufora
+ */
+ScratchMark ScratchSave(void);
+
+/**
+ * Przydziela tablicę tymczasową z bufora roboczego bieżącego wątku.
+ * Pamięć nie jest zerowana.
+ * @param[in] size : rozmiar tablicy w bajtach
+ * @return przydzielona pamięć, wyrównana jak w malloc
+ */
+void *ScratchAlloc(size_t size);
+
+/**
+ * Powiększa tablicę tymczasową. Ostatnio przydzieloną tablicę powiększa
+ * w miejscu, jeśli jest miejsce w kawałku, a w przeciwnym razie przydziela
+ * nową i kopiuje do niej zawartość.
+ * @param[in] ptr : tablica z @ref ScratchAlloc lub NULL
+ * @param[in] oldSize : obecny rozmiar tablicy
+ * @param[in] newSize : nowy rozmiar tablicy, nie mniejszy od @p oldSize
+ * @return powiększona tablica
+ */
+void *ScratchGrow(void *ptr, size_t oldSize, size_t newSize);
+
+/**
+ * Zwalnia wszystkie tablice tymczasowe przydzielone od zapamiętania stanu.
+ * @param[in] mark : stan z @ref ScratchSave
+ */
+void ScratchRestore(ScratchMark mark);
+
+/**
+ * Oddaje systemowi kawałki bufora roboczego bieżącego wątku bez czekania
+ * na koniec wątku. Bufor musi być pusty, czyli wszystkie tablice muszą być
+ * zwolnione przez @ref ScratchRestore.
+ */
+void ScratchRelease(void);
+
+/**
+ * Zwraca rozmiar kawałków bufora roboczego bieżącego wątku.
+ * @return liczba bajtów
+ */
+size_t ScratchBytes(void);
+
+/**
+ * Zwraca bieżące i szczytowe zużycie pamięci całego procesu.
+ * @return zużycie pamięci
+ */
+MemoryUsage MemUsage(void);
+
+/**
+ * Zwraca bilans węzłów bieżącego wątku: bajty i węzły przez niego
+ * przydzielone minus przez niego zwolnione. Wątek może zwalniać węzły
+ * przydzielone przez inne, więc znaczenie ma tylko różnica dwóch odczytów,
+ * liczona modulo 2^64.
+ * @param[out] bytes : bilans bajtów
+ * @param[out] nodes : bilans węzłów
+ */
+void MemThreadBalance(size_t *bytes, size_t *nodes);
+
+/**
+ * Ustawia szczytowe zużycie pamięci na bieżące.
+ */
+void MemResetPeak(void);
+
+#endif /* __MEMORY_H__ */
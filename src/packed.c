@@ -0,0 +1,605 @@
+/** @file
+  Wielomiany rzadkie z upakowanymi wykładnikami.
+  Współczynniki są liczone w arytmetyce modulo 2^64, tak jak przy przepełnieniu
+  w wielomianach rekurencyjnych.
+  @author Aleksandra Grzyb
+  @copyright Uniwersytet Warszawski
+  @date 2017-05-20
+  */
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "packed.h"
+#include "budget.h"
+#include "memory.h"
+#include "utils.h"
+#define WORD_BITS 64 ///<liczba bitów słowa wykładników
+#define MIN_BITS 8 ///<najmniejsza liczba bitów na wykładnik
+#define MIN_CAPACITY 4 ///<najmniejsza liczba wyrazów, na które rezerwowane jest miejsce
+
+/**
+ * Zwraca liczbę słów jednego wyrazu.
+ * @param[in] p : wielomian
+ * @return liczba słów wyrazu
+ */
+static inline size_t Stride(const PackedPoly *p) {
+	return p->words + 1;
+}
+
+/**
+ * Zwraca wykładniki wyrazu.
+ * @param[in] p : wielomian
+ * @param[in] i : numer wyrazu
+ * @return słowa wykładników wyrazu
+ */
+static inline uint64_t *Exps(const PackedPoly *p, size_t i) {
+	return p->terms + i * Stride(p);
+}
+
+/**
+ * Zwraca współczynnik wyrazu.
+ * @param[in] p : wielomian
+ * @param[in] i : numer wyrazu
+ * @return współczynnik wyrazu modulo 2^64
+ */
+static inline uint64_t Coef(const PackedPoly *p, size_t i) {
+	return p->terms[i * Stride(p) + p->words];
+}
+
+/**
+ * Liczy słowa potrzebne na wykładniki zmiennych.
+ * @param[in] vars : liczba zmiennych
+ * @param[in] bits : liczba bitów na wykładnik
+ * @return liczba słów
+ */
+static inline unsigned WordsFor(unsigned vars, unsigned bits) {
+	unsigned perWord = WORD_BITS / bits;
+	return (vars + perWord - 1) / perWord;
+}
+
+/**
+ * Dobiera najmniejszą szerokość pola mieszczącą wykładnik.
+ * @param[in] max : największy wykładnik
+ * @return liczba bitów na wykładnik
+ */
+static unsigned BitsFor(uint64_t max) {
+	unsigned bits = MIN_BITS;
+	while (bits < WORD_BITS && (max >> bits) != 0)
+		bits *= 2;
+	return bits;
+}
+
+/**
+ * Odczytuje wykładnik zmiennej.
+ * @param[in] exps : słowa wykładników
+ * @param[in] bits : liczba bitów na wykładnik
+ * @param[in] var : numer zmiennej
+ * @return wykładnik
+ */
+static inline uint64_t GetField(const uint64_t *exps, unsigned bits, unsigned var) {
+	unsigned perWord = WORD_BITS / bits;
+	unsigned shift = WORD_BITS - bits * (var % perWord + 1);
+	uint64_t mask = bits == WORD_BITS ? UINT64_MAX : ((uint64_t)1 << bits) - 1;
+	return (exps[var / perWord] >> shift) & mask;
+}
+
+/**
+ * Zapisuje wykładnik zmiennej.
+ * @param[in] exps : słowa wykładników
+ * @param[in] bits : liczba bitów na wykładnik
+ * @param[in] var : numer zmiennej
+ * @param[in] value : wykładnik
+ */
+static inline void SetField(uint64_t *exps, unsigned bits, unsigned var, uint64_t value) {
+	unsigned perWord = WORD_BITS / bits;
+	unsigned shift = WORD_BITS - bits * (var % perWord + 1);
+	uint64_t mask = bits == WORD_BITS ? UINT64_MAX : ((uint64_t)1 << bits) - 1;
+	exps[var / perWord] = (exps[var / perWord] & ~(mask << shift)) | ((value & mask) << shift);
+}
+
+/**
+ * Porównuje wykładniki dwóch wyrazów.
+ * @param[in] a : słowa wykładników
+ * @param[in] b : słowa wykładników
+ * @param[in] words : liczba słów
+ * @return liczba ujemna, zero lub dodatnia, gdy a jest mniejsze, równe lub większe od b
+ */
+static inline int CompareExps(const uint64_t *a, const uint64_t *b, unsigned words) {
+	for (unsigned w = 0 ; w < words ; w++)
+		if (a[w] != b[w])
+			return a[w] < b[w] ? -1 : 1;
+	return 0;
+}
+
+/**
+ * Tworzy pusty wielomian o zadanym układzie wykładników.
+ * @param[in] vars : liczba zmiennych
+ * @param[in] bits : liczba bitów na wykładnik
+ * @param[in] capacity : liczba wyrazów, na które jest rezerwowane miejsce
+ * @return pusty wielomian
+ */
+static PackedPoly NewPacked(unsigned vars, unsigned bits, size_t capacity) {
+	PackedPoly p = {.terms = NULL, .size = 0, .capacity = 0, .vars = vars, .bits = bits,
+		.words = WordsFor(vars, bits)};
+	if (capacity > 0) {
+		p.terms = (uint64_t *)MemAlloc(capacity * Stride(&p) * sizeof(uint64_t));
+		p.capacity = capacity;
+	}
+	return p;
+}
+
+/**
+ * Dopisuje wyraz na koniec wielomianu, powiększając w razie potrzeby tablicę.
+ * @param[in] p : wielomian
+ * @param[in] exps : słowa wykładników
+ * @param[in] coef : współczynnik modulo 2^64
+ */
+static void Append(PackedPoly *p, const uint64_t *exps, uint64_t coef) {
+	if (p->size == p->capacity) {
+		size_t capacity = p->capacity < MIN_CAPACITY ? MIN_CAPACITY : 2 * p->capacity;
+		uint64_t *terms = (uint64_t *)MemAlloc(capacity * Stride(p) * sizeof(uint64_t));
+		if (p->size > 0)
+			memcpy(terms, p->terms, p->size * Stride(p) * sizeof(uint64_t));
+		MemFree(p->terms, PackedBytes(p));
+		p->terms = terms;
+		p->capacity = capacity;
+	}
+	uint64_t *term = Exps(p, p->size++);
+	memcpy(term, exps, p->words * sizeof(uint64_t));
+	term[p->words] = coef;
+}
+
+void PackedDestroy(PackedPoly *p) {
+	MemFree(p->terms, PackedBytes(p));
+	*p = PackedZero();
+}
+
+size_t PackedBytes(const PackedPoly *p) {
+	return p->capacity * Stride(p) * sizeof(uint64_t);
+}
+
+PackedPoly PackedClone(const PackedPoly *p) {
+	PackedPoly clone = NewPacked(p->vars, p->bits, p->size);
+	if (p->size > 0)
+		memcpy(clone.terms, p->terms, p->size * Stride(p) * sizeof(uint64_t));
+	clone.size = p->size;
+	return clone;
+}
+
+bool PackedIsCoeff(const PackedPoly *p) {
+	if (p->size == 0)
+		return true;
+	if (p->size > 1)
+		return false;
+	for (unsigned w = 0 ; w < p->words ; w++)
+		if (p->terms[w] != 0)
+			return false;
+	return true;
+}
+
+/**
+ * Zwraca największy wykładnik dowolnej zmiennej.
+ * @param[in] p : wielomian
+ * @return największy wykładnik
+ */
+static uint64_t MaxField(const PackedPoly *p) {
+	uint64_t max = 0;
+	for (size_t i = 0 ; i < p->size ; i++)
+		for (unsigned var = 0 ; var < p->vars ; var++) {
+			uint64_t e = GetField(Exps(p, i), p->bits, var);
+			if (e > max)
+				max = e;
+		}
+	return max;
+}
+
+/**
+ * Przepisuje wielomian do szerszego układu wykładników. Kolejność wyrazów
+ * się nie zmienia, bo nie zależy od układu.
+ * @param[in] p : wielomian
+ * @param[in] vars : liczba zmiennych, nie mniejsza niż w @p p
+ * @param[in] bits : liczba bitów na wykładnik, nie mniejsza niż w @p p
+ * @return wielomian w nowym układzie
+ */
+static PackedPoly Repack(const PackedPoly *p, unsigned vars, unsigned bits) {
+	PackedPoly result = NewPacked(vars, bits, p->size);
+	for (size_t i = 0 ; i < p->size ; i++) {
+		uint64_t *term = Exps(&result, i);
+		memset(term, 0, result.words * sizeof(uint64_t));
+		for (unsigned var = 0 ; var < p->vars ; var++)
+			SetField(term, bits, var, GetField(Exps(p, i), p->bits, var));
+		term[result.words] = Coef(p, i);
+	}
+	result.size = p->size;
+	return result;
+}
+
+/**
+ * Zwraca wielomian w zadanym układzie wykładników, przepisując go tylko
+ * wtedy, gdy ma inny układ.
+ * @param[in] p : wielomian
+ * @param[in] vars : liczba zmiennych
+ * @param[in] bits : liczba bitów na wykładnik
+ * @param[in] tmp : miejsce na przepisany wielomian, do usunięcia przez wołającego
+ * @return @p p albo @p tmp
+ */
+static const PackedPoly *InLayout(const PackedPoly *p, unsigned vars, unsigned bits, PackedPoly *tmp) {
+	if (p->vars == vars && p->bits == bits)
+		return p;
+	*tmp = Repack(p, vars, bits);
+	return tmp;
+}
+
+/**
+ * Sortuje wyrazy po wykładnikach przez scalanie, a następnie sumuje wyrazy
+ * o równych wykładnikach i usuwa wyrazy zerowe.
+ * @param[in] p : wielomian
+ */
+static void Normalize(PackedPoly *p) {
+	size_t stride = Stride(p);
+	bool sorted = true;
+	for (size_t i = 1 ; i < p->size && sorted ; i++)
+		sorted = CompareExps(Exps(p, i - 1), Exps(p, i), p->words) <= 0;
+	if (!sorted) {
+		ScratchMark mark = ScratchSave();
+		uint64_t *buffer = (uint64_t *)ScratchAlloc(p->size * stride * sizeof(uint64_t));
+		uint64_t *from = p->terms;
+		uint64_t *to = buffer;
+		for (size_t width = 1 ; width < p->size ; width *= 2) {
+			for (size_t begin = 0 ; begin < p->size ; begin += 2 * width) {
+				size_t middle = begin + width < p->size ? begin + width : p->size;
+				size_t end = middle + width < p->size ? middle + width : p->size;
+				size_t i = begin, j = middle, k = begin;
+				while (i < middle || j < end) {
+					size_t next = j == end || (i < middle
+							&& CompareExps(from + i * stride, from + j * stride, p->words) <= 0) ? i++ : j++;
+					memcpy(to + k++ * stride, from + next * stride, stride * sizeof(uint64_t));
+				}
+			}
+			uint64_t *tmp = from;
+			from = to;
+			to = tmp;
+		}
+		if (from != p->terms)
+			memcpy(p->terms, from, p->size * stride * sizeof(uint64_t));
+		ScratchRestore(mark);
+	}
+	size_t size = 0;
+	for (size_t i = 0 ; i < p->size ; i++) {
+		if (size > 0 && CompareExps(Exps(p, size - 1), Exps(p, i), p->words) == 0) {
+			Exps(p, size - 1)[p->words] += Coef(p, i);
+			if (Coef(p, size - 1) == 0)
+				size--;
+		}
+		else if (Coef(p, i) != 0) {
+			if (size != i)
+				memcpy(Exps(p, size), Exps(p, i), stride * sizeof(uint64_t));
+			size++;
+		}
+	}
+	p->size = size;
+}
+
+/**
+ * Mierzy wielomian rekurencyjny.
+ * @param[in] p : wielomian
+ * @param[in] var : numer zmiennej wielomianu
+ * @param[in] vars : liczba zmiennych z niezerowym wykładnikiem
+ * @param[in] max : największy wykładnik
+ * @param[in] terms : liczba niezerowych współczynników
+ */
+static void Measure(const Poly *p, unsigned var, unsigned *vars, uint64_t *max, size_t *terms) {
+	if (p->coef != 0)
+		(*terms)++;
+	for (List *l = p->monos ; l != NULL ; l = l->next) {
+		if (l->value.exp > 0) {
+			if (var + 1 > *vars)
+				*vars = var + 1;
+			if ((uint64_t)l->value.exp > *max)
+				*max = (uint64_t)l->value.exp;
+		}
+		Measure(&(l->value.p), var + 1, vars, max, terms);
+	}
+}
+
+/**
+ * Przepisuje wyrazy wielomianu rekurencyjnego.
+ * @param[in] p : wielomian
+ * @param[in] var : numer zmiennej wielomianu
+ * @param[in] exps : wykładniki zmiennych poprzednich poziomów
+ * @param[in] result : wielomian wynikowy
+ */
+static void Collect(const Poly *p, unsigned var, uint64_t *exps, PackedPoly *result) {
+	if (p->coef != 0)
+		Append(result, exps, (uint64_t)p->coef);
+	for (List *l = p->monos ; l != NULL ; l = l->next) {
+		if (var < result->vars)
+			SetField(exps, result->bits, var, (uint64_t)l->value.exp);
+		Collect(&(l->value.p), var + 1, exps, result);
+	}
+	if (var < result->vars)
+		SetField(exps, result->bits, var, 0);
+}
+
+PackedPoly PackedFromPoly(const Poly *p) {
+	unsigned vars = 0;
+	uint64_t max = 0;
+	size_t terms = 0;
+	Measure(p, 0, &vars, &max, &terms);
+	PackedPoly result = NewPacked(vars, BitsFor(max), terms);
+	ScratchMark mark = ScratchSave();
+	uint64_t *exps = (uint64_t *)ScratchAlloc((result.words + 1) * sizeof(uint64_t));
+	memset(exps, 0, (result.words + 1) * sizeof(uint64_t));
+	Collect(p, 0, exps, &result);
+	ScratchRestore(mark);
+	Normalize(&result);
+	return result;
+}
+
+/**
+ * Buduje wielomian rekurencyjny z przedziału wyrazów o równych wykładnikach
+ * zmiennych o numerach mniejszych niż @p var.
+ * @param[in] p : wielomian
+ * @param[in] begin : pierwszy wyraz przedziału
+ * @param[in] end : wyraz za przedziałem
+ * @param[in] var : numer zmiennej
+ * @return wielomian zmiennych od @p var
+ */
+static Poly ToPolyRange(const PackedPoly *p, size_t begin, size_t end, unsigned var) {
+	if (var >= p->vars) {
+		uint64_t coef = 0;
+		for (size_t i = begin ; i < end ; i++)
+			coef += Coef(p, i);
+		return PolyFromCoeff((poly_coeff_t)coef);
+	}
+	PolyBuilder builder = PolyBuilderNew(0);
+	size_t i = begin;
+	while (i < end) {
+		uint64_t e = GetField(Exps(p, i), p->bits, var);
+		size_t j = i + 1;
+		while (j < end && GetField(Exps(p, j), p->bits, var) == e)
+			j++;
+		Poly sub = ToPolyRange(p, i, j, var + 1);
+		Mono mono = MonoFromPoly(&sub, (poly_exp_t)e);
+		PolyBuilderPush(&builder, &mono);
+		i = j;
+	}
+	return PolyBuilderFinish(&builder);
+}
+
+Poly PackedToPoly(const PackedPoly *p) {
+	return ToPolyRange(p, 0, p->size, 0);
+}
+
+/**
+ * Scala dwa wielomiany, dodając lub odejmując drugi od pierwszego.
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @param[in] sign : 1 dla dodawania, -1 (modulo 2^64) dla odejmowania
+ * @return `p + sign * q`
+ */
+static PackedPoly Merge(const PackedPoly *p, const PackedPoly *q, uint64_t sign) {
+	unsigned vars = p->vars > q->vars ? p->vars : q->vars;
+	unsigned bits = p->bits > q->bits ? p->bits : q->bits;
+	PackedPoly tmpP = PackedZero(), tmpQ = PackedZero();
+	const PackedPoly *a = InLayout(p, vars, bits, &tmpP);
+	const PackedPoly *b = InLayout(q, vars, bits, &tmpQ);
+	PackedPoly result = NewPacked(vars, bits, a->size + b->size);
+	size_t i = 0, j = 0;
+	while (i < a->size || j < b->size) {
+		int cmp = i == a->size ? 1 : j == b->size ? -1 : CompareExps(Exps(a, i), Exps(b, j), result.words);
+		if (cmp < 0) {
+			Append(&result, Exps(a, i), Coef(a, i));
+			i++;
+		}
+		else if (cmp > 0) {
+			Append(&result, Exps(b, j), sign * Coef(b, j));
+			j++;
+		}
+		else {
+			uint64_t coef = Coef(a, i) + sign * Coef(b, j);
+			if (coef != 0)
+				Append(&result, Exps(a, i), coef);
+			i++;
+			j++;
+		}
+	}
+	PackedDestroy(&tmpP);
+	PackedDestroy(&tmpQ);
+	return result;
+}
+
+PackedPoly PackedAdd(const PackedPoly *p, const PackedPoly *q) {
+	return Merge(p, q, 1);
+}
+
+PackedPoly PackedSub(const PackedPoly *p, const PackedPoly *q) {
+	return Merge(p, q, UINT64_MAX);
+}
+
+PackedPoly PackedNeg(const PackedPoly *p) {
+	PackedPoly result = PackedClone(p);
+	for (size_t i = 0 ; i < result.size ; i++)
+		Exps(&result, i)[result.words] = -Coef(&result, i);
+	return result;
+}
+
+/**
+ * Element kopca iloczynów: wyraz @p i pierwszego czynnika razy wyraz @p j drugiego.
+ */
+typedef struct HeapEntry {
+	size_t i; ///<numer wyrazu pierwszego czynnika
+	size_t j; ///<numer wyrazu drugiego czynnika
+} HeapEntry;
+
+/**
+ * Porównuje wykładniki dwóch iloczynów wyrazów.
+ * @param[in] a : pierwszy czynnik
+ * @param[in] b : drugi czynnik
+ * @param[in] x : iloczyn
+ * @param[in] y : iloczyn
+ * @return liczba ujemna, zero lub dodatnia, gdy x jest mniejszy, równy lub większy od y
+ */
+static inline int CompareProducts(const PackedPoly *a, const PackedPoly *b, HeapEntry x, HeapEntry y) {
+	const uint64_t *ax = Exps(a, x.i), *bx = Exps(b, x.j);
+	const uint64_t *ay = Exps(a, y.i), *by = Exps(b, y.j);
+	for (unsigned w = 0 ; w < a->words ; w++) {
+		uint64_t ex = ax[w] + bx[w];
+		uint64_t ey = ay[w] + by[w];
+		if (ex != ey)
+			return ex < ey ? -1 : 1;
+	}
+	return 0;
+}
+
+/**
+ * Przesuwa element kopca w dół na właściwe miejsce.
+ * @param[in] a : pierwszy czynnik
+ * @param[in] b : drugi czynnik
+ * @param[in] heap : kopiec
+ * @param[in] size : rozmiar kopca
+ */
+static void SiftDown(const PackedPoly *a, const PackedPoly *b, HeapEntry heap[], size_t size) {
+	size_t k = 0;
+	HeapEntry entry = heap[0];
+	while (2 * k + 1 < size) {
+		size_t child = 2 * k + 1;
+		if (child + 1 < size && CompareProducts(a, b, heap[child + 1], heap[child]) < 0)
+			child++;
+		if (CompareProducts(a, b, heap[child], entry) >= 0)
+			break;
+		heap[k] = heap[child];
+		k = child;
+	}
+	heap[k] = entry;
+}
+
+PackedPoly PackedMul(const PackedPoly *p, const PackedPoly *q) {
+	bool exact;
+	return PackedMulChecked(p, q, &exact);
+}
+
+PackedPoly PackedMulChecked(const PackedPoly *p, const PackedPoly *q, bool *exact) {
+	if (p->size > q->size) {
+		const PackedPoly *tmp = p;
+		p = q;
+		q = tmp;
+	}
+	unsigned vars = p->vars > q->vars ? p->vars : q->vars;
+	unsigned bits = BitsFor(MaxField(p) + MaxField(q));
+	if (bits < p->bits)
+		bits = p->bits;
+	if (bits < q->bits)
+		bits = q->bits;
+	PackedPoly result = NewPacked(vars, bits, p->size + q->size);
+	*exact = true;
+	if (p->size == 0)
+		return result;
+	PackedPoly tmpP = PackedZero(), tmpQ = PackedZero();
+	const PackedPoly *a = InLayout(p, vars, bits, &tmpP);
+	const PackedPoly *b = InLayout(q, vars, bits, &tmpQ);
+	ScratchMark mark = ScratchSave();
+	HeapEntry *heap = (HeapEntry *)ScratchAlloc(a->size * sizeof(HeapEntry));
+	uint64_t *exps = (uint64_t *)ScratchAlloc((result.words + 1) * sizeof(uint64_t));
+	size_t size = a->size;
+	for (size_t i = 0 ; i < size ; i++)
+		heap[i] = (HeapEntry) {.i = i, .j = 0};
+	while (size > 0 && !BudgetCheck(result.size, result.capacity * Stride(&result) * sizeof(uint64_t))) {
+		HeapEntry top = heap[0];
+		for (unsigned w = 0 ; w < result.words ; w++)
+			exps[w] = Exps(a, top.i)[w] + Exps(b, top.j)[w];
+		__int128 coef = 0;
+		bool wide = false;
+		do {
+			HeapEntry entry = heap[0];
+			__int128 product = (__int128)(int64_t)Coef(a, entry.i) * (int64_t)Coef(b, entry.j);
+			wide |= __builtin_add_overflow(coef, product, &coef);
+			if (entry.j + 1 < b->size)
+				heap[0].j++;
+			else heap[0] = heap[--size];
+			if (size > 0)
+				SiftDown(a, b, heap, size);
+		} while (size > 0 && CompareProducts(a, b, heap[0], top) == 0);
+		if (wide || coef != (int64_t)coef)
+			*exact = false;
+		if ((uint64_t)coef != 0)
+			Append(&result, exps, (uint64_t)coef);
+	}
+	ScratchRestore(mark);
+	PackedDestroy(&tmpP);
+	PackedDestroy(&tmpQ);
+	return result;
+}
+
+bool PackedIsEq(const PackedPoly *p, const PackedPoly *q) {
+	if (p->size != q->size)
+		return false;
+	unsigned vars = p->vars > q->vars ? p->vars : q->vars;
+	unsigned bits = p->bits > q->bits ? p->bits : q->bits;
+	PackedPoly tmpP = PackedZero(), tmpQ = PackedZero();
+	const PackedPoly *a = InLayout(p, vars, bits, &tmpP);
+	const PackedPoly *b = InLayout(q, vars, bits, &tmpQ);
+	bool result = a->size == 0 || memcmp(a->terms, b->terms, a->size * Stride(a) * sizeof(uint64_t)) == 0;
+	PackedDestroy(&tmpP);
+	PackedDestroy(&tmpQ);
+	return result;
+}
+
+poly_exp_t PackedDeg(const PackedPoly *p) {
+	poly_exp_t result = -1;
+	for (size_t i = 0 ; i < p->size ; i++) {
+		uint64_t deg = 0;
+		for (unsigned var = 0 ; var < p->vars ; var++)
+			deg += GetField(Exps(p, i), p->bits, var);
+		if ((poly_exp_t)deg > result)
+			result = (poly_exp_t)deg;
+	}
+	return result;
+}
+
+poly_exp_t PackedDegBy(const PackedPoly *p, unsigned var_idx) {
+	if (p->size == 0)
+		return -1;
+	if (var_idx >= p->vars)
+		return 0;
+	poly_exp_t result = 0;
+	for (size_t i = 0 ; i < p->size ; i++) {
+		poly_exp_t deg = (poly_exp_t)GetField(Exps(p, i), p->bits, var_idx);
+		if (deg > result)
+			result = deg;
+	}
+	return result;
+}
+
+/**
+ * Podnosi liczbę do potęgi modulo 2^64.
+ * @param[in] x : podstawa
+ * @param[in] e : wykładnik
+ * @return x^e modulo 2^64
+ */
+static uint64_t Power(uint64_t x, uint64_t e) {
+	uint64_t result = 1;
+	while (e > 0) {
+		if (e & 1)
+			result *= x;
+		x *= x;
+		e >>= 1;
+	}
+	return result;
+}
+
+PackedPoly PackedAt(const PackedPoly *p, poly_coeff_t x) {
+	unsigned vars = p->vars > 0 ? p->vars - 1 : 0;
+	PackedPoly result = NewPacked(vars, p->bits, p->size);
+	for (size_t i = 0 ; i < p->size ; i++) {
+		uint64_t *term = Exps(&result, i);
+		memset(term, 0, result.words * sizeof(uint64_t));
+		for (unsigned var = 0 ; var < vars ; var++)
+			SetField(term, p->bits, var, GetField(Exps(p, i), p->bits, var + 1));
+		uint64_t e = p->vars > 0 ? GetField(Exps(p, i), p->bits, 0) : 0;
+		term[result.words] = Coef(p, i) * Power((uint64_t)x, e);
+	}
+	result.size = p->size;
+	Normalize(&result);
+	return result;
+}
@@ -0,0 +1,169 @@
+/** @file
+   Interfejs wielomianów rzadkich z upakowanymi wykładnikami
+
+   @author Aleksandra Grzyb
+   @copyright Uniwersytet Warszawski
+   @date 2017-05-20
+*/
+
+#ifndef __PACKED_H__
+#define __PACKED_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "poly.h"
+
+/**
+ * Wielomian w postaci rozproszonej: jedna tablica wyrazów posortowanych
+ * rosnąco po wykładnikach zmiennych x_0, x_1, ...
+ * Wyraz zajmuje `words + 1` słów: najpierw wykładniki zmiennych układu
+ * upakowane po `bits` bitów (x_0 na najstarszych bitach pierwszego słowa),
+ * potem współczynnik. Porównanie jednomianów to porównanie słów jak liczb,
+ * a mnożenie jednomianów to dodawanie słów. Wyrazy mają niezerowe
+ * współczynniki i różne wykładniki.
+ */
+typedef struct PackedPoly {
+	uint64_t *terms; ///<wyrazy
+	size_t size; ///<liczba wyrazów
+	size_t capacity; ///<liczba wyrazów, na które jest miejsce
+	unsigned vars; ///<liczba zmiennych w układzie wykładników
+	unsigned bits; ///<liczba bitów na wykładnik jednej zmiennej: 8, 16, 32 lub 64
+	unsigned words; ///<liczba słów wykładników w wyrazie
+} PackedPoly;
+
+/**
+ * Tworzy wielomian tożsamościowo równy zeru.
+ * @return wielomian zerowy
+ */
+static inline PackedPoly PackedZero(void) {
+	return (PackedPoly) {.terms = NULL, .size = 0, .capacity = 0, .vars = 0, .bits = 8, .words = 0};
+}
+
+/**
+ * Sprawdza, czy wielomian jest tożsamościowo równy zeru.
+ * @param[in] p : wielomian
+ * @return czy wielomian jest równy zeru
+ */
+static inline bool PackedIsZero(const PackedPoly *p) {
+	return p->size == 0;
+}
+
+/**
+ * Sprawdza, czy wielomian jest współczynnikiem.
+ * @param[in] p : wielomian
+ * @return czy wielomian jest współczynnikiem
+ */
+bool PackedIsCoeff(const PackedPoly *p);
+
+/**
+ * Usuwa wielomian z pamięci.
+ * @param[in] p : wielomian
+ */
+void PackedDestroy(PackedPoly *p);
+
+/**
+ * Robi pełną kopię wielomianu.
+ * @param[in] p : wielomian
+ * @return skopiowany wielomian
+ */
+PackedPoly PackedClone(const PackedPoly *p);
+
+/**
+ * Zamienia wielomian rekurencyjny na postać upakowaną.
+ * @param[in] p : wielomian
+ * @return wielomian w postaci upakowanej
+ */
+PackedPoly PackedFromPoly(const Poly *p);
+
+/**
+ * Zamienia wielomian w postaci upakowanej na wielomian rekurencyjny.
+ * @param[in] p : wielomian
+ * @return wielomian rekurencyjny
+ */
+Poly PackedToPoly(const PackedPoly *p);
+
+/**
+ * Dodaje dwa wielomiany.
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @return `p + q`
+ */
+PackedPoly PackedAdd(const PackedPoly *p, const PackedPoly *q);
+
+/**
+ * Odejmuje wielomian od wielomianu.
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @return `p - q`
+ */
+PackedPoly PackedSub(const PackedPoly *p, const PackedPoly *q);
+
+/**
+ * Zwraca przeciwny wielomian.
+ * @param[in] p : wielomian
+ * @return `-p`
+ */
+PackedPoly PackedNeg(const PackedPoly *p);
+
+/**
+ * Mnoży dwa wielomiany, scalając iloczyny wyrazów kopcem.
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @return `p * q`
+ */
+PackedPoly PackedMul(const PackedPoly *p, const PackedPoly *q);
+
+/**
+ * Mnoży dwa wielomiany tak jak @ref PackedMul, sumując iloczyny wyrazów
+ * o równych wykładnikach w 128 bitach i sprawdzając, czy współczynniki
+ * wyniku mieszczą się w @ref poly_coeff_t. Po przekroczeniu ograniczeń
+ * z @ref BudgetCheck przerywa scalanie iloczynów.
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @param[out] exact : czy wszystkie współczynniki iloczynu są dokładne
+ * @return `p * q` ze współczynnikami modulo 2^64
+ */
+PackedPoly PackedMulChecked(const PackedPoly *p, const PackedPoly *q, bool *exact);
+
+/**
+ * Sprawdza równość dwóch wielomianów.
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @return `p = q`
+ */
+bool PackedIsEq(const PackedPoly *p, const PackedPoly *q);
+
+/**
+ * Zwraca stopień wielomianu (-1 dla wielomianu tożsamościowo równego zeru).
+ * @param[in] p : wielomian
+ * @return stopień wielomianu
+ */
+poly_exp_t PackedDeg(const PackedPoly *p);
+
+/**
+ * Zwraca stopień wielomianu ze względu na zadaną zmienną (-1 dla wielomianu
+ * tożsamościowo równego zeru).
+ * @param[in] p : wielomian
+ * @param[in] var_idx : indeks zmiennej
+ * @return stopień wielomianu ze względu na zmienną
+ */
+poly_exp_t PackedDegBy(const PackedPoly *p, unsigned var_idx);
+
+/**
+ * Wylicza wartość wielomianu w punkcie @p x, podstawiając ją za x_0
+ * i przenumerowując pozostałe zmienne o jeden w dół.
+ * @param[in] p : wielomian
+ * @param[in] x : wartość argumentu
+ * @return @f$p(x, x_0, x_1, \ldots)@f$
+ */
+PackedPoly PackedAt(const PackedPoly *p, poly_coeff_t x);
+
+/**
+ * Zwraca liczbę bajtów zajmowanych przez wyrazy wielomianu.
+ * @param[in] p : wielomian
+ * @return liczba bajtów
+ */
+size_t PackedBytes(const PackedPoly *p);
+
+#endif /* __PACKED_H__ */
@@ -4,11 +4,49 @@
   @copyright Uniwersytet Warszawski
   @date 2017-04-15
   */
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <unistd.h>
 #include "poly.h"
 #include <math.h>
+#include "budget.h"
+#include "cache.h"
+#include "dense.h"
+#include "memory.h"
+#include "packed.h"
+#include "shallow.h"
+#include "stats.h"
+#include "trace.h"
 #include "utils.h"
+#define BUILDER_CAPACITY 8 ///<początkowy rozmiar tablicy akumulatora jednomianów
+#define INSERTION_SORT_MAX 32 ///<najwięcej jednomianów sortowanych przez wstawianie
+#define RADIX_BITS 8 ///<liczba bitów wykładnika na przebieg sortowania pozycyjnego
+#define RADIX (1 << RADIX_BITS) ///<liczba cyfr sortowania pozycyjnego
+#define DENSE_MIN_LENGTH 16 ///<najmniejszy stopień plus jeden wielomianu zamienianego na tablicę
+#define DENSE_RATIO 2 ///<najwięcej współczynników tablicy na jeden niezerowy wyraz
+#define PLAN_SCHOOLBOOK_MAX 16 ///<najwięcej iloczynów jednomianów, przy których PolyMul zawsze sortuje iloczyny
+#define PLAN_DENSE_RATIO 2 ///<najwięcej wykładników zakresu iloczynu na iloczyn jednomianów przy tablicy indeksowanej wykładnikiem
+#define PLAN_DENSE_MAX_RANGE (1 << 20) ///<największy zakres wykładników tablicy indeksowanej wykładnikiem, także wymuszonej
+#define PLAN_ACCUMULATE_FAN_IN 32 ///<najwięcej iloczynów jednomianów na wykładnik przy dodawaniu ich od razu do wyniku
+#define PLAN_ACCUMULATE_MAX_DEPTH 4 ///<największa głębokość czynników przy dodawaniu iloczynów od razu do wyniku
+#define POWER_CACHE_SIZE 8 ///<liczba potęg podstawianego wielomianu pamiętanych w PolyCompose
+#define PROBABLE_PRIME_LOW 2305843009213693951u ///<pierwszy moduł PolyProbablyEq, 2^61 - 1
+#define PROBABLE_PRIME_HIGH 4611686018427387847u ///<drugi moduł PolyProbablyEq, 2^62 - 57
+#define PROBABLE_ENTROPY "/dev/urandom" ///<źródło ziarna generatora punktów PolyProbablyEq
+
+/**
+ * Zwalnia jeden element listy jednomianów, nie niszcząc jego wartości.
+ * @param[in] l : element listy
+ */
+static inline void FreeList(List *l) {
+	MemFree(l, sizeof(List));
+}
+
 /**
  * Usuwa listę jednomianów.
  * @param[in] l
@@ -17,7 +55,7 @@ void PolyDestroyList (List *l) {
 	if (l != NULL) {
 		MonoDestroy(&(l->value));
 		PolyDestroyList(l->next);
-		free(l);
+		FreeList(l);
 	}
 }
 
@@ -32,11 +70,12 @@ void PolyDestroy (Poly *p) {
  * @return nowa lista
  */
 static List * NewList(){
-	List * res = (List *)malloc(sizeof(List));
+	List * res = (List *)MemAlloc(sizeof(List));
 	assert(res != NULL);
 	res->next = NULL;
 	res->value.p = PolyZero();
 	res->value.exp = 0;
+	res->value.depth = 1;
 	return res;
 }
 
@@ -58,17 +97,128 @@ List * ListClone(List *p) {
 		result = result->next;
 	}
 	result = first->next;
-	free(first);
+	FreeList(first);
 	return result;
 }
 
-Poly PolyClone(const Poly *p) {
+/**
+ * Liczy @ref PolyClone w bieżącym obszarze pamięci wątku.
+ */
+static Poly Clone(const Poly *p) {
 	Poly clone;
 	clone.coef = p->coef;
 	clone.monos = ListClone(p->monos);
 	return clone;
 }
 
+/**
+ * Dodaje stałą do wielomianu. Stała trafia do najgłębszego jednomianu
+ * o zerowych wykładnikach, tak by wyraz wolny był zapisany w jednym miejscu.
+ * @param[in] p : wielomian
+ * @param[in] coef : stała
+ */
+static void AddCoeff(Poly *p, poly_coeff_t coef) {
+	while (p->monos != NULL && p->monos->value.exp == 0)
+		p = &(p->monos->value.p);
+	p->coef += coef;
+}
+
+/**
+ * Wyznacza wyraz wolny wielomianu, czyli jego wartość w zerze.
+ * @param[in] p : wielomian
+ * @return wyraz wolny
+ */
+static poly_coeff_t ConstantTerm(const Poly *p) {
+	poly_coeff_t result = 0;
+	while (true) {
+		result += p->coef;
+		if (p->monos == NULL || p->monos->value.exp != 0)
+			return result;
+		p = &(p->monos->value.p);
+	}
+}
+
+/**
+ * Sprawdza, czy wielomian opłaca się zamienić na tablicę współczynników:
+ * jest wielomianem jednej zmiennej o stałych współczynnikach, dostatecznie
+ * wysokiego stopnia i co najmniej co @ref DENSE_RATIO wyraz jest niezerowy.
+ * @param[in] p : wielomian
+ * @return stopień wielomianu plus jeden albo 0, jeśli się nie opłaca
+ */
+static size_t DenseLength(const Poly *p) {
+	size_t terms = 1;
+	poly_exp_t degree = 0;
+	for (List *l = p->monos ; l != NULL ; l = l->next) {
+		if (!PolyIsCoeff(&(l->value.p)))
+			return 0;
+		degree = l->value.exp;
+		terms++;
+	}
+	size_t length = (size_t)degree + 1;
+	if (length < DENSE_MIN_LENGTH || length > terms * DENSE_RATIO)
+		return 0;
+	return length;
+}
+
+/**
+ * Zamienia wielomian jednej zmiennej o stałych współczynnikach na tablicę
+ * współczynników w buforze roboczym. Jednomiany o wykładnikach spoza tablicy
+ * są pomijane.
+ * @param[in] p : wielomian
+ * @param[in] length : długość tablicy
+ * @return tablica współczynników, od wyrazu wolnego
+ */
+static uint64_t *ToDense(const Poly *p, size_t length) {
+	uint64_t *result = (uint64_t *)ScratchAlloc(length * sizeof(uint64_t));
+	memset(result, 0, length * sizeof(uint64_t));
+	result[0] = (uint64_t)p->coef;
+	for (List *l = p->monos ; l != NULL && (size_t)l->value.exp < length ; l = l->next)
+		result[l->value.exp] += (uint64_t)l->value.p.coef;
+	return result;
+}
+
+/**
+ * Zamienia tablicę współczynników na wielomian.
+ * @param[in] coefs : tablica współczynników, od wyrazu wolnego
+ * @param[in] length : długość tablicy
+ * @return wielomian
+ */
+static Poly FromDense(uint64_t *coefs, size_t length) {
+	Poly result = PolyFromCoeff((poly_coeff_t)coefs[0]);
+	List **last = &(result.monos);
+	for (size_t i = 1 ; i < length ; i++)
+		if (coefs[i] != 0) {
+			List *l = NewList();
+			l->value.p = PolyFromCoeff((poly_coeff_t)coefs[i]);
+			l->value.exp = (poly_exp_t)i;
+			l->value.depth = 1;
+			*last = l;
+			last = &(l->next);
+		}
+	return result;
+}
+
+unsigned PolyDepth(const Poly *p) {
+	unsigned result = 0;
+	for (List *l = p->monos ; l != NULL ; l = l->next) {
+		unsigned depth = l->value.depth > 0 ? l->value.depth : PolyDepth(&(l->value.p)) + 1;
+		if (depth > result)
+			result = depth;
+	}
+	return result;
+}
+
+/**
+ * Uaktualnia głębokość jednomianu, do którego współczynnika dodano
+ * współczynnik innego jednomianu.
+ * @param[in] m : jednomian, do którego dodano
+ * @param[in] n : dodany jednomian
+ */
+static inline void MergeDepth(Mono *m, const Mono *n) {
+	if (n->depth == 0 || n->depth > m->depth)
+		m->depth = m->depth == 0 ? 0 : n->depth;
+}
+
 /**
  *Dodawanie  wielomianu durgiego do pierwszego
  *@param[in] p : wielomian do którego będzie dodany pierwszy
@@ -81,11 +231,11 @@ void PolyAddTo(Poly *p, Poly *q) {
 	List *listQ = q->monos;	
 	p->coef = p->coef + q->coef;
 	if (p->monos != NULL && p->monos->value.exp == 0) {
-		p->monos->value.p.coef += p->coef;
+		AddCoeff(&(p->monos->value.p), p->coef);
 		p->coef = 0;
 	}		
 	else if (q->monos != NULL && q->monos->value.exp == 0) {
-		q->monos->value.p.coef += p->coef;
+		AddCoeff(&(q->monos->value.p), p->coef);
 		p->coef = 0;
 	}
 
@@ -104,6 +254,7 @@ void PolyAddTo(Poly *p, Poly *q) {
 			Poly *tmp = &(listP->value.p);
 			Poly *tmp2 = &(listQ->value.p);
 			PolyAddTo((tmp), (tmp2));
+			MergeDepth(&(listP->value), &(listQ->value));
 			if (!(PolyIsCoeff((tmp)) && listP->value.exp == 0) && !PolyIsZero((tmp))) {
 				monos->next = listP;
 				monos = monos->next;
@@ -113,11 +264,11 @@ void PolyAddTo(Poly *p, Poly *q) {
 				p->coef += listP->value.p.coef; 
 				List *tmpp = listP;
 				listP = listP->next;
-				free(tmpp);
+				FreeList(tmpp);
 			}
 			List *tmmp = listQ;
 			listQ = listQ->next;
-			free(tmmp);
+			FreeList(tmmp);
 		}
 	}
 	if (listQ != NULL) 
@@ -126,10 +277,25 @@ void PolyAddTo(Poly *p, Poly *q) {
 		monos->next = listP;
 	else monos->next = NULL;
 	p->monos = first->next;
-	free(first);
+	FreeList(first);
 }
 
-Poly PolyAdd(const Poly *p, const Poly *q) {
+/**
+ * Liczy @ref PolyAdd w bieżącym obszarze pamięci wątku.
+ */
+static Poly Add(const Poly *p, const Poly *q) {
+	size_t lengthP = DenseLength(p);
+	size_t lengthQ = DenseLength(q);
+	if (lengthP > 0 && lengthQ > 0) {
+		size_t length = lengthP > lengthQ ? lengthP : lengthQ;
+		ScratchMark mark = ScratchSave();
+		uint64_t *coefs = ToDense(p, length);
+		uint64_t *coefsQ = ToDense(q, lengthQ);
+		DenseAdd(coefs, coefsQ, lengthQ);
+		Poly result = FromDense(coefs, length);
+		ScratchRestore(mark);
+		return result;
+	}
 	Poly a = PolyClone(p);
 	Poly b = PolyClone(q);
 	PolyAddTo(&a, &b);
@@ -137,58 +303,131 @@ Poly PolyAdd(const Poly *p, const Poly *q) {
 }
 
 /**
- * Porównuje dwa jednomiany w pierwszej kolejności, patrząc na wykładnik, 
- * następnie sorutje je po wielomianie jednomianu, uwzględniając czy jest współczynnikiem.
- * @param[in] p1 : pierwszy monomian
- * @param[in] p2 : drugi monomian
- * @return jeśi p1 > p2 zwraca 1, p1 = p2 0, w przeciwnym razie -1
+ * Sortuje jednomiany po wykładnikach przez wstawianie.
+ * @param[in] monos : jednomiany
+ * @param[in] count : liczba jednomianów
  */
-int Compare (const void *p1, const void *p2) {
-	if ( ((Mono *)p1)->exp < ((Mono *)p2)->exp) return -1;
-	if ( ((Mono *)p1)->exp > ((Mono *)p2)->exp) return 1;
-	if ( PolyIsCoeff(&(((Mono *)p1)->p))) return -1;
-	if ( PolyIsCoeff(&(((Mono *)p2)->p))) return 1;	
-	return 0;
+static void InsertionSortMonos(Mono monos[], unsigned count) {
+	for (unsigned i = 1 ; i < count ; i++) {
+		Mono mono = monos[i];
+		unsigned j = i;
+		while (j > 0 && monos[j - 1].exp > mono.exp) {
+			monos[j] = monos[j - 1];
+			j--;
+		}
+		monos[j] = mono;
+	}
 }
 
-Poly PolyAddMonos(unsigned count, const Mono mono[]) {
-	Poly result = PolyZero();
-	List *monosList = NewList();
-	monosList->next = NewList();
-	List *first = monosList;
-	qsort((Mono *)mono, count, sizeof(Mono), Compare);
-	poly_coeff_t anteriorExp = -1; 
+/**
+ * Sortuje jednomiany po wykładnikach pozycyjnie, po RADIX_BITS bitów
+ * na przebieg, wykonując tylko przebiegi potrzebne dla rozpiętości wykładników.
+ * @param[in] monos : jednomiany
+ * @param[in] count : liczba jednomianów
+ */
+static void RadixSortMonos(Mono monos[], unsigned count) {
+	poly_exp_t min = monos[0].exp;
+	poly_exp_t max = monos[0].exp;
+	for (unsigned i = 1 ; i < count ; i++) {
+		if (monos[i].exp < min)
+			min = monos[i].exp;
+		if (monos[i].exp > max)
+			max = monos[i].exp;
+	}
+	unsigned range = (unsigned)max - (unsigned)min;
+	ScratchMark mark = ScratchSave();
+	Mono *buffer = (Mono *)ScratchAlloc(count * sizeof(Mono));
+	Mono *from = monos;
+	Mono *to = buffer;
+	for (unsigned shift = 0 ; shift < sizeof(unsigned) * CHAR_BIT && (range >> shift) > 0 ; shift += RADIX_BITS) {
+		unsigned offsets[RADIX] = {0};
+		for (unsigned i = 0 ; i < count ; i++)
+			offsets[(((unsigned)from[i].exp - (unsigned)min) >> shift) & (RADIX - 1)]++;
+		unsigned sum = 0;
+		for (unsigned digit = 0 ; digit < RADIX ; digit++) {
+			unsigned size = offsets[digit];
+			offsets[digit] = sum;
+			sum += size;
+		}
+		for (unsigned i = 0 ; i < count ; i++)
+			to[offsets[(((unsigned)from[i].exp - (unsigned)min) >> shift) & (RADIX - 1)]++] = from[i];
+		Mono *tmp = from;
+		from = to;
+		to = tmp;
+	}
+	if (from != monos)
+		memcpy(monos, from, count * sizeof(Mono));
+	ScratchRestore(mark);
+}
+
+void PolyBuilderPush(PolyBuilder *builder, const Mono *mono) {
+	if (PolyIsCoeff(&(mono->p)) && (mono->exp == 0 || mono->p.coef == 0)) {
+		builder->coef += mono->p.coef;
+		return;
+	}
+	if (builder->monos == NULL) {
+		if (builder->capacity < BUILDER_CAPACITY)
+			builder->capacity = BUILDER_CAPACITY;
+		builder->mark = ScratchSave();
+		builder->monos = (Mono *)ScratchAlloc(builder->capacity * sizeof(Mono));
+	}
+	else if (builder->size == builder->capacity) {
+		builder->monos = (Mono *)ScratchGrow(builder->monos, builder->capacity * sizeof(Mono),
+				2 * builder->capacity * sizeof(Mono));
+		builder->capacity *= 2;
+	}
+	if (builder->size > 0 && builder->monos[builder->size - 1].exp > mono->exp)
+		builder->sorted = false;
+	builder->monos[builder->size++] = *mono;
+}
+
+Poly PolyBuilderFinish(PolyBuilder *builder) {
+	if (!builder->sorted) {
+		TraceBegin("PolyBuilder.sort", "count", builder->size);
+		if (builder->size <= INSERTION_SORT_MAX)
+			InsertionSortMonos(builder->monos, builder->size);
+		else RadixSortMonos(builder->monos, builder->size);
+		TraceEnd();
+	}
+	Poly result = PolyFromCoeff(builder->coef);
+	List first = {.next = NULL};
+	List *last = &first;
 	unsigned i = 0;
-	bool add = false;
-	while (i < count && mono[i].exp == 0 && PolyIsCoeff(&(mono[i].p))) {
-		result.coef += mono[i].p.coef;
-		i++;	
-	}
-	for (; i < count ; i++) {
-		if (anteriorExp == mono[i].exp) {
-			PolyAddTo(&(monosList->next->value.p), (Poly *)&(mono[i].p));
-			add = true;
+	while (i < builder->size) {
+		Mono mono = builder->monos[i++];
+		while (i < builder->size && builder->monos[i].exp == mono.exp) {
+			MergeDepth(&mono, &(builder->monos[i]));
+			PolyAddTo(&(mono.p), &(builder->monos[i++].p));
 		}
-		else {	
-			if ((add && !PolyIsZero(&(monosList->next->value.p))) || !add) {	
-				monosList = monosList->next;
-				monosList->next = NewList();
-			}
-			anteriorExp = mono[i].exp;
-			monosList->next->value = mono[i];
-			add = false;
+		if (PolyIsCoeff(&(mono.p)) && (mono.exp == 0 || mono.p.coef == 0))
+			result.coef += mono.p.coef;
+		else {
+			last->next = NewList();
+			last = last->next;
+			last->value = mono;
 		}
 	}
-	if (add && PolyIsZero(&(monosList->next->value.p))) {
-		free(monosList->next);
-		monosList->next = NULL;
+	result.monos = first.next;
+	if (result.monos != NULL && result.monos->value.exp == 0) {
+		AddCoeff(&(result.monos->value.p), result.coef);
+		result.coef = 0;
 	}
-	result.monos = first->next->next;
-	free(first->next);
-	free(first);
+	if (builder->monos != NULL)
+		ScratchRestore(builder->mark);
+	*builder = PolyBuilderNew(0);
 	return result;
 }
 
+/**
+ * Liczy @ref PolyAddMonos w bieżącym obszarze pamięci wątku.
+ */
+static Poly AddMonos(unsigned count, const Mono mono[]) {
+	PolyBuilder builder = PolyBuilderNew(count);
+	for (unsigned i = 0 ; i < count ; i++)
+		PolyBuilderPush(&builder, &(mono[i]));
+	return PolyBuilderFinish(&builder);
+}
+
 /**
  * Mnoży wielomian przez niezerowy współczynnik 
  * @param[in] p : wielomian
@@ -209,11 +448,12 @@ void MultiplyPolyByNumberNo0 (Poly *p, poly_coeff_t coef) {
 		else {
 			List *pop = ancillaryList;
 			ancillaryList = ancillaryList->next;
-			free(pop);
+			FreeList(pop);
 		}
 	}
+	newList->next = NULL;
 	p->monos = first->next;
-	free(first);
+	FreeList(first);
 }
 
 /**
@@ -241,11 +481,12 @@ void MultiplyPolyByNumber (Poly *p, poly_coeff_t coef) {
 			else {
 				List *pop = ancillaryList;
 				ancillaryList = ancillaryList->next;
-				free(pop);
+				FreeList(pop);
 			}
 		}
+		newList->next = NULL;
 		p->monos = first->next;
-		free(first);
+		FreeList(first);
 	}
 }
 
@@ -277,38 +518,329 @@ unsigned Length (List *p) {
 	return i;
 }
 
-Poly PolyMul(const Poly *p, const Poly *q) {
-	Poly ancillaryPoly;
+/** Głębokość rekurencji PolyMul w bieżącym wątku, zapisywana w przebiegu */
+static _Thread_local long mulDepth = 0;
+
+/** Liczba operacji liczonych przez pamięć podręczną lub w kontekście w bieżącym wątku;
+ * operacje zagnieżdżone w nich nie są zapamiętywane */
+static _Thread_local unsigned cacheDepth = 0;
+
+/**
+ * Zwraca wynik operacji z pamięci podręcznej, a jeśli go tam nie ma,
+ * liczy go i zapamiętuje.
+ * @param[in] op : operacja
+ * @param[in] operands : argumenty
+ * @param[in] count : liczba argumentów
+ * @param[in] arg : argument liczbowy
+ * @param[in] compute : funkcja licząca operację
+ * @return wynik operacji
+ */
+static Poly Cached(enum CacheOp op, const Poly operands[], unsigned count, poly_coeff_t arg,
+		Poly (*compute)(const Poly[], unsigned, poly_coeff_t)) {
+	uint64_t hash;
+	Poly result;
+	if (CacheLookup(op, operands, count, arg, &hash, &result))
+		return result;
+	cacheDepth++;
+	result = compute(operands, count, arg);
+	cacheDepth--;
+	if (!BudgetCheck(0, 0))
+		CacheInsert(op, operands, count, arg, hash, &result);
+	return result;
+}
+
+/**
+ * Liczy PolyMul dla @ref Cached.
+ * @param[in] operands : czynniki
+ * @param[in] count : liczba czynników, 2
+ * @param[in] arg : nieużywany
+ * @return iloczyn
+ */
+static Poly ComputeMul(const Poly operands[], unsigned count, poly_coeff_t arg) {
+	(void)count;
+	(void)arg;
+	return PolyMul(&(operands[0]), &(operands[1]));
+}
+
+/** Sposób mnożenia ustawiony przez PolyMulSetStrategy */
+static atomic_int mulStrategy = MUL_AUTO;
+
+/** Nazwy przedziałów przebiegu dla kolejnych sposobów mnożenia; @ref MUL_AUTO jest zawsze rozstrzygany */
+static const char *const strategyTrace[] = {
+	"PolyMul", "PolyMul.schoolbook", "PolyMul.accumulate", "PolyMul.hash"
+};
+
+void PolyMulSetStrategy(MulStrategy strategy) {
+	atomic_store_explicit(&mulStrategy, (int)strategy, memory_order_relaxed);
+}
+
+MulStrategy PolyMulGetStrategy(void) {
+	return (MulStrategy)atomic_load_explicit(&mulStrategy, memory_order_relaxed);
+}
+
+/**
+ * Wybiera sposób mnożenia jednego poziomu rekurencji na podstawie liczby
+ * jednomianów, zakresu wykładników iloczynu i głębokości czynników.
+ * Dodawanie iloczynów od razu do współczynników wyniku opłaca się, gdy wiele
+ * iloczynów ma równe wykładniki, czyli zakres jest mały wobec ich liczby,
+ * a współczynniki są płytkie; głębokie współczynniki rosną przy dodawaniu
+ * tak, że szybsze jest zebranie wszystkich iloczynów i scalenie ich naraz.
+ * Tablica mieszająca zastępuje tablicę indeksowaną wykładnikiem, gdy zakres
+ * jest za duży na tablicę.
+ * @param[in] p : wielomian o niepustej liście jednomianów
+ * @param[in] q : wielomian o niepustej liście jednomianów
+ * @param[in] strategy : sposób ustawiony przez @ref PolyMulSetStrategy
+ * @param[out] low : najmniejszy wykładnik iloczynu
+ * @param[out] range : liczba wykładników od najmniejszego do największego
+ * @return sposób mnożenia, inny niż @ref MUL_AUTO; wymuszona tablica indeksowana
+ * wykładnikiem jest zastępowana mieszającą, gdy zakres przekracza @ref PLAN_DENSE_MAX_RANGE
+ */
+static MulStrategy PlanMul(const Poly *p, const Poly *q, MulStrategy strategy, poly_exp_t *low, size_t *range) {
+	size_t lengthP = 0, lengthQ = 0;
+	poly_exp_t highP = 0, highQ = 0;
+	for (List *l = p->monos ; l != NULL ; l = l->next, lengthP++)
+		highP = l->value.exp;
+	for (List *l = q->monos ; l != NULL ; l = l->next, lengthQ++)
+		highQ = l->value.exp;
+	*low = p->monos->value.exp + q->monos->value.exp;
+	*range = (size_t)highP + (size_t)highQ - (size_t)*low + 1;
+	MulStrategy accumulate = *range <= PLAN_DENSE_MAX_RANGE ? MUL_DENSE : MUL_HASH;
+	if (strategy != MUL_AUTO)
+		return strategy == MUL_DENSE ? accumulate : strategy;
+	size_t products = lengthP * lengthQ;
+	if (products <= PLAN_SCHOOLBOOK_MAX || *range > PLAN_DENSE_RATIO * products
+			|| products > PLAN_ACCUMULATE_FAN_IN * *range)
+		return MUL_SCHOOLBOOK;
+	unsigned depthP = PolyDepth(p);
+	unsigned depthQ = PolyDepth(q);
+	if ((depthP > depthQ ? depthP : depthQ) > PLAN_ACCUMULATE_MAX_DEPTH)
+		return MUL_SCHOOLBOOK;
+	return accumulate;
+}
+
+/**
+ * Mnoży listy jednomianów, zbierając wszystkie iloczyny w akumulatorze,
+ * który sortuje je i scala.
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @return suma iloczynów jednomianów @p p i @p q
+ */
+static Poly MulSchoolbook(const Poly *p, const Poly *q) {
+	PolyBuilder builder = PolyBuilderNew(Length(p->monos) * Length(q->monos));
+	for (List *listP = p->monos ; listP != NULL && !BudgetCheck(0, 0) ; listP = listP->next)
+		for (List *listQ = q->monos ; listQ != NULL ; listQ = listQ->next) {
+			Poly product = PolyMul(&(listP->value.p), &(listQ->value.p));
+			Mono mono = MonoFromPoly(&product, listP->value.exp + listQ->value.exp);
+			PolyBuilderPush(&builder, &mono);
+		}
+	return PolyBuilderFinish(&builder);
+}
+
+/**
+ * Mnoży listy jednomianów, dodając każdy iloczyn od razu do współczynnika
+ * w tablicy indeksowanej wykładnikiem iloczynu.
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @param[in] low : najmniejszy wykładnik iloczynu
+ * @param[in] range : liczba wykładników od najmniejszego do największego
+ * @return suma iloczynów jednomianów @p p i @p q
+ */
+static Poly MulAccumulate(const Poly *p, const Poly *q, poly_exp_t low, size_t range) {
+	ScratchMark mark = ScratchSave();
+	Poly *slots = (Poly *)ScratchAlloc(range * sizeof(Poly));
+	for (size_t i = 0 ; i < range ; i++)
+		slots[i] = PolyZero();
+	unsigned count = 0;
+	for (List *listP = p->monos ; listP != NULL && !BudgetCheck(0, 0) ; listP = listP->next)
+		for (List *listQ = q->monos ; listQ != NULL ; listQ = listQ->next) {
+			Poly product = PolyMul(&(listP->value.p), &(listQ->value.p));
+			Poly *slot = &(slots[listP->value.exp + listQ->value.exp - low]);
+			count += PolyIsZero(slot);
+			PolyAddTo(slot, &product);
+		}
+	PolyBuilder builder = PolyBuilderNew(count);
+	for (size_t i = 0 ; i < range ; i++)
+		if (!PolyIsZero(&(slots[i]))) {
+			Mono mono = MonoFromPoly(&(slots[i]), low + (poly_exp_t)i);
+			PolyBuilderPush(&builder, &mono);
+		}
+	Poly result = PolyBuilderFinish(&builder);
+	ScratchRestore(mark);
+	return result;
+}
+
+/**
+ * Miejsce tablicy mieszającej iloczynów jednomianów.
+ */
+typedef struct MulSlot {
+	Poly p; ///<suma iloczynów o danym wykładniku
+	poly_exp_t exp; ///<wykładnik
+	bool used; ///<czy miejsce jest zajęte
+} MulSlot;
+
+/**
+ * Mnoży listy jednomianów, dodając każdy iloczyn od razu do współczynnika
+ * w tablicy mieszającej z adresowaniem otwartym, a na końcu sortuje
+ * różne wykładniki w akumulatorze.
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @param[in] range : liczba wykładników od najmniejszego do największego
+ * @return suma iloczynów jednomianów @p p i @p q
+ */
+static Poly MulHash(const Poly *p, const Poly *q, size_t range) {
+	size_t products = (size_t)Length(p->monos) * Length(q->monos);
+	size_t limit = products < range ? products : range;
+	unsigned bits = 1;
+	while (((size_t)1 << bits) < 2 * limit)
+		bits++;
+	size_t mask = ((size_t)1 << bits) - 1;
+	ScratchMark mark = ScratchSave();
+	MulSlot *slots = (MulSlot *)ScratchAlloc((mask + 1) * sizeof(MulSlot));
+	for (size_t i = 0 ; i <= mask ; i++)
+		slots[i].used = false;
+	unsigned count = 0;
+	for (List *listP = p->monos ; listP != NULL && !BudgetCheck(0, 0) ; listP = listP->next)
+		for (List *listQ = q->monos ; listQ != NULL ; listQ = listQ->next) {
+			poly_exp_t exp = listP->value.exp + listQ->value.exp;
+			Poly product = PolyMul(&(listP->value.p), &(listQ->value.p));
+			size_t i = (size_t)(((uint64_t)(unsigned)exp * 0x9e3779b97f4a7c15u) >> (64 - bits));
+			while (slots[i].used && slots[i].exp != exp)
+				i = (i + 1) & mask;
+			if (slots[i].used)
+				PolyAddTo(&(slots[i].p), &product);
+			else {
+				slots[i] = (MulSlot) {.p = product, .exp = exp, .used = true};
+				count++;
+			}
+		}
+	PolyBuilder builder = PolyBuilderNew(count);
+	for (size_t i = 0 ; i <= mask ; i++)
+		if (slots[i].used) {
+			Mono mono = MonoFromPoly(&(slots[i].p), slots[i].exp);
+			PolyBuilderPush(&builder, &mono);
+		}
+	Poly result = PolyBuilderFinish(&builder);
+	ScratchRestore(mark);
+	return result;
+}
+
+/**
+ * Liczy @ref PolyMul w bieżącym obszarze pamięci wątku.
+ */
+static Poly Mul(const Poly *p, const Poly *q) {
+	if (BudgetCheck(0, 0))
+		return PolyZero();
+	if (CacheActive() && cacheDepth == 0) {
+		Poly operands[] = {*p, *q};
+		return Cached(CACHE_MUL, operands, 2, 0, ComputeMul);
+	}
+	MulStrategy strategy = PolyMulGetStrategy();
+	size_t lengthP = strategy == MUL_AUTO ? DenseLength(p) : 0;
+	size_t lengthQ = strategy == MUL_AUTO ? DenseLength(q) : 0;
+	if (lengthP > 0 && lengthQ > 0) {
+		TraceBegin("PolyMul.dense", "length", (long)(lengthP + lengthQ - 1));
+		ScratchMark mark = ScratchSave();
+		uint64_t *coefsP = ToDense(p, lengthP);
+		uint64_t *coefsQ = ToDense(q, lengthQ);
+		uint64_t *coefs = (uint64_t *)ScratchAlloc((lengthP + lengthQ - 1) * sizeof(uint64_t));
+		DenseMul(coefs, coefsP, lengthP, coefsQ, lengthQ);
+		Poly result = FromDense(coefs, lengthP + lengthQ - 1);
+		ScratchRestore(mark);
+		TraceEnd();
+		return result;
+	}
+	unsigned depthP = PolyDepth(p);
+	unsigned depthQ = PolyDepth(q);
+	unsigned depth = depthP > depthQ ? depthP : depthQ;
+	if (strategy == MUL_AUTO && depth <= SHALLOW_MAX_DEPTH) {
+		Poly result;
+		bool exact;
+		TraceBegin("PolyMul.shallow", "depth", (long)depth);
+		bool done = ShallowMul(p, q, depth, &result, &exact);
+		TraceEnd();
+		if (done)
+			return result;
+	}
 	Poly result = PolyZero();
-	unsigned size = Length(p->monos) * Length(q->monos);  
-	Mono t[size];
 	PolyMulOnlyCoef(p, q->coef, &result);
 	result.coef = 0;
 	PolyMulOnlyCoef(q, p->coef, &result);
-	unsigned index = 0;
-	List *listP = p->monos;
-	while (listP != NULL) {
-		List *listQ = q->monos;
-		while (listQ != NULL) {
-			ancillaryPoly = PolyMul(&(listP->value.p), &(listQ->value.p));
-			if (!PolyIsZero(&ancillaryPoly)) 
-				t[index++] = MonoFromPoly(&ancillaryPoly, listP->value.exp + listQ->value.exp);	
-			listQ = listQ->next;
-		}
-		listP = listP->next;
-	}
-	ancillaryPoly = PolyAddMonos(size, t);
+	if (p->monos == NULL || q->monos == NULL)
+		return result;
+	poly_exp_t low;
+	size_t range;
+	strategy = PlanMul(p, q, strategy, &low, &range);
+	TraceBegin(strategyTrace[strategy], "depth", mulDepth++);
+	Poly ancillaryPoly;
+	if (strategy == MUL_DENSE)
+		ancillaryPoly = MulAccumulate(p, q, low, range);
+	else if (strategy == MUL_HASH)
+		ancillaryPoly = MulHash(p, q, range);
+	else ancillaryPoly = MulSchoolbook(p, q);
 	PolyAddTo(&result, &ancillaryPoly);
+	mulDepth--;
+	TraceEnd();
 	return result;
 }
 
-Poly PolyNeg(const Poly *p) {
+bool PolyMulChecked(const Poly *p, const Poly *q, Poly *result) {
+	unsigned depthP = PolyDepth(p);
+	unsigned depthQ = PolyDepth(q);
+	unsigned depth = depthP > depthQ ? depthP : depthQ;
+	bool exact;
+	if (depth <= SHALLOW_MAX_DEPTH) {
+		TraceBegin("PolyMulChecked.shallow", "depth", (long)depth);
+		bool done = ShallowMul(p, q, depth, result, &exact);
+		TraceEnd();
+		if (done)
+			return exact;
+	}
+	TraceBegin("PolyMulChecked.packed", "depth", (long)depth);
+	PackedPoly packedP = PackedFromPoly(p);
+	PackedPoly packedQ = PackedFromPoly(q);
+	PackedPoly product = PackedMulChecked(&packedP, &packedQ, &exact);
+	*result = PackedToPoly(&product);
+	PackedDestroy(&packedP);
+	PackedDestroy(&packedQ);
+	PackedDestroy(&product);
+	TraceEnd();
+	return exact;
+}
+
+/**
+ * Liczy @ref PolyNeg w bieżącym obszarze pamięci wątku.
+ */
+static Poly Neg(const Poly *p) {
+	size_t length = DenseLength(p);
+	if (length > 0) {
+		ScratchMark mark = ScratchSave();
+		uint64_t *coefs = ToDense(p, length);
+		DenseScale(coefs, length, (uint64_t)-1);
+		Poly result = FromDense(coefs, length);
+		ScratchRestore(mark);
+		return result;
+	}
 	Poly result = PolyClone(p);
 	MultiplyPolyByNumber(&result, -1);
 	return result;
 }
 
-Poly PolySub(const Poly *p, const Poly *q) {
+/**
+ * Liczy @ref PolySub w bieżącym obszarze pamięci wątku.
+ */
+static Poly Sub(const Poly *p, const Poly *q) {
+	size_t lengthP = DenseLength(p);
+	size_t lengthQ = DenseLength(q);
+	if (lengthP > 0 && lengthQ > 0) {
+		size_t length = lengthP > lengthQ ? lengthP : lengthQ;
+		ScratchMark mark = ScratchSave();
+		uint64_t *coefs = ToDense(p, length);
+		uint64_t *coefsQ = ToDense(q, lengthQ);
+		DenseSub(coefs, coefsQ, lengthQ);
+		Poly result = FromDense(coefs, length);
+		ScratchRestore(mark);
+		return result;
+	}
 	Poly neg = PolyNeg(q);
 	Poly result = PolyAdd(&neg, p);
 	PolyDestroy(&neg);
@@ -382,105 +914,859 @@ bool PolyIsEq(const Poly *p, const Poly *q) {
 }
 
 /**
- * Przemnaża  współczynnik przez bazę różnicę współczynników razy
- * @param[in] x : współczynnik do przemnożenia
- * @param[in] base : przez jaką liczbę współczynnik będzie przemnażany
- * @param[in] exp_now : obecna potęga współczynnika 
- * @param[in] exp_want : porządana potęga współczynnika  
+ * Mnoży dwie liczby modulo liczba pierwsza albo modulo 2^64.
+ * @param[in] a : liczba mniejsza od @p prime
+ * @param[in] b : liczba mniejsza od @p prime
+ * @param[in] prime : liczba pierwsza lub 0, które oznacza 2^64
+ * @return `a * b mod prime`
+ */
+static inline uint64_t MulMod(uint64_t a, uint64_t b, uint64_t prime) {
+	return prime == 0 ? a * b : (uint64_t)((unsigned __int128)a * b % prime);
+}
+
+/**
+ * Podnosi liczbę do potęgi modulo liczba pierwsza albo modulo 2^64.
+ * @param[in] base : podstawa mniejsza od @p prime
+ * @param[in] e : wykładnik
+ * @param[in] prime : liczba pierwsza lub 0, które oznacza 2^64
+ * @return `base^e mod prime`
+ */
+static uint64_t PowMod(uint64_t base, uint64_t e, uint64_t prime) {
+	uint64_t result = 1;
+	for (; e > 0 ; e >>= 1, base = MulMod(base, base, prime))
+		if (e & 1)
+			result = MulMod(result, base, prime);
+	return result;
+}
+
+/**
+ * Funkcja dokładająca do wartości wielomianu współczynnik jednomianu
+ * pomnożony przez potęgę podstawianej liczby.
+ */
+typedef void (*PowerVisit)(const Poly *coef, uint64_t power, void *data);
+
+/**
+ * Podstawia liczbę za pierwszą zmienną: przegląda jednomiany wielomianu
+ * i woła @p visit dla współczynnika każdego z nich i potęgi @p x o jego
+ * wykładniku. Wykładniki rosną, więc kolejna potęga jest poprzednią
+ * pomnożoną przez @p x do różnicy wykładników. Wspólne dla @ref PolyAt
+ * (modulo 2^64) i wartości modulo liczba pierwsza w @ref PolyProbablyEq.
+ * @param[in] p : wielomian
+ * @param[in] x : podstawiana liczba
+ * @param[in] prime : liczba pierwsza lub 0, które oznacza 2^64
+ * @param[in] visit : funkcja dokładająca jednomian do wyniku
+ * @param[in] data : wynik przekazywany @p visit
+ */
+static void WalkPowers(const Poly *p, uint64_t x, uint64_t prime, PowerVisit visit, void *data) {
+	uint64_t power = 1;
+	poly_exp_t exp = 0;
+	for (List *l = p->monos ; l != NULL ; l = l->next) {
+		power = MulMod(power, PowMod(x, (uint64_t)(l->value.exp - exp), prime), prime);
+		exp = l->value.exp;
+		visit(&(l->value.p), power, data);
+	}
+}
+
+/**
+ * Dokłada do wyniku @ref PolyAt współczynnik jednomianu razy potęgę.
+ * @param[in] coef : współczynnik jednomianu
+ * @param[in] power : potęga podstawianej liczby modulo 2^64
+ * @param[in,out] data : wynik, wielomian
  */
-void GetCoeff(poly_coeff_t *x, poly_coeff_t base, poly_exp_t *exp_now, poly_exp_t exp_want) {
-	while (*exp_now < exp_want) {
-		*x = *x * base;
-		*exp_now = *exp_now + 1;
+static void AtVisit(const Poly *coef, uint64_t power, void *data) {
+	Poly *result = (Poly *)data;
+	Poly a = PolyClone(coef);
+	MultiplyPolyByNumber(&a, (poly_coeff_t)power);
+	if (PolyIsCoeff(&a))
+		result->coef += a.coef;
+	else {
+		Poly ancillary = *result;
+		*result = PolyAdd(result, &a);
+		PolyDestroy(&ancillary);
+		PolyDestroy(&a);
 	}
 }
 
-Poly PolyAt(const Poly *p, poly_coeff_t x) {
-	Poly result = PolyFromCoeff(p->coef);
-	poly_coeff_t mul = 1;
-	poly_exp_t exp_now = 0;
-	List *list = p->monos;
-	while (list != NULL) {
-		Poly a = PolyClone(&(list->value.p));
-		GetCoeff(&mul, x, &exp_now, list->value.exp);
-		MultiplyPolyByNumber(&a, mul);
-		if (PolyIsCoeff(&a)) { 
-			result.coef += a.coef;
+/**
+ * Liczy PolyAt dla @ref Cached.
+ * @param[in] operands : wielomian
+ * @param[in] count : liczba wielomianów, 1
+ * @param[in] arg : wartość argumentu
+ * @return wartość wielomianu
+ */
+static Poly ComputeAt(const Poly operands[], unsigned count, poly_coeff_t arg) {
+	(void)count;
+	return PolyAt(&(operands[0]), arg);
+}
+
+/**
+ * Liczy @ref PolyAt w bieżącym obszarze pamięci wątku.
+ */
+static Poly At(const Poly *p, poly_coeff_t x) {
+	if (CacheActive() && cacheDepth == 0)
+		return Cached(CACHE_AT, p, 1, x, ComputeAt);
+	size_t length = DenseLength(p);
+	if (length > 0) {
+		ScratchMark mark = ScratchSave();
+		uint64_t *coefs = ToDense(p, length);
+		poly_coeff_t value = (poly_coeff_t)DenseHorner(coefs, length, (uint64_t)x);
+		ScratchRestore(mark);
+		return PolyFromCoeff(value);
+	}
+	Poly result;
+	unsigned depth = PolyDepth(p);
+	if (depth <= SHALLOW_MAX_DEPTH && ShallowAt(p, x, depth, &result))
+		return result;
+	result = PolyFromCoeff(p->coef);
+	WalkPowers(p, (uint64_t)x, 0, AtVisit, &result);
+	return result;
+}
+
+void PolyMultiAt(const Poly *p, size_t count, const poly_coeff_t x[], Poly values[]) {
+	size_t terms = 1;
+	poly_exp_t degree = 0;
+	bool univariate = true;
+	for (List *l = p->monos ; l != NULL && univariate ; l = l->next) {
+		univariate = PolyIsCoeff(&(l->value.p));
+		degree = l->value.exp;
+		terms++;
+	}
+	size_t length = (size_t)degree + 1;
+	if (!univariate || length > (terms + count) * DENSE_RATIO) {
+		for (size_t i = 0 ; i < count ; i++)
+			values[i] = PolyAt(p, x[i]);
+		return;
+	}
+	TraceBegin("PolyMultiAt", "count", (long)count);
+	ScratchMark mark = ScratchSave();
+	uint64_t *coefs = ToDense(p, length);
+	uint64_t *result = (uint64_t *)ScratchAlloc(count * sizeof(uint64_t));
+	DenseMultiEval(result, coefs, length, (const uint64_t *)x, count);
+	for (size_t i = 0 ; i < count ; i++)
+		values[i] = PolyFromCoeff((poly_coeff_t)result[i]);
+	ScratchRestore(mark);
+	TraceEnd();
+}
+
+/** Stan generatora punktów dla PolyProbablyEq, osobny w każdym wątku */
+static _Thread_local uint64_t probableState = 0;
+
+/** Czy generator punktów bieżącego wątku ma już ziarno */
+static _Thread_local bool probableSeeded = false;
+
+void PolyProbableSeed(uint64_t seed) {
+	probableState = seed;
+	probableSeeded = true;
+}
+
+/**
+ * Bierze ziarno generatora punktów bieżącego wątku z @ref PROBABLE_ENTROPY,
+ * a gdy się nie da, z zegara, numeru procesu i adresu stanu wątku.
+ */
+static void ProbableSeedFromEntropy(void) {
+	uint64_t seed = 0;
+	FILE *source = fopen(PROBABLE_ENTROPY, "rb");
+	bool read = source != NULL && fread(&seed, sizeof(seed), 1, source) == 1;
+	if (source != NULL)
+		fclose(source);
+	if (!read)
+		seed = StatsNow() ^ ((uint64_t)getpid() << 32) ^ (uint64_t)(uintptr_t)&probableState;
+	PolyProbableSeed(seed);
+}
+
+/**
+ * Losuje kolejną liczbę generatorem splitmix64. Przy pierwszym losowaniu
+ * w wątku bez @ref PolyProbableSeed bierze ziarno ze źródła entropii.
+ * @return liczba losowa
+ */
+static uint64_t ProbableRandom(void) {
+	if (!probableSeeded)
+		ProbableSeedFromEntropy();
+	uint64_t z = (probableState += 0x9e3779b97f4a7c15);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+	return z ^ (z >> 31);
+}
+
+/**
+ * Wartość wielomianu liczona modulo liczba pierwsza przez @ref WalkPowers.
+ */
+typedef struct ModularValue {
+	const uint64_t *points; ///<wartości kolejnych zmiennych, od podstawianej
+	uint64_t prime; ///<liczba pierwsza
+	uint64_t value; ///<dotychczasowa wartość
+} ModularValue;
+
+static uint64_t AtMod(const Poly *p, const uint64_t points[], uint64_t prime);
+
+/**
+ * Dokłada do wartości modulo liczba pierwsza wartość współczynnika
+ * jednomianu w pozostałych zmiennych razy potęgę.
+ * @param[in] coef : współczynnik jednomianu
+ * @param[in] power : potęga podstawianej liczby modulo liczba pierwsza
+ * @param[in,out] data : wartość, @ref ModularValue
+ */
+static void AtModVisit(const Poly *coef, uint64_t power, void *data) {
+	ModularValue *v = (ModularValue *)data;
+	v->value = (v->value + MulMod(AtMod(coef, v->points + 1, v->prime), power, v->prime)) % v->prime;
+}
+
+/**
+ * Liczy wartość wielomianu modulo liczba pierwsza, podstawiając za zmienną
+ * x_i wartość @p points[i] tym samym przeglądem @ref WalkPowers co PolyAt;
+ * zamiast budować wielomian pozostałych zmiennych od razu liczy jego wartość.
+ * @param[in] p : wielomian
+ * @param[in] points : wartości zmiennych, co najmniej PolyDepth(p) + 1 miejsc
+ * @param[in] prime : liczba pierwsza
+ * @return wartość wielomianu
+ */
+static uint64_t AtMod(const Poly *p, const uint64_t points[], uint64_t prime) {
+	int64_t coef = p->coef % (int64_t)prime;
+	ModularValue v = {.points = points, .prime = prime,
+			.value = coef < 0 ? (uint64_t)(coef + (int64_t)prime) : (uint64_t)coef};
+	WalkPowers(p, points[0], prime, AtModVisit, &v);
+	return v.value;
+}
+
+bool PolyProbablyEq(const Poly *p, const Poly *q, unsigned k) {
+	static const uint64_t primes[] = {PROBABLE_PRIME_LOW, PROBABLE_PRIME_HIGH};
+	unsigned depthP = PolyDepth(p), depthQ = PolyDepth(q);
+	unsigned depth = depthP > depthQ ? depthP : depthQ;
+	ScratchMark mark = ScratchSave();
+	uint64_t *points = (uint64_t *)ScratchAlloc(((size_t)depth + 1) * sizeof(uint64_t));
+	bool equal = true;
+	for (unsigned i = 0 ; equal && i < k ; i++)
+		for (unsigned j = 0 ; equal && j < sizeof(primes) / sizeof(primes[0]) ; j++) {
+			for (unsigned d = 0 ; d < depth ; d++)
+				points[d] = ProbableRandom() % primes[j];
+			equal = AtMod(p, points, primes[j]) == AtMod(q, points, primes[j]);
 		}
-		else { 
-			Poly ancillary = result;
-			result = PolyAdd(&result, &a);
-			PolyDestroy(&ancillary);
-			PolyDestroy(&a);
+	ScratchRestore(mark);
+	return equal;
+}
+
+/**
+ * Liczy @ref PolySqr w bieżącym obszarze pamięci wątku.
+ */
+static Poly Sqr(const Poly *p) {
+	if (PolyIsCoeff(p))
+		return PolyFromCoeff(p->coef * p->coef);
+	size_t length = DenseLength(p);
+	if (length > 0) {
+		TraceBegin("PolySqr.dense", "length", (long)(2 * length - 1));
+		ScratchMark mark = ScratchSave();
+		uint64_t *coefsP = ToDense(p, length);
+		uint64_t *coefs = (uint64_t *)ScratchAlloc((2 * length - 1) * sizeof(uint64_t));
+		DenseSqr(coefs, coefsP, length);
+		Poly result = FromDense(coefs, 2 * length - 1);
+		ScratchRestore(mark);
+		TraceEnd();
+		return result;
+	}
+	TraceBegin("PolySqr", "depth", mulDepth++);
+	unsigned count = Length(p->monos);
+	PolyBuilder builder = PolyBuilderNew(count * (count + 1) / 2);
+	Poly result = PolyZero();
+	if (p->coef != 0) {
+		PolyMulOnlyCoef(p, 2 * p->coef, &result);
+		AddCoeff(&result, -(p->coef * p->coef));
+	}
+	for (List *listI = p->monos ; listI != NULL && !BudgetCheck(0, 0) ; listI = listI->next) {
+		Poly square = PolySqr(&(listI->value.p));
+		Mono mono = MonoFromPoly(&square, 2 * listI->value.exp);
+		PolyBuilderPush(&builder, &mono);
+		for (List *listJ = listI->next ; listJ != NULL ; listJ = listJ->next) {
+			Poly product = PolyMul(&(listI->value.p), &(listJ->value.p));
+			MultiplyPolyByNumber(&product, 2);
+			mono = MonoFromPoly(&product, listI->value.exp + listJ->value.exp);
+			PolyBuilderPush(&builder, &mono);
+		}
+	}
+	Poly ancillaryPoly = PolyBuilderFinish(&builder);
+	PolyAddTo(&result, &ancillaryPoly);
+	mulDepth--;
+	TraceEnd();
+	return result;
+}
+
+/**
+ * Podnosi liczbę do potęgi modulo 2^64.
+ * @param[in] base : podstawa
+ * @param[in] e : wykładnik
+ * @return `base^e`
+ */
+static poly_coeff_t CoeffExp(poly_coeff_t base, poly_exp_t e) {
+	uint64_t result = 1;
+	uint64_t square = (uint64_t)base;
+	for ( ; e > 0 ; e /= 2) {
+		if (e % 2 == 1)
+			result *= square;
+		square *= square;
+	}
+	return (poly_coeff_t)result;
+}
+
+/**
+ * Wyznacza odwrotność liczby nieparzystej modulo 2^64 metodą Newtona.
+ * @param[in] a : liczba nieparzysta
+ * @return `a^-1`
+ */
+static uint64_t OddInverse(uint64_t a) {
+	uint64_t result = a;
+	for (int i = 0 ; i < 5 ; i++)
+		result *= 2 - a * result;
+	return result;
+}
+
+/**
+ * Współczynnik dwumianowy modulo 2^64, zapisany jako część nieparzysta
+ * razy potęga dwójki, tak by dało się go dzielić.
+ */
+typedef struct Binomial {
+	uint64_t odd; ///<część nieparzysta
+	unsigned twos; ///<wykładnik potęgi dwójki
+} Binomial;
+
+/**
+ * Mnoży lub dzieli współczynnik dwumianowy przez dodatnią liczbę.
+ * @param[in] b : współczynnik
+ * @param[in] factor : liczba
+ * @param[in] divide : czy dzielić
+ */
+static void BinomialUpdate(Binomial *b, uint64_t factor, bool divide) {
+	unsigned twos = 0;
+	while (factor % 2 == 0) {
+		factor /= 2;
+		twos++;
+	}
+	if (divide) {
+		b->odd *= OddInverse(factor);
+		b->twos -= twos;
+	}
+	else {
+		b->odd *= factor;
+		b->twos += twos;
+	}
+}
+
+/**
+ * Podnosi dwumian `a x^ea + b x^eb`, gdzie `ea < eb`, do potęgi
+ * ze wzoru Newtona.
+ * @param[in] a : współczynnik pierwszego wyrazu
+ * @param[in] ea : wykładnik pierwszego wyrazu
+ * @param[in] b : współczynnik drugiego wyrazu
+ * @param[in] eb : wykładnik drugiego wyrazu
+ * @param[in] e : wykładnik potęgi, dodatni
+ * @return `(a x^ea + b x^eb)^e`
+ */
+static Poly BinomialExp(const Poly *a, poly_exp_t ea, const Poly *b, poly_exp_t eb, poly_exp_t e) {
+	ScratchMark mark = ScratchSave();
+	Poly *powersA = (Poly *)ScratchAlloc(((size_t)e + 1) * sizeof(Poly));
+	powersA[0] = PolyFromCoeff(1);
+	for (poly_exp_t i = 1 ; i <= e ; i++)
+		powersA[i] = PolyMul(&(powersA[i - 1]), a);
+	PolyBuilder builder = PolyBuilderNew((unsigned)e + 1);
+	Poly powerB = PolyFromCoeff(1);
+	Binomial binomial = {.odd = 1, .twos = 0};
+	for (poly_exp_t i = 0 ; i <= e ; i++) {
+		Poly term = PolyMul(&(powersA[e - i]), &powerB);
+		PolyDestroy(&(powersA[e - i]));
+		MultiplyPolyByNumber(&term, binomial.twos >= 64 ? 0 : (poly_coeff_t)(binomial.odd << binomial.twos));
+		Mono mono = MonoFromPoly(&term, ea * (e - i) + eb * i);
+		PolyBuilderPush(&builder, &mono);
+		if (i < e) {
+			Poly next = PolyMul(&powerB, b);
+			PolyDestroy(&powerB);
+			powerB = next;
+			BinomialUpdate(&binomial, (uint64_t)(e - i), false);
+			BinomialUpdate(&binomial, (uint64_t)(i + 1), true);
 		}
-		list = list->next;
 	}
-	return result;	
+	PolyDestroy(&powerB);
+	Poly result = PolyBuilderFinish(&builder);
+	ScratchRestore(mark);
+	return result;
 }
 
 /**
- *Podnosi zadany wielomian do potęgi. Używa szybkiego potęgowania
+ * Sprawdza, czy potęga współczynnika dwumianu nie zeruje się modulo 2^64.
+ * Wtedy rozwinięcie dwumianu ma około @p e wyrazów i opłaca się je liczyć
+ * wprost.
+ * @param[in] p : współczynnik
+ * @param[in] e : wykładnik
+ * @return czy @p p nie jest stałą o zerowej potędze `p^e`
+ */
+static bool PowerNonZero(const Poly *p, poly_exp_t e) {
+	return !PolyIsCoeff(p) || CoeffExp(p->coef, e) != 0;
+}
+
+/**
+ *Podnosi zadany wielomian do potęgi. Jednomiany i dwumiany są potęgowane
+ *wprost, pozostałe wielomiany iteracyjnym szybkim potęgowaniem od
+ *najstarszego bitu wykładnika, z podnoszeniem do kwadratu przez @ref PolySqr.
  *@param[in] p : wielomiany, który będzie podniesiony do potęgi
  *@param[in] e : wykładnik
  *@return wielomian podniesiony do potęgi
  */
-Poly PolyExp(const Poly *p, poly_exp_t e) {
-	Poly result = PolyFromCoeff(1);
+static Poly Exp(const Poly *p, poly_exp_t e) {
 	if (e == 0)
-		return result;
+		return PolyFromCoeff(1);
 	if (e == 1)
 		return PolyClone(p);
-	Poly tmp = PolyMul(p, p);
-	result = PolyExp(&tmp, e/2);
-	PolyDestroy(&tmp);
-	if (e % 2 == 1) {
-		tmp = PolyMul(&result, p);
+	if (PolyIsCoeff(p))
+		return PolyFromCoeff(CoeffExp(p->coef, e));
+	List *first = p->monos;
+	List *second = first->next;
+	if (p->coef == 0 && second == NULL) {
+		PolyBuilder builder = PolyBuilderNew(1);
+		Poly power = PolyExp(&(first->value.p), e);
+		Mono mono = MonoFromPoly(&power, first->value.exp * e);
+		PolyBuilderPush(&builder, &mono);
+		return PolyBuilderFinish(&builder);
+	}
+	Poly coef = PolyFromCoeff(p->coef);
+	if (p->coef != 0 && second == NULL && first->value.exp != 0
+			&& PowerNonZero(&coef, e) && PowerNonZero(&(first->value.p), e))
+		return BinomialExp(&coef, 0, &(first->value.p), first->value.exp, e);
+	if (p->coef == 0 && second != NULL && second->next == NULL
+			&& PowerNonZero(&(first->value.p), e) && PowerNonZero(&(second->value.p), e))
+		return BinomialExp(&(first->value.p), first->value.exp, &(second->value.p), second->value.exp, e);
+	poly_exp_t mask = 1;
+	while (mask <= e / 2)
+		mask *= 2;
+	Poly result = PolyClone(p);
+	for (mask /= 2 ; mask > 0 && !BudgetCheck(0, 0) ; mask /= 2) {
+		Poly tmp = PolySqr(&result);
+		PolyDestroy(&result);
+		result = tmp;
+		if (e & mask) {
+			tmp = PolyMul(&result, p);
+			PolyDestroy(&result);
+			result = tmp;
+		}
+	}
+	return result;
+}
+
+/**
+ * Zwraca najmniejszy stopień jednomianu wielomianu (-1 dla wielomianu
+ * tożsamościowo równego zeru).
+ * @param[in] p : wielomian
+ * @return najmniejszy stopień jednomianu @p p
+ */
+static poly_exp_t LowDeg(const Poly *p) {
+	if (p->coef != 0)
+		return 0;
+	poly_exp_t result = -1;
+	for (List *l = p->monos ; l != NULL && (result < 0 || l->value.exp < result) ; l = l->next) {
+		poly_exp_t low = LowDeg(&(l->value.p));
+		if (low >= 0 && (result < 0 || l->value.exp + low < result))
+			result = l->value.exp + low;
+	}
+	return result;
+}
+
+/**
+ * Kopiuje wielomian bez jednomianów stopnia większego od @p d.
+ * @param[in] p : wielomian
+ * @param[in] d : ograniczenie stopnia
+ * @return obcięta kopia @p p
+ */
+static Poly TruncClone(const Poly *p, poly_exp_t d) {
+	if (d < 0)
+		return PolyZero();
+	PolyBuilder builder = PolyBuilderNew(0);
+	builder.coef = p->coef;
+	for (List *l = p->monos ; l != NULL && l->value.exp <= d ; l = l->next) {
+		Poly coef = TruncClone(&(l->value.p), d - l->value.exp);
+		if (!PolyIsZero(&coef)) {
+			Mono mono = MonoFromPoly(&coef, l->value.exp);
+			PolyBuilderPush(&builder, &mono);
+		}
+	}
+	return PolyBuilderFinish(&builder);
+}
+
+Poly PolyMulTrunc(const Poly *p, const Poly *q, poly_exp_t d) {
+	poly_exp_t degP = PolyDeg(p);
+	poly_exp_t degQ = PolyDeg(q);
+	if (d < 0 || degP < 0 || degQ < 0)
+		return PolyZero();
+	if ((long)degP + degQ <= d)
+		return PolyMul(p, q);
+	size_t lengthP = DenseLength(p);
+	size_t lengthQ = DenseLength(q);
+	if (lengthP > 0 && lengthQ > 0) {
+		if (lengthP > (size_t)d + 1)
+			lengthP = (size_t)d + 1;
+		if (lengthQ > (size_t)d + 1)
+			lengthQ = (size_t)d + 1;
+		TraceBegin("PolyMulTrunc.dense", "length", (long)(lengthP + lengthQ - 1));
+		ScratchMark mark = ScratchSave();
+		uint64_t *coefsP = ToDense(p, lengthP);
+		uint64_t *coefsQ = ToDense(q, lengthQ);
+		uint64_t *coefs = (uint64_t *)ScratchAlloc((lengthP + lengthQ - 1) * sizeof(uint64_t));
+		DenseMul(coefs, coefsP, lengthP, coefsQ, lengthQ);
+		size_t length = lengthP + lengthQ - 1;
+		Poly result = FromDense(coefs, length < (size_t)d + 1 ? length : (size_t)d + 1);
+		ScratchRestore(mark);
+		TraceEnd();
+		return result;
+	}
+	Poly result = PolyFromCoeff((poly_coeff_t)((uint64_t)p->coef * (uint64_t)q->coef));
+	Poly monosP = {.coef = 0, .monos = p->monos};
+	Poly monosQ = {.coef = 0, .monos = q->monos};
+	if (p->coef != 0) {
+		Poly part = TruncClone(&monosQ, d);
+		MultiplyPolyByNumber(&part, p->coef);
+		PolyAddTo(&result, &part);
+	}
+	if (q->coef != 0) {
+		Poly part = TruncClone(&monosP, d);
+		MultiplyPolyByNumber(&part, q->coef);
+		PolyAddTo(&result, &part);
+	}
+	if (p->monos == NULL || q->monos == NULL)
+		return result;
+	TraceBegin("PolyMulTrunc", "degree", d);
+	ScratchMark mark = ScratchSave();
+	unsigned countQ = Length(q->monos);
+	poly_exp_t *lowQ = (poly_exp_t *)ScratchAlloc(countQ * sizeof(poly_exp_t));
+	poly_exp_t *highQ = (poly_exp_t *)ScratchAlloc(countQ * sizeof(poly_exp_t));
+	unsigned j = 0;
+	for (List *listQ = q->monos ; listQ != NULL ; listQ = listQ->next, j++) {
+		lowQ[j] = LowDeg(&(listQ->value.p));
+		highQ[j] = PolyDeg(&(listQ->value.p));
+	}
+	PolyBuilder builder = PolyBuilderNew(0);
+	for (List *listP = p->monos ; listP != NULL && listP->value.exp <= d && !BudgetCheck(0, 0) ; listP = listP->next) {
+		poly_exp_t lowP = LowDeg(&(listP->value.p));
+		poly_exp_t highP = PolyDeg(&(listP->value.p));
+		j = 0;
+		for (List *listQ = q->monos ; listQ != NULL ; listQ = listQ->next, j++) {
+			poly_exp_t exp = listP->value.exp + listQ->value.exp;
+			if (exp > d)
+				break;
+			if (lowP + lowQ[j] > d - exp)
+				continue;
+			Poly product;
+			if (highP == 0 && highQ[j] == 0)
+				product = PolyFromCoeff((poly_coeff_t)((uint64_t)listP->value.p.coef * (uint64_t)listQ->value.p.coef));
+			else if (highP + highQ[j] <= d - exp)
+				product = PolyMul(&(listP->value.p), &(listQ->value.p));
+			else product = PolyMulTrunc(&(listP->value.p), &(listQ->value.p), d - exp);
+			Mono mono = MonoFromPoly(&product, exp);
+			PolyBuilderPush(&builder, &mono);
+		}
+	}
+	Poly products = PolyBuilderFinish(&builder);
+	ScratchRestore(mark);
+	PolyAddTo(&result, &products);
+	TraceEnd();
+	return result;
+}
+
+Poly PolyExpTrunc(const Poly *p, poly_exp_t e, poly_exp_t d) {
+	if (d < 0)
+		return PolyZero();
+	if (e == 0)
+		return PolyFromCoeff(1);
+	poly_exp_t low = LowDeg(p);
+	if (low < 0 || (long)low * e > d)
+		return PolyZero();
+	if ((long)PolyDeg(p) * e <= d)
+		return PolyExp(p, e);
+	TraceBegin("PolyExpTrunc", "exp", e);
+	Poly base = TruncClone(p, d);
+	poly_exp_t mask = 1;
+	while (mask <= e / 2)
+		mask *= 2;
+	Poly result = PolyClone(&base);
+	for (mask /= 2 ; mask > 0 && !BudgetCheck(0, 0) ; mask /= 2) {
+		Poly tmp = PolyMulTrunc(&result, &result, d);
 		PolyDestroy(&result);
 		result = tmp;
+		if (e & mask) {
+			tmp = PolyMulTrunc(&result, &base, d);
+			PolyDestroy(&result);
+			result = tmp;
+		}
+	}
+	PolyDestroy(&base);
+	TraceEnd();
+	return result;
+}
+
+/**
+ * Sprawdza, czy wielomian jest jednomianem o stałym współczynniku, czyli
+ * czy jego potęgi są równie tanie jak mnożenie przez niego.
+ * @param[in] p : wielomian
+ * @return czy @p p jest jednomianem
+ */
+static bool IsMonomial(const Poly *p) {
+	if (PolyIsCoeff(p))
+		return true;
+	return p->coef == 0 && p->monos->next == NULL && IsMonomial(&(p->monos->value.p));
+}
+
+/**
+ * Ostatnio użyte potęgi wielomianu podstawianego za jedną zmienną.
+ */
+typedef struct PowerCache {
+	poly_exp_t exps[POWER_CACHE_SIZE]; ///<wykładniki potęg
+	Poly powers[POWER_CACHE_SIZE]; ///<potęgi
+	unsigned size; ///<liczba zapamiętanych potęg
+	unsigned next; ///<miejsce zastępowane przy braku potęgi
+} PowerCache;
+
+/**
+ * Zwraca potęgę wielomianu, licząc ją tylko wtedy, gdy nie ma jej w pamięci
+ * podręcznej. Wynik jest ważny do następnego wywołania.
+ * @param[in] cache : pamięć podręczna potęg @p x
+ * @param[in] x : wielomian
+ * @param[in] e : wykładnik, dodatni
+ * @return `x^e`
+ */
+static const Poly *CachedPower(PowerCache *cache, const Poly *x, poly_exp_t e) {
+	if (e == 1)
+		return x;
+	for (unsigned i = 0 ; i < cache->size ; i++)
+		if (cache->exps[i] == e)
+			return &(cache->powers[i]);
+	unsigned slot = cache->next;
+	cache->next = (cache->next + 1) % POWER_CACHE_SIZE;
+	if (cache->size < POWER_CACHE_SIZE)
+		cache->size++;
+	else
+		PolyDestroy(&(cache->powers[slot]));
+	TraceBegin("MulCompose.PolyExp", "exp", e);
+	cache->powers[slot] = PolyExp(x, e);
+	TraceEnd();
+	cache->exps[slot] = e;
+	return &(cache->powers[slot]);
+}
+
+/**
+ * Składa jednomiany, których współczynniki są już po podstawieniu, schematem
+ * Hornera od najwyższego wykładnika, mnożąc przez potęgi o wykładnikach
+ * równych różnicom kolejnych wykładników. Współczynniki jednomianów są
+ * przenoszone do wyniku.
+ * @param[in] monos : jednomiany w kolejności rosnących wykładników
+ * @param[in] length : liczba jednomianów
+ * @param[in] x : podstawiany wielomian
+ * @param[in] cache : pamięć podręczna potęg @p x
+ * @return suma jednomianów po podstawieniu @p x
+ */
+static Poly ComposeHorner(List *monos[], unsigned length, const Poly *x, PowerCache *cache) {
+	Poly result = PolyZero();
+	for (unsigned i = length ; i-- > 0 ; ) {
+		PolyAddTo(&result, &(monos[i]->value.p));
+		monos[i]->value.p = PolyZero();
+		poly_exp_t gap = monos[i]->value.exp - (i > 0 ? monos[i - 1]->value.exp : 0);
+		if (gap > 0 && !PolyIsZero(&result)) {
+			Poly tmp = PolyMul(&result, CachedPower(cache, x, gap));
+			PolyDestroy(&result);
+			result = tmp;
+		}
 	}
 	return result;
 }
 
+/**
+ * Składa jednomiany, których współczynniki są już po podstawieniu, licząc
+ * kolejne potęgi @p x od najniższego wykładnika: każda powstaje z poprzedniej
+ * przez pomnożenie przez potęgę o wykładniku równym różnicy wykładników.
+ * @param[in] monos : jednomiany w kolejności rosnących wykładników
+ * @param[in] length : liczba jednomianów
+ * @param[in] x : podstawiany wielomian
+ * @param[in] cache : pamięć podręczna potęg @p x
+ * @return suma jednomianów po podstawieniu @p x
+ */
+static Poly ComposeAscending(List *monos[], unsigned length, const Poly *x, PowerCache *cache) {
+	Poly result = PolyZero();
+	Poly power = PolyFromCoeff(1);
+	poly_exp_t exp = 0;
+	for (unsigned i = 0 ; i < length && !PolyIsZero(&power) ; i++) {
+		if (monos[i]->value.exp > exp) {
+			Poly tmp = PolyMul(&power, CachedPower(cache, x, monos[i]->value.exp - exp));
+			PolyDestroy(&power);
+			power = tmp;
+			exp = monos[i]->value.exp;
+		}
+		Poly tmp = PolyMul(&power, &(monos[i]->value.p));
+		PolyAddTo(&result, &tmp);
+	}
+	PolyDestroy(&power);
+	return result;
+}
+
 /**
  *Podstawia za zmienną o numerze index wartość wielomianu z tablicy o podanym indeksie.
+ *Potęgi jednomianu są liczone wprost. Inne podstawiane wielomiany są
+ *składane schematem Hornera, jeśli wielomian jest gęsty względem tej
+ *zmiennej, a w przeciwnym razie kolejne potęgi są liczone od najniższego
+ *wykładnika.
  *@param[in] p : wielomian do podmienienia (jest usuwany)
  *@param[in] count : liczba zmiennych do podstawienia
  *@param[in] x : wielomiany, które będą podstawiane w miejsca zmiennych
  *@param[in] index : indeks wielomianu do podstawienia
+ *@param[in] caches : pamięci podręczne potęg wielomianów z @p x
  *@return wielomian po podstawieniu
  */
-Poly MulCompose (Poly *p, unsigned count, const Poly x[], unsigned index) {
+static Poly MulCompose (Poly *p, unsigned count, const Poly x[], unsigned index, PowerCache caches[]) {
 	if (PolyIsCoeff(p))
 		return *p;
+	if (BudgetCheck(0, 0)) {
+		PolyDestroy(p);
+		return PolyZero();
+	}
 	if (index >= count) {
-		poly_coeff_t coef = p->coef;
+		poly_coeff_t coef = ConstantTerm(p);
 		PolyDestroy(p);
 		p = NULL;
 		return PolyFromCoeff(coef);
 	}
-	Poly tmp, tmp2;
-	List *monos = p->monos;
-	while (monos != NULL) {
-		tmp = MulCompose(&(monos->value.p), count, x, index + 1);
-		monos->value.p = tmp;
-		monos = monos->next;
-	}
-	Poly result = PolyFromCoeff(p->coef);
-	monos = p->monos;
-	while (monos != NULL) {
-		if (!PolyIsZero(&(monos->value.p))) {
-			tmp = PolyExp(&(x[index]), monos->value.exp);
-			tmp2 = PolyMul(&tmp, &(monos->value.p));
-			PolyAddTo(&result, &tmp2);
-			PolyDestroy(&tmp);
+	unsigned length = Length(p->monos);
+	ScratchMark mark = ScratchSave();
+	List **monos = (List **)ScratchAlloc(length * sizeof(List *));
+	unsigned i = 0;
+	for (List *l = p->monos ; l != NULL ; l = l->next, i++) {
+		Poly composed = MulCompose(&(l->value.p), count, x, index + 1, caches);
+		l->value = MonoFromPoly(&composed, l->value.exp);
+		monos[i] = l;
+	}
+	Poly result = PolyZero();
+	if (IsMonomial(&(x[index]))) {
+		for (i = 0 ; i < length ; i++) {
+			Poly power = PolyExp(&(x[index]), monos[i]->value.exp);
+			Poly tmp = PolyMul(&power, &(monos[i]->value.p));
+			PolyAddTo(&result, &tmp);
+			PolyDestroy(&power);
 		}
-		monos = monos->next;
 	}
+	else if ((size_t)monos[length - 1]->value.exp < (size_t)length * DENSE_RATIO)
+		result = ComposeHorner(monos, length, &(x[index]), &(caches[index]));
+	else
+		result = ComposeAscending(monos, length, &(x[index]), &(caches[index]));
+	ScratchRestore(mark);
+	Poly coef = PolyFromCoeff(p->coef);
+	PolyAddTo(&result, &coef);
 	PolyDestroy(p);
 	return result;
 } 
 
-Poly PolyCompose(const Poly *p, unsigned count, const Poly x[]) {
+size_t PolyNodes(const Poly *p) {
+	size_t result = 0;
+	for (List *l = p->monos ; l != NULL ; l = l->next)
+		result += 1 + PolyNodes(&(l->value.p));
+	return result;
+}
+
+/**
+ * Liczy PolyCompose dla @ref Cached.
+ * @param[in] operands : wielomian i podstawiane wielomiany
+ * @param[in] count : liczba wielomianów
+ * @param[in] arg : nieużywany
+ * @return wielomian po podstawieniu
+ */
+static Poly ComputeCompose(const Poly operands[], unsigned count, poly_coeff_t arg) {
+	(void)arg;
+	return PolyCompose(&(operands[0]), count - 1, operands + 1);
+}
+
+/**
+ * Liczy @ref PolyCompose w bieżącym obszarze pamięci wątku.
+ */
+static Poly Compose(const Poly *p, unsigned count, const Poly x[]) {
+	if (CacheActive() && cacheDepth == 0 && count < UINT_MAX) {
+		ScratchMark mark = ScratchSave();
+		Poly *operands = (Poly *)ScratchAlloc(((size_t)count + 1) * sizeof(Poly));
+		operands[0] = *p;
+		for (unsigned i = 0 ; i < count ; i++)
+			operands[i + 1] = x[i];
+		Poly result = Cached(CACHE_COMPOSE, operands, count + 1, 0, ComputeCompose);
+		ScratchRestore(mark);
+		return result;
+	}
 	Poly result = PolyClone(p);
-	return MulCompose(&result, count, x, 0);
+	ScratchMark mark = ScratchSave();
+	PowerCache *caches = (PowerCache *)ScratchAlloc(((size_t)count + 1) * sizeof(PowerCache));
+	memset(caches, 0, ((size_t)count + 1) * sizeof(PowerCache));
+	result = MulCompose(&result, count, x, 0, caches);
+	for (unsigned i = 0 ; i < count ; i++)
+		for (unsigned j = 0 ; j < caches[i].size ; j++)
+			PolyDestroy(&(caches[i].powers[j]));
+	ScratchRestore(mark);
+	return result;
+}
+
+/**
+ * Kontekst obliczeń.
+ */
+struct PolyContext {
+	MemArena *arena; ///<obszar pamięci kontekstu
+};
+
+PolyContext *PolyContextNew(void) {
+	PolyContext *ctx = (PolyContext *)malloc(sizeof(PolyContext));
+	assert(ctx != NULL);
+	ctx->arena = MemArenaNew();
+	return ctx;
 }
+
+void PolyContextReset(PolyContext *ctx) {
+	MemArenaReset(ctx->arena);
+}
+
+void PolyContextDestroy(PolyContext *ctx) {
+	if (ctx == NULL)
+		return;
+	MemArenaDestroy(ctx->arena);
+	free(ctx);
+}
+
+size_t PolyContextBytes(const PolyContext *ctx) {
+	return MemArenaBytes(ctx->arena);
+}
+
+/**
+ * Definiuje funkcję liczącą w kontekście i jej wersję bez kontekstu, która
+ * woła ją z kontekstem NULL. Z kontekstem węzły są na czas wywołania
+ * przydzielane z obszaru kontekstu, a pamięć podręczna jest wyłączona,
+ * bo nie może przechowywać węzłów, które znikną przy czyszczeniu kontekstu.
+ * Kontekst NULL oznacza bieżący obszar wątku, więc wywołania wewnątrz
+ * obliczeń w kontekście zostają w nim.
+ * @param[in] name : nazwa funkcji bez kontekstu
+ * @param[in] impl : funkcja licząca
+ * @param[in] ctxParams : parametry funkcji z kontekstem
+ * @param[in] params : parametry funkcji bez kontekstu
+ * @param[in] ... : argumenty przekazywane funkcji liczącej
+ */
+#define CONTEXT_VARIANT(name, impl, ctxParams, params, ...) \
+	Poly name##Ctx ctxParams { \
+		if (ctx == NULL) \
+			return impl(__VA_ARGS__); \
+		MemArena *outer = MemArenaSwitch(ctx->arena); \
+		cacheDepth++; \
+		Poly result = impl(__VA_ARGS__); \
+		cacheDepth--; \
+		MemArenaSwitch(outer); \
+		return result; \
+	} \
+	\
+	Poly name params { \
+		return name##Ctx(NULL, __VA_ARGS__); \
+	}
+
+CONTEXT_VARIANT(PolyClone, Clone, (PolyContext *ctx, const Poly *p), (const Poly *p), p)
+CONTEXT_VARIANT(PolyAdd, Add, (PolyContext *ctx, const Poly *p, const Poly *q), (const Poly *p, const Poly *q), p, q)
+CONTEXT_VARIANT(PolyAddMonos, AddMonos, (PolyContext *ctx, unsigned count, const Mono monos[]),
+		(unsigned count, const Mono monos[]), count, monos)
+CONTEXT_VARIANT(PolyMul, Mul, (PolyContext *ctx, const Poly *p, const Poly *q), (const Poly *p, const Poly *q), p, q)
+CONTEXT_VARIANT(PolySqr, Sqr, (PolyContext *ctx, const Poly *p), (const Poly *p), p)
+CONTEXT_VARIANT(PolyNeg, Neg, (PolyContext *ctx, const Poly *p), (const Poly *p), p)
+CONTEXT_VARIANT(PolySub, Sub, (PolyContext *ctx, const Poly *p, const Poly *q), (const Poly *p, const Poly *q), p, q)
+CONTEXT_VARIANT(PolyAt, At, (PolyContext *ctx, const Poly *p, poly_coeff_t x), (const Poly *p, poly_coeff_t x), p, x)
+CONTEXT_VARIANT(PolyExp, Exp, (PolyContext *ctx, const Poly *p, poly_exp_t e), (const Poly *p, poly_exp_t e), p, e)
+CONTEXT_VARIANT(PolyCompose, Compose, (PolyContext *ctx, const Poly *p, unsigned count, const Poly x[]),
+		(const Poly *p, unsigned count, const Poly x[]), p, count, x)
@@ -12,6 +12,8 @@
 #include <stdbool.h>
 #include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
+#include "memory.h"
 #include "utils.h"
 struct Mono;
 /** Typ współczynników wielomianu */
@@ -41,6 +43,7 @@ typedef struct Mono
 {
     Poly p; ///< współczynnik
     poly_exp_t exp; ///< wykładnik
+    unsigned depth; ///< ograniczenie górne głębokości współczynnika plus jeden; 0, jeśli nieznane
 } Mono;
 /**
  *Lista jednokierunkowa, przechowuje monomiany,
@@ -67,6 +70,16 @@ static inline Poly PolyZero() {
     return PolyFromCoeff(0);
 }
 
+/**
+ * Zwraca ograniczenie górne głębokości zagnieżdżenia wielomianu: 0 dla
+ * współczynnika, w przeciwnym razie o jeden więcej niż największa głębokość
+ * współczynników jednomianów. Korzysta z głębokości zapamiętanych
+ * w jednomianach, więc przegląda tylko listę jednomianów @p p.
+ * @param[in] p : wielomian
+ * @return ograniczenie górne głębokości
+ */
+unsigned PolyDepth(const Poly *p);
+
 /**
  * Tworzy jednomian `p * x^e`.
  * Tworzony jednomian przejmuje na własność (kopiuje) wielomian @p p.
@@ -75,7 +88,7 @@ static inline Poly PolyZero() {
  * @return jednomian `p * x^e`
  */
 static inline Mono MonoFromPoly(const Poly *p, poly_exp_t e) {
-    return (Mono) {.p = *p, .exp = e};
+    return (Mono) {.p = *p, .exp = e, .depth = p->monos == NULL ? 1 : PolyDepth(p) + 1};
 }
 
 /**
@@ -123,7 +136,7 @@ Poly PolyClone(const Poly *p);
  * @return skopiowany jednomian
  */
 static inline Mono MonoClone(const Mono *m) {
-    return (Mono) {.p = PolyClone(&(m->p)), .exp = m->exp};
+    return (Mono) {.p = PolyClone(&(m->p)), .exp = m->exp, .depth = m->depth};
 }
 /**
  * Dodaje dwa wielomiany.
@@ -133,6 +146,48 @@ static inline Mono MonoClone(const Mono *m) {
  */
 Poly PolyAdd(const Poly *p, const Poly *q);
 
+/**
+ * Akumulator jednomianów, z których budowany jest wielomian.
+ * Jednomiany mogą przychodzić w dowolnej kolejności; jeśli przychodzą
+ * posortowane po wykładnikach, jak z parsera, budowa jest liniowa,
+ * w przeciwnym razie jednomiany są sortowane pozycyjnie po wykładnikach.
+ * Tablica jednomianów leży w buforze roboczym wątku, więc akumulatory
+ * używane naraz w jednym wątku trzeba kończyć w kolejności odwrotnej do
+ * dodania do nich pierwszego jednomianu.
+ */
+typedef struct PolyBuilder
+{
+	Mono *monos; ///<zebrane jednomiany
+	ScratchMark mark; ///<stan bufora roboczego sprzed przydzielenia tablicy jednomianów
+	unsigned size; ///<liczba zebranych jednomianów
+	unsigned capacity; ///<rozmiar tablicy jednomianów
+	poly_coeff_t coef; ///<suma zebranych jednomianów stałych
+	bool sorted; ///<czy wykładniki zebranych jednomianów są niemalejące
+} PolyBuilder;
+
+/**
+ * Tworzy pusty akumulator jednomianów.
+ * @param[in] capacity : przewidywana liczba jednomianów
+ * @return pusty akumulator
+ */
+static inline PolyBuilder PolyBuilderNew(unsigned capacity) {
+	return (PolyBuilder) {.monos = NULL, .mark = {NULL, 0}, .size = 0, .capacity = capacity, .coef = 0, .sorted = true};
+}
+
+/**
+ * Dodaje jednomian do akumulatora. Przejmuje na własność zawartość jednomianu.
+ * @param[in] builder : akumulator
+ * @param[in] mono : jednomian
+ */
+void PolyBuilderPush(PolyBuilder *builder, const Mono *mono);
+
+/**
+ * Tworzy wielomian będący sumą zebranych jednomianów i zwalnia akumulator.
+ * @param[in] builder : akumulator
+ * @return suma jednomianów
+ */
+Poly PolyBuilderFinish(PolyBuilder *builder);
+
 /**
  * Sumuje listę jednomianów i tworzy z nich wielomian.
  * @param[in] count : liczba jednomianów
@@ -142,13 +197,59 @@ Poly PolyAdd(const Poly *p, const Poly *q);
 Poly PolyAddMonos(unsigned count, const Mono monos[]);
 
 /**
- * Mnoży dwa wielomiany.
+ * Mnoży dwa wielomiany. Po przekroczeniu ograniczeń ustawionych przez
+ * @ref BudgetStart mnożenie, tak jak potęgowanie i podstawianie, kończy się
+ * szybko z wynikiem do odrzucenia.
  * @param[in] p : wielomian
  * @param[in] q : wielomian
  * @return `p * q`
  */
 Poly PolyMul(const Poly *p, const Poly *q);
 
+/**
+ * Sposób, w jaki @ref PolyMul zbiera iloczyny jednomianów na jednym poziomie
+ * rekurencji.
+ */
+typedef enum MulStrategy {
+	MUL_AUTO, ///<wybór na każdym poziomie na podstawie liczby jednomianów, zakresu wykładników i głębokości
+	MUL_SCHOOLBOOK, ///<wszystkie iloczyny są zbierane w tablicy, sortowane i scalane
+	MUL_DENSE, ///<iloczyny są dodawane do tablicy indeksowanej wykładnikiem z zakresu wyniku
+	MUL_HASH ///<iloczyny są dodawane do tablicy mieszającej wykładników
+} MulStrategy;
+
+/**
+ * Ustawia sposób mnożenia dla wszystkich wątków. Wymuszony sposób jest
+ * używany na każdym poziomie rekurencji, z pominięciem mnożenia tablic
+ * współczynników i płytkich wielomianów, więc służy głównie do porównań.
+ * @param[in] strategy : sposób mnożenia
+ */
+void PolyMulSetStrategy(MulStrategy strategy);
+
+/**
+ * Zwraca sposób mnożenia ustawiony przez @ref PolyMulSetStrategy.
+ * @return sposób mnożenia
+ */
+MulStrategy PolyMulGetStrategy(void);
+
+/**
+ * Mnoży dwa wielomiany, sprawdzając, czy współczynniki iloczynu mieszczą się
+ * w @ref poly_coeff_t. Iloczyny jednomianów o równych wykładnikach są
+ * sumowane w 128 bitach i zawężane raz na jednomian wyniku.
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @param[out] result : `p * q` ze współczynnikami modulo 2^64, jak w @ref PolyMul
+ * @return czy wszystkie współczynniki iloczynu są dokładne
+ */
+bool PolyMulChecked(const Poly *p, const Poly *q, Poly *result);
+
+/**
+ * Podnosi wielomian do kwadratu. Iloczyn każdej pary różnych jednomianów
+ * jest liczony raz i podwajany.
+ * @param[in] p : wielomian
+ * @return `p * p`
+ */
+Poly PolySqr(const Poly *p);
+
 /**
  * Zwraca przeciwny wielomian.
  * @param[in] p : wielomian
@@ -192,6 +293,30 @@ poly_exp_t PolyDeg(const Poly *p);
  */
 bool PolyIsEq(const Poly *p, const Poly *q);
 
+/**
+ * Sprawdza probabilistycznie równość dwóch wielomianów, nie porównując ich
+ * wyraz po wyrazie (lemat Schwartza-Zippela). W każdej z @p k prób liczy
+ * wartości obu wielomianów w losowym punkcie modulo dwie duże liczby
+ * pierwsze, tak jak PolyAt podstawia kolejne zmienne. Różne wielomiany
+ * są uznane za równe z prawdopodobieństwem co najwyżej
+ * @f$(d / (2^{61} - 1))^k@f$, gdzie @f$d@f$ to większy ze stopni
+ * @p p i @p q. Równe wielomiany są zawsze uznane za równe.
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @param[in] k : liczba prób
+ * @return `false`, jeśli `p != q`; `true`, jeśli prawdopodobnie `p = q`
+ */
+bool PolyProbablyEq(const Poly *p, const Poly *q, unsigned k);
+
+/**
+ * Ustawia ziarno generatora punktów @ref PolyProbablyEq w bieżącym wątku,
+ * na przykład żeby powtórzyć przebieg testu. Bez tego każdy wątek przy
+ * pierwszym użyciu bierze ziarno z `/dev/urandom` albo, gdy go nie ma,
+ * z zegara i numeru procesu, więc punkty nie dają się przewidzieć.
+ * @param[in] seed : ziarno
+ */
+void PolyProbableSeed(uint64_t seed);
+
 /**
  * Wylicza wartość wielomianu w punkcie @p x.
  * Wstawia pod pierwszą zmienną wielomianu wartość @p x.
@@ -205,6 +330,21 @@ bool PolyIsEq(const Poly *p, const Poly *q);
  */
 Poly PolyAt(const Poly *p, poly_coeff_t x);
 
+/**
+ * Wylicza wartości wielomianu w wielu punktach, tak jak @ref PolyAt
+ * w każdym z nich. Wielomian jednej zmiennej o stałych współczynnikach,
+ * którego stopień nie przekracza wielokrotności liczby wyrazów i punktów,
+ * jest dzielony przez drzewo podiloczynów punktów, co dla n punktów
+ * i stopnia n kosztuje O(M(n) log n) zamiast O(n^2), gdzie M(n) to koszt
+ * mnożenia algorytmem Karatsuby. Pozostałe wielomiany są liczone przez
+ * @ref PolyAt punkt po punkcie.
+ * @param[in] p : wielomian
+ * @param[in] count : liczba punktów
+ * @param[in] x : punkty
+ * @param[out] values : miejsce na @p count wartości @f$p(x_i, x_0, x_1, \ldots)@f$
+ */
+void PolyMultiAt(const Poly *p, size_t count, const poly_coeff_t x[], Poly values[]);
+
 /**
  *Podnosi wielomian do zadanej potęgi
  *@param[in] p : wielomian
@@ -212,6 +352,29 @@ Poly PolyAt(const Poly *p, poly_coeff_t x);
  */
 Poly PolyExp(const Poly *p, poly_exp_t e);
 
+/**
+ * Mnoży dwa wielomiany, pomijając jednomiany iloczynu stopnia większego
+ * od @p d. Iloczyny jednomianów, które na pewno przekroczą ograniczenie,
+ * nie są liczone: stopnie współczynników drugiego czynnika są wyznaczane
+ * raz na poziom rekurencji, a współczynniki, których iloczyn mieści się
+ * w ograniczeniu, są mnożone przez @ref PolyMul.
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @param[in] d : ograniczenie stopnia
+ * @return `p * q` bez jednomianów stopnia większego od @p d
+ */
+Poly PolyMulTrunc(const Poly *p, const Poly *q, poly_exp_t d);
+
+/**
+ * Podnosi wielomian do potęgi, pomijając jednomiany stopnia większego
+ * od @p d, przez podnoszenie do kwadratu z @ref PolyMulTrunc.
+ * @param[in] p : wielomian
+ * @param[in] e : wykładnik
+ * @param[in] d : ograniczenie stopnia
+ * @return `p^e` bez jednomianów stopnia większego od @p d
+ */
+Poly PolyExpTrunc(const Poly *p, poly_exp_t e, poly_exp_t d);
+
 /**
  *Podstawia za i-tą zmienną i-ty wyraz z tablicy wielomianów
  *@param[in] p : wielomian
@@ -220,4 +383,137 @@ Poly PolyExp(const Poly *p, poly_exp_t e);
  *@return wielomian po podstawieniu
  */
 Poly PolyCompose(const Poly *p, unsigned count, const Poly x[]);
+
+/**
+ *Liczy elementy list jednomianów, z których zbudowany jest wielomian
+ *@param[in] p : wielomian
+ *@return liczba elementów; wielomian zajmuje `PolyNodes(p) * sizeof(List)` bajtów
+ */
+size_t PolyNodes(const Poly *p);
+
+/**
+ * Kontekst obliczeń: obszar pamięci, z którego pochodzą węzły wielomianów
+ * liczonych przez funkcje z przyrostkiem `Ctx`. Takich wielomianów nie
+ * niszczy się przez @ref PolyDestroy; zwalnia je naraz @ref PolyContextReset.
+ * Kontekstu używa jeden wątek naraz, a różne wątki mogą liczyć równolegle
+ * we własnych kontekstach. Obliczenia w kontekście omijają pamięć
+ * podręczną wyników. Funkcje bez przyrostka `Ctx` wołają swoje warianty
+ * z kontekstem NULL, który oznacza zwykłą pamięć (albo kontekst, w którym
+ * trwa bieżące obliczenie) i pamięć podręczną wyników.
+ */
+typedef struct PolyContext PolyContext;
+
+/**
+ * Tworzy pusty kontekst.
+ * @return kontekst
+ */
+PolyContext *PolyContextNew(void);
+
+/**
+ * Zwalnia wszystkie wielomiany policzone w kontekście.
+ * @param[in] ctx : kontekst
+ */
+void PolyContextReset(PolyContext *ctx);
+
+/**
+ * Zwalnia kontekst razem z policzonymi w nim wielomianami.
+ * @param[in] ctx : kontekst
+ */
+void PolyContextDestroy(PolyContext *ctx);
+
+/**
+ * Zwraca liczbę bajtów zajętych przez kontekst.
+ * @param[in] ctx : kontekst
+ * @return rozmiar obszaru pamięci kontekstu
+ */
+size_t PolyContextBytes(const PolyContext *ctx);
+
+/**
+ * Robi pełną kopię wielomianu w kontekście.
+ * @param[in] ctx : kontekst
+ * @param[in] p : wielomian
+ * @return skopiowany wielomian
+ */
+Poly PolyCloneCtx(PolyContext *ctx, const Poly *p);
+
+/**
+ * Dodaje dwa wielomiany w kontekście.
+ * @param[in] ctx : kontekst
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @return `p + q`
+ */
+Poly PolyAddCtx(PolyContext *ctx, const Poly *p, const Poly *q);
+
+/**
+ * Sumuje jednomiany w kontekście. Współczynniki jednomianów muszą
+ * pochodzić z tego kontekstu.
+ * @param[in] ctx : kontekst
+ * @param[in] count : liczba jednomianów
+ * @param[in] monos : tablica jednomianów
+ * @return wielomian będący sumą jednomianów
+ */
+Poly PolyAddMonosCtx(PolyContext *ctx, unsigned count, const Mono monos[]);
+
+/**
+ * Mnoży dwa wielomiany w kontekście.
+ * @param[in] ctx : kontekst
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @return `p * q`
+ */
+Poly PolyMulCtx(PolyContext *ctx, const Poly *p, const Poly *q);
+
+/**
+ * Podnosi wielomian do kwadratu w kontekście.
+ * @param[in] ctx : kontekst
+ * @param[in] p : wielomian
+ * @return `p * p`
+ */
+Poly PolySqrCtx(PolyContext *ctx, const Poly *p);
+
+/**
+ * Zwraca przeciwny wielomian policzony w kontekście.
+ * @param[in] ctx : kontekst
+ * @param[in] p : wielomian
+ * @return `-p`
+ */
+Poly PolyNegCtx(PolyContext *ctx, const Poly *p);
+
+/**
+ * Odejmuje wielomian od wielomianu w kontekście.
+ * @param[in] ctx : kontekst
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @return `p - q`
+ */
+Poly PolySubCtx(PolyContext *ctx, const Poly *p, const Poly *q);
+
+/**
+ * Wylicza wartość wielomianu w punkcie @p x w kontekście.
+ * @param[in] ctx : kontekst
+ * @param[in] p : wielomian
+ * @param[in] x : wartość pierwszej zmiennej
+ * @return @f$p(x, x_0, x_1, \ldots)@f$
+ */
+Poly PolyAtCtx(PolyContext *ctx, const Poly *p, poly_coeff_t x);
+
+/**
+ * Podnosi wielomian do potęgi w kontekście.
+ * @param[in] ctx : kontekst
+ * @param[in] p : wielomian
+ * @param[in] e : wykładnik
+ * @return `p^e`
+ */
+Poly PolyExpCtx(PolyContext *ctx, const Poly *p, poly_exp_t e);
+
+/**
+ * Składa wielomiany w kontekście.
+ * @param[in] ctx : kontekst
+ * @param[in] p : wielomian
+ * @param[in] count : liczba zmiennych do podstawienia
+ * @param[in] x : wielomiany podstawiane w miejsca zmiennych
+ * @return wielomian po podstawieniu
+ */
+Poly PolyComposeCtx(PolyContext *ctx, const Poly *p, unsigned count, const Poly x[]);
 #endif /* __POLY_H__ */
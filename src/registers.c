@@ -0,0 +1,108 @@
+/** @file
+  Rejestry kalkulatora w tablicy haszującej z łańcuchowaniem. Wartości są
+  liczone odwołaniami, więc zapisanie wierzchołka stosu w rejestrze
+  i położenie rejestru na stosie nie kopiują wielomianu.
+  @author Aleksandra Grzyb
+  @copyright Uniwersytet Warszawski
+  @date 2017-05-20
+  */
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include "registers.h"
+#include "utils.h"
+#define REGISTER_BUCKETS 64 ///<liczba kubełków tablicy haszującej, potęga dwójki
+
+/**
+ * Rejestr: nazwa i odwołanie do wartości.
+ */
+typedef struct Register {
+	char name[REGISTER_NAME_LENGTH + 1]; ///<nazwa
+	RegisterValue *value; ///<wartość
+	struct Register *next; ///<następny rejestr w kubełku
+} Register;
+
+static Register *buckets[REGISTER_BUCKETS]; ///<kubełki tablicy haszującej
+
+/**
+ * Liczy skrót nazwy (FNV-1a).
+ * @param[in] name : nazwa
+ * @return numer kubełka
+ */
+static unsigned Bucket(const char *name) {
+	uint64_t hash = 14695981039346656037ULL;
+	while (*name != '\0') {
+		hash ^= (unsigned char)*name++;
+		hash *= 1099511628211ULL;
+	}
+	return (unsigned)(hash & (REGISTER_BUCKETS - 1));
+}
+
+/**
+ * Szuka miejsca, w którym jest lub powinien być rejestr o zadanej nazwie.
+ * @param[in] name : nazwa rejestru
+ * @return wskaźnik na dowiązanie do rejestru albo na dowiązanie końcowe kubełka
+ */
+static Register **Find(const char *name) {
+	Register **link = &(buckets[Bucket(name)]);
+	while (*link != NULL && strcmp((*link)->name, name) != 0)
+		link = &((*link)->next);
+	return link;
+}
+
+RegisterValue *RegisterValueNew(Poly value, PackedPoly packed, uint64_t terms) {
+	RegisterValue *v = (RegisterValue *)malloc(sizeof(RegisterValue));
+	assert(v != NULL);
+	v->value = value;
+	v->packed = packed;
+	v->terms = terms;
+	atomic_init(&(v->refs), 1);
+	return v;
+}
+
+void RegisterValueRelease(RegisterValue *v) {
+	if (atomic_fetch_sub_explicit(&(v->refs), 1, memory_order_acq_rel) > 1)
+		return;
+	PolyDestroy(&(v->value));
+	PackedDestroy(&(v->packed));
+	free(v);
+}
+
+void RegisterStore(const char *name, RegisterValue *v) {
+	assert(strlen(name) <= REGISTER_NAME_LENGTH);
+	Register **link = Find(name);
+	if (*link != NULL) {
+		RegisterValueRelease((*link)->value);
+		(*link)->value = v;
+		return;
+	}
+	Register *r = (Register *)malloc(sizeof(Register));
+	assert(r != NULL);
+	strcpy(r->name, name);
+	r->value = v;
+	r->next = NULL;
+	*link = r;
+}
+
+RegisterValue *RegisterFind(const char *name) {
+	Register *r = *Find(name);
+	return r != NULL ? r->value : NULL;
+}
+
+bool RegisterDrop(const char *name) {
+	Register **link = Find(name);
+	Register *r = *link;
+	if (r == NULL)
+		return false;
+	*link = r->next;
+	RegisterValueRelease(r->value);
+	free(r);
+	return true;
+}
+
+void RegisterClear(void) {
+	for (unsigned i = 0 ; i < REGISTER_BUCKETS ; i++)
+		while (buckets[i] != NULL)
+			RegisterDrop(buckets[i]->name);
+}
@@ -0,0 +1,84 @@
+/** @file
+   Interfejs rejestrów kalkulatora: nazwanych wielomianów przechowywanych
+   poza stosem
+
+   @author Aleksandra Grzyb
+   @copyright Uniwersytet Warszawski
+   @date 2017-05-20
+*/
+
+#ifndef __REGISTERS_H__
+#define __REGISTERS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "poly.h"
+#include "packed.h"
+
+#define REGISTER_NAME_LENGTH 32 ///<największa długość nazwy rejestru
+
+/**
+ * Wartość rejestru współdzielona przez rejestry i elementy stosu.
+ * Wielomian jest niszczony, gdy zniknie ostatnie odwołanie.
+ */
+typedef struct RegisterValue {
+	Poly value; ///<wielomian rekurencyjny
+	PackedPoly packed; ///<wielomian w postaci upakowanej, gdy kalkulator liczy na nich
+	uint64_t terms; ///<jednomiany wielomianu na najwyższym poziomie do statystyk lub UINT64_MAX, gdy nie są policzone
+	atomic_ulong refs; ///<liczba rejestrów i elementów stosu odwołujących się do wartości; zmieniana także przez wątki puli w trybie równoległym
+} RegisterValue;
+
+/**
+ * Tworzy wartość rejestru z jednym odwołaniem. Przejmuje na własność wielomiany.
+ * @param[in] value : wielomian rekurencyjny
+ * @param[in] packed : wielomian w postaci upakowanej
+ * @param[in] terms : jednomiany wielomianu na najwyższym poziomie lub UINT64_MAX
+ * @return wartość rejestru
+ */
+RegisterValue *RegisterValueNew(Poly value, PackedPoly packed, uint64_t terms);
+
+/**
+ * Dodaje odwołanie do wartości rejestru.
+ * @param[in] v : wartość rejestru
+ * @return @p v
+ */
+static inline RegisterValue *RegisterValueRetain(RegisterValue *v) {
+	atomic_fetch_add_explicit(&(v->refs), 1, memory_order_relaxed);
+	return v;
+}
+
+/**
+ * Usuwa odwołanie do wartości rejestru, niszcząc ją po usunięciu ostatniego.
+ * @param[in] v : wartość rejestru
+ */
+void RegisterValueRelease(RegisterValue *v);
+
+/**
+ * Zapisuje wartość w rejestrze o zadanej nazwie, zwalniając poprzednią.
+ * Przejmuje odwołanie do wartości.
+ * @param[in] name : nazwa rejestru
+ * @param[in] v : wartość
+ */
+void RegisterStore(const char *name, RegisterValue *v);
+
+/**
+ * Szuka rejestru o zadanej nazwie.
+ * @param[in] name : nazwa rejestru
+ * @return wartość rejestru albo NULL, jeśli rejestru nie ma
+ */
+RegisterValue *RegisterFind(const char *name);
+
+/**
+ * Usuwa rejestr o zadanej nazwie.
+ * @param[in] name : nazwa rejestru
+ * @return czy rejestr istniał
+ */
+bool RegisterDrop(const char *name);
+
+/**
+ * Usuwa wszystkie rejestry.
+ */
+void RegisterClear(void);
+
+#endif /* __REGISTERS_H__ */
@@ -0,0 +1,77 @@
+/** @file
+  Kolejka cykliczna bez blokad dla jednego producenta i jednego konsumenta.
+  Producent publikuje element zapisem indeksu końca z semantyką release,
+  a konsument zwalnia miejsce zapisem indeksu początku; każda strona czyta
+  indeks drugiej z semantyką acquire. Czekający wątek najpierw oddaje
+  procesor, a po dłuższym czekaniu zasypia na krótko, żeby nie zajmować
+  rdzenia, gdy wejście przychodzi powoli.
+  @author Aleksandra Grzyb
+  @copyright Uniwersytet Warszawski
+  @date 2017-05-20
+  */
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <sched.h>
+#include <time.h>
+#include <assert.h>
+#include "ring.h"
+#include "utils.h"
+#define RING_YIELDS 1024 ///<liczba oddań procesora przed pierwszym uśpieniem
+#define RING_SLEEP_NS 50000 ///<długość uśpienia czekającego wątku
+
+void RingInit(Ring *r, size_t capacity) {
+	assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+	r->slots = (void **)malloc(capacity * sizeof(void *));
+	assert(r->slots != NULL);
+	r->mask = capacity - 1;
+	atomic_init(&(r->head), 0);
+	atomic_init(&(r->tail), 0);
+}
+
+void RingDestroy(Ring *r) {
+	free(r->slots);
+	r->slots = NULL;
+}
+
+bool RingTryPush(Ring *r, void *item) {
+	size_t tail = atomic_load_explicit(&(r->tail), memory_order_relaxed);
+	if (tail - atomic_load_explicit(&(r->head), memory_order_acquire) > r->mask)
+		return false;
+	r->slots[tail & r->mask] = item;
+	atomic_store_explicit(&(r->tail), tail + 1, memory_order_release);
+	return true;
+}
+
+bool RingTryPop(Ring *r, void **item) {
+	size_t head = atomic_load_explicit(&(r->head), memory_order_relaxed);
+	if (head == atomic_load_explicit(&(r->tail), memory_order_acquire))
+		return false;
+	*item = r->slots[head & r->mask];
+	atomic_store_explicit(&(r->head), head + 1, memory_order_release);
+	return true;
+}
+
+/**
+ * Czeka chwilę na drugą stronę kolejki.
+ * @param[in] attempt : numer kolejnej nieudanej próby
+ */
+static void Wait(unsigned attempt) {
+	if (attempt < RING_YIELDS)
+		sched_yield();
+	else {
+		struct timespec pause = {0, RING_SLEEP_NS};
+		nanosleep(&pause, NULL);
+	}
+}
+
+void RingPush(Ring *r, void *item) {
+	for (unsigned attempt = 0 ; !RingTryPush(r, item) ; attempt++)
+		Wait(attempt);
+}
+
+void *RingPop(Ring *r) {
+	void *item;
+	for (unsigned attempt = 0 ; !RingTryPop(r, &item) ; attempt++)
+		Wait(attempt);
+	return item;
+}
@@ -0,0 +1,77 @@
+/** @file
+   Interfejs kolejki cyklicznej bez blokad dla jednego producenta
+   i jednego konsumenta
+
+   @author Aleksandra Grzyb
+   @copyright Uniwersytet Warszawski
+   @date 2017-05-20
+*/
+
+#ifndef __RING_H__
+#define __RING_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+
+#define RING_LINE 64 ///<rozmiar linii pamięci podręcznej procesora
+
+/**
+ * Kolejka cykliczna wskaźników. Wolno do niej wkładać z jednego wątku
+ * i wyjmować z jednego, być może innego wątku. Indeksy rosną bez końca,
+ * a miejsce w tablicy wyznacza maska, więc pojemność jest potęgą dwójki.
+ * Indeksy leżą w osobnych liniach pamięci, żeby wątki nie unieważniały
+ * sobie nawzajem pamięci podręcznej.
+ */
+typedef struct Ring {
+	void **slots; ///<miejsca na elementy
+	size_t mask; ///<pojemność minus jeden
+	alignas(RING_LINE) atomic_size_t head; ///<indeks następnego elementu do wyjęcia, zmienia go konsument
+	alignas(RING_LINE) atomic_size_t tail; ///<indeks następnego wolnego miejsca, zmienia go producent
+} Ring;
+
+/**
+ * Tworzy pustą kolejkę.
+ * @param[in] r : kolejka
+ * @param[in] capacity : pojemność, potęga dwójki
+ */
+void RingInit(Ring *r, size_t capacity);
+
+/**
+ * Zwalnia pamięć kolejki. Nie zwalnia elementów, które w niej zostały.
+ * @param[in] r : kolejka
+ */
+void RingDestroy(Ring *r);
+
+/**
+ * Wkłada element do kolejki, jeśli jest w niej miejsce.
+ * @param[in] r : kolejka
+ * @param[in] item : element
+ * @return czy element został włożony
+ */
+bool RingTryPush(Ring *r, void *item);
+
+/**
+ * Wyjmuje element z kolejki, jeśli nie jest pusta.
+ * @param[in] r : kolejka
+ * @param[out] item : wyjęty element
+ * @return czy element został wyjęty
+ */
+bool RingTryPop(Ring *r, void **item);
+
+/**
+ * Wkłada element do kolejki, czekając na wolne miejsce.
+ * @param[in] r : kolejka
+ * @param[in] item : element
+ */
+void RingPush(Ring *r, void *item);
+
+/**
+ * Wyjmuje element z kolejki, czekając, aż się pojawi.
+ * @param[in] r : kolejka
+ * @return wyjęty element
+ */
+void *RingPop(Ring *r);
+
+#endif /* __RING_H__ */
@@ -0,0 +1,389 @@
+/** @file
+  Operacje na płytkich wielomianach bez rekurencji. Wielomian o głębokości
+  co najwyżej N jest rozpisywany na tablicę wyrazów posortowanych po kluczu,
+  w którym wykładniki kolejnych poziomów są upakowane po `63 / N` bitów
+  (x_0 na najstarszych bitach), tak że mnożenie jednomianów to dodawanie
+  kluczy. Funkcje dla N = 1, 2, 3 są generowane makrem @ref SHALLOW_KERNELS,
+  więc pętle po poziomach mają stałą liczbę obrotów, a stos przeglądania
+  ma stały rozmiar. Współczynniki są liczone modulo 2^64; iloczyny o równych
+  kluczach są sumowane w 128 bitach, więc mnożenie wykrywa współczynniki
+  spoza zakresu @ref poly_coeff_t.
+  @author Aleksandra Grzyb
+  @copyright Uniwersytet Warszawski
+  @date 2017-05-20
+  */
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <assert.h>
+#include "shallow.h"
+#include "budget.h"
+#include "memory.h"
+#include "utils.h"
+#define MIN_CAPACITY 16 ///<najmniejsza liczba wyrazów, na które rezerwowane jest miejsce
+#define FIELD_BITS(n) (63 / (n)) ///<liczba bitów klucza na wykładnik poziomu przy n poziomach
+/** Największy wykładnik poziomu przy n poziomach: mieści się w polu klucza i w @ref poly_exp_t */
+#define FIELD_LIMIT(n) (FIELD_BITS(n) >= 31 ? (uint64_t)INT_MAX : ((uint64_t)1 << FIELD_BITS(n)) - 1)
+
+/**
+ * Wyraz wielomianu: upakowane wykładniki i współczynnik.
+ */
+typedef struct Term {
+	uint64_t key; ///<wykładniki poziomów upakowane po @ref FIELD_BITS bitów
+	uint64_t coef; ///<współczynnik modulo 2^64
+} Term;
+
+/**
+ * Rosnąca tablica wyrazów w buforze roboczym wątku; zwalnia ją
+ * @ref ScratchRestore w funkcji, która zaczęła ją wypełniać.
+ */
+typedef struct Terms {
+	Term *items; ///<wyrazy
+	size_t size; ///<liczba wyrazów
+	size_t capacity; ///<rozmiar tablicy
+} Terms;
+
+/**
+ * Element kopca iloczynów: wyraz @p i pierwszego czynnika razy wyraz @p j drugiego.
+ */
+typedef struct HeapEntry {
+	uint64_t key; ///<klucz iloczynu
+	size_t i; ///<numer wyrazu pierwszego czynnika
+	size_t j; ///<numer wyrazu drugiego czynnika
+} HeapEntry;
+
+/**
+ * Dopisuje wyraz o niezerowym współczynniku na koniec tablicy.
+ * @param[in] terms : tablica wyrazów
+ * @param[in] key : klucz
+ * @param[in] coef : współczynnik
+ */
+static inline void Append(Terms *terms, uint64_t key, uint64_t coef) {
+	if (coef == 0)
+		return;
+	if (terms->size == terms->capacity) {
+		size_t capacity = terms->capacity < MIN_CAPACITY ? MIN_CAPACITY : 2 * terms->capacity;
+		terms->items = (Term *)ScratchGrow(terms->items, terms->capacity * sizeof(Term), capacity * sizeof(Term));
+		terms->capacity = capacity;
+	}
+	terms->items[terms->size++] = (Term) {.key = key, .coef = coef};
+}
+
+/**
+ * Tworzy nowy element listy jednomianów z zerowym współczynnikiem.
+ * @param[in] exp : wykładnik
+ * @return element listy
+ */
+static List *NewList(poly_exp_t exp) {
+	List *result = (List *)MemAlloc(sizeof(List));
+	assert(result != NULL);
+	result->next = NULL;
+	result->value.p = PolyZero();
+	result->value.exp = exp;
+	result->value.depth = 1;
+	return result;
+}
+
+/**
+ * Przenosi stałą wielomianu do najgłębszego jednomianu o zerowych
+ * wykładnikach, tak jak w wielomianach budowanych przez @ref PolyAdd.
+ * @param[in] p : wielomian
+ */
+static void MoveCoeff(Poly *p) {
+	poly_coeff_t coef = p->coef;
+	Poly *target = p;
+	while (target->monos != NULL && target->monos->value.exp == 0)
+		target = &(target->monos->value.p);
+	if (target != p) {
+		p->coef = 0;
+		target->coef = (poly_coeff_t)((uint64_t)target->coef + (uint64_t)coef);
+	}
+}
+
+/**
+ * Przesuwa element kopca w dół na właściwe miejsce.
+ * @param[in] heap : kopiec
+ * @param[in] size : rozmiar kopca
+ */
+static void SiftDown(HeapEntry heap[], size_t size) {
+	size_t k = 0;
+	HeapEntry entry = heap[0];
+	while (2 * k + 1 < size) {
+		size_t child = 2 * k + 1;
+		if (child + 1 < size && heap[child + 1].key < heap[child].key)
+			child++;
+		if (heap[child].key >= entry.key)
+			break;
+		heap[k] = heap[child];
+		k = child;
+	}
+	heap[k] = entry;
+}
+
+/**
+ * Mnoży dwie posortowane tablice wyrazów, scalając iloczyny kopcem
+ * rozmiaru krótszej z nich. Iloczyny o równych kluczach są sumowane
+ * w 128 bitach i zawężane raz na wyraz wyniku. Po przekroczeniu ograniczeń
+ * z @ref BudgetCheck przerywa scalanie. Kopiec i wynik są przydzielane
+ * w buforze roboczym i zwalnia je wywołujący.
+ * @param[in] a : wyrazy pierwszego czynnika
+ * @param[in] b : wyrazy drugiego czynnika
+ * @param[out] exact : zerowane, jeśli któryś współczynnik iloczynu
+ * nie mieści się w @ref poly_coeff_t
+ * @return posortowane wyrazy iloczynu o niezerowych współczynnikach
+ */
+static Terms MulTerms(const Terms *a, const Terms *b, bool *exact) {
+	if (a->size > b->size) {
+		const Terms *tmp = a;
+		a = b;
+		b = tmp;
+	}
+	Terms result = {.items = NULL, .size = 0, .capacity = 0};
+	if (a->size == 0)
+		return result;
+	HeapEntry *heap = (HeapEntry *)ScratchAlloc(a->size * sizeof(HeapEntry));
+	size_t size = a->size;
+	for (size_t i = 0 ; i < size ; i++)
+		heap[i] = (HeapEntry) {.key = a->items[i].key + b->items[0].key, .i = i, .j = 0};
+	while (size > 0 && !BudgetCheck(result.size, result.capacity * sizeof(Term))) {
+		uint64_t key = heap[0].key;
+		__int128 coef = 0;
+		bool wide = false;
+		do {
+			HeapEntry *top = &(heap[0]);
+			__int128 product = (__int128)(int64_t)a->items[top->i].coef * (int64_t)b->items[top->j].coef;
+			wide |= __builtin_add_overflow(coef, product, &coef);
+			if (++top->j < b->size)
+				top->key = a->items[top->i].key + b->items[top->j].key;
+			else *top = heap[--size];
+			if (size > 0)
+				SiftDown(heap, size);
+		} while (size > 0 && heap[0].key == key);
+		if (wide || coef != (int64_t)coef)
+			*exact = false;
+		Append(&result, key, (uint64_t)coef);
+	}
+	return result;
+}
+
+/**
+ * Porównuje klucze wyrazów dla qsort.
+ * @param[in] a : wyraz
+ * @param[in] b : wyraz
+ * @return liczba ujemna, zero lub dodatnia, gdy klucz @p a jest mniejszy, równy lub większy
+ */
+static int CompareTerms(const void *a, const void *b) {
+	uint64_t x = ((const Term *)a)->key;
+	uint64_t y = ((const Term *)b)->key;
+	return (x > y) - (x < y);
+}
+
+/**
+ * Sortuje wyrazy po kluczach i sumuje wyrazy o równych kluczach,
+ * usuwając wyrazy o zerowych współczynnikach.
+ * @param[in] terms : wyrazy
+ * @param[in] sort : czy wyrazy trzeba posortować
+ */
+static void Combine(Terms *terms, bool sort) {
+	if (sort)
+		qsort(terms->items, terms->size, sizeof(Term), CompareTerms);
+	size_t size = 0;
+	for (size_t i = 0 ; i < terms->size ; ) {
+		Term term = terms->items[i++];
+		while (i < terms->size && terms->items[i].key == term.key)
+			term.coef += terms->items[i++].coef;
+		if (term.coef != 0)
+			terms->items[size++] = term;
+	}
+	terms->size = size;
+}
+
+/**
+ * Podnosi liczbę do potęgi modulo 2^64.
+ * @param[in] x : podstawa
+ * @param[in] e : wykładnik
+ * @return x^e modulo 2^64
+ */
+static uint64_t Power(uint64_t x, uint64_t e) {
+	uint64_t result = 1;
+	while (e > 0) {
+		if (e & 1)
+			result *= x;
+		x *= x;
+		e >>= 1;
+	}
+	return result;
+}
+
+/**
+ * Generuje funkcje dla wielomianów o głębokości co najwyżej N:
+ * - `Flatten##N` rozpisuje wielomian na posortowane wyrazy, przeglądając
+ *   go w kolejności prefiksowej ze stosem N list; odmawia, jeśli wykładnik
+ *   nie mieści się w polu klucza;
+ * - `Build##N` buduje wielomian w postaci kanonicznej z posortowanych wyrazów
+ *   o różnych kluczach, trzymając otwartą ścieżkę N + 1 wielomianów,
+ *   od poziomu `first` (poziomy wyższe są w kluczach zerowe);
+ * - `Mul##N` mnoży dwa wielomiany, odmawiając, jeśli sumy wykładników
+ *   przekroczyłyby @ref FIELD_LIMIT, i zeruje `exact`, jeśli współczynnik
+ *   iloczynu wychodzi poza zakres;
+ * - `At##N` podstawia liczbę za x_0 i buduje wynik od poziomu 1.
+ * @param N : liczba poziomów
+ */
+#define SHALLOW_KERNELS(N) \
+static bool Flatten##N(const Poly *p, Terms *terms, uint64_t max[]) { \
+	List *cursor[N]; \
+	uint64_t prefix[N + 1]; \
+	unsigned level = 0; \
+	for (unsigned i = 0 ; i < N ; i++) \
+		max[i] = 0; \
+	prefix[0] = 0; \
+	cursor[0] = p->monos; \
+	Append(terms, 0, (uint64_t)p->coef); \
+	while (true) { \
+		List *l = cursor[level]; \
+		if (l == NULL) { \
+			if (level == 0) \
+				return true; \
+			level--; \
+			continue; \
+		} \
+		cursor[level] = l->next; \
+		uint64_t e = (uint64_t)l->value.exp; \
+		if (e > FIELD_LIMIT(N) || (l->value.p.monos != NULL && level + 1 == N)) \
+			return false; \
+		if (e > max[level]) \
+			max[level] = e; \
+		prefix[level + 1] = prefix[level] + (e << (FIELD_BITS(N) * (N - 1 - level))); \
+		Append(terms, prefix[level + 1], (uint64_t)l->value.p.coef); \
+		if (l->value.p.monos != NULL) \
+			cursor[++level] = l->value.p.monos; \
+	} \
+} \
+\
+static Poly Build##N(const Term terms[], size_t count, unsigned first) { \
+	Poly result = PolyZero(); \
+	Poly *node[N + 1]; \
+	List **tail[N + 1]; \
+	List *owner[N + 1] = {NULL}; \
+	unsigned depth[N + 1]; \
+	uint64_t path[N] = {0}; \
+	uint64_t e[N] = {0}; \
+	unsigned open = first; \
+	node[first] = &result; \
+	tail[first] = &(result.monos); \
+	depth[first] = 0; \
+	for (size_t t = 0 ; t <= count ; t++) { \
+		unsigned last = first; \
+		unsigned level = first; \
+		if (t < count) { \
+			for (unsigned i = first ; i < N ; i++) { \
+				e[i] = (terms[t].key >> (FIELD_BITS(N) * (N - 1 - i))) & FIELD_LIMIT(N); \
+				if (e[i] != 0) \
+					last = i + 1; \
+			} \
+			while (level < open && level < last && path[level] == e[level]) \
+				level++; \
+		} \
+		for ( ; open > level ; open--) { \
+			MoveCoeff(node[open]); \
+			owner[open]->value.depth = depth[open] + 1; \
+			if (depth[open - 1] < depth[open] + 1) \
+				depth[open - 1] = depth[open] + 1; \
+		} \
+		if (t == count) \
+			break; \
+		for ( ; open < last ; open++) { \
+			List *l = NewList((poly_exp_t)e[open]); \
+			*tail[open] = l; \
+			tail[open] = &(l->next); \
+			path[open] = e[open]; \
+			owner[open + 1] = l; \
+			node[open + 1] = &(l->value.p); \
+			tail[open + 1] = &(l->value.p.monos); \
+			depth[open + 1] = 0; \
+		} \
+		node[last]->coef = (poly_coeff_t)((uint64_t)node[last]->coef + terms[t].coef); \
+	} \
+	MoveCoeff(&result); \
+	return result; \
+} \
+\
+static bool Mul##N(const Poly *p, const Poly *q, Poly *result, bool *exact) { \
+	ScratchMark mark = ScratchSave(); \
+	Terms a = {.items = NULL, .size = 0, .capacity = 0}; \
+	Terms b = {.items = NULL, .size = 0, .capacity = 0}; \
+	uint64_t maxA[N], maxB[N]; \
+	bool fits = Flatten##N(p, &a, maxA) && Flatten##N(q, &b, maxB); \
+	for (unsigned i = 0 ; fits && i < N ; i++) \
+		fits = maxA[i] + maxB[i] <= FIELD_LIMIT(N); \
+	if (fits) { \
+		Terms product = MulTerms(&a, &b, exact); \
+		*result = Build##N(product.items, product.size, 0); \
+	} \
+	ScratchRestore(mark); \
+	return fits; \
+} \
+\
+static bool At##N(const Poly *p, poly_coeff_t x, Poly *result) { \
+	ScratchMark mark = ScratchSave(); \
+	Terms a = {.items = NULL, .size = 0, .capacity = 0}; \
+	uint64_t max[N]; \
+	if (!Flatten##N(p, &a, max)) { \
+		ScratchRestore(mark); \
+		return false; \
+	} \
+	unsigned shift = FIELD_BITS(N) * (N - 1); \
+	uint64_t low = shift == 0 ? 0 : ((uint64_t)1 << shift) - 1; \
+	uint64_t power = 1; \
+	uint64_t exp = 0; \
+	for (size_t i = 0 ; i < a.size ; i++) { \
+		uint64_t e = a.items[i].key >> shift; \
+		power *= Power((uint64_t)x, e - exp); \
+		exp = e; \
+		a.items[i].key &= low; \
+		a.items[i].coef *= power; \
+	} \
+	Combine(&a, N > 1); \
+	*result = Build##N(a.items, a.size, 1); \
+	ScratchRestore(mark); \
+	return true; \
+}
+
+SHALLOW_KERNELS(1)
+SHALLOW_KERNELS(2)
+SHALLOW_KERNELS(3)
+
+bool ShallowMul(const Poly *p, const Poly *q, unsigned depth, Poly *result, bool *exact) {
+	poly_coeff_t coef;
+	*exact = true;
+	switch (depth) {
+		case 0:
+			*exact = !__builtin_mul_overflow(p->coef, q->coef, &coef);
+			*result = PolyFromCoeff((poly_coeff_t)((uint64_t)p->coef * (uint64_t)q->coef));
+			return true;
+		case 1:
+			return Mul1(p, q, result, exact);
+		case 2:
+			return Mul2(p, q, result, exact);
+		case 3:
+			return Mul3(p, q, result, exact);
+		default:
+			return false;
+	}
+}
+
+bool ShallowAt(const Poly *p, poly_coeff_t x, unsigned depth, Poly *result) {
+	switch (depth) {
+		case 0:
+			*result = PolyFromCoeff(p->coef);
+			return true;
+		case 1:
+			return At1(p, x, result);
+		case 2:
+			return At2(p, x, result);
+		case 3:
+			return At3(p, x, result);
+		default:
+			return false;
+	}
+}
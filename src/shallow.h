@@ -0,0 +1,45 @@
+/** @file
+   Interfejs operacji na płytkich wielomianach, o głębokości zagnieżdżenia
+   co najwyżej @ref SHALLOW_MAX_DEPTH
+
+   @author Aleksandra Grzyb
+   @copyright Uniwersytet Warszawski
+   @date 2017-05-20
+*/
+
+#ifndef __SHALLOW_H__
+#define __SHALLOW_H__
+
+#include <stdbool.h>
+#include "poly.h"
+
+#define SHALLOW_MAX_DEPTH 3 ///<największa głębokość wielomianów obsługiwanych bez rekurencji
+
+/**
+ * Mnoży dwa wielomiany o głębokości co najwyżej @p depth bez rekurencji.
+ * Odmawia, jeśli sumy wykładników nie mieszczą się w upakowanym kluczu.
+ * Współczynniki iloczynu są liczone modulo 2^64, ale sumowane w 128 bitach,
+ * więc wiadomo, czy są dokładne.
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @param[in] depth : ograniczenie głębokości obu czynników, najwyżej @ref SHALLOW_MAX_DEPTH
+ * @param[out] result : `p * q`, jeśli iloczyn został policzony
+ * @param[out] exact : czy wszystkie współczynniki iloczynu mieszczą się
+ * w @ref poly_coeff_t, jeśli iloczyn został policzony
+ * @return czy iloczyn został policzony
+ */
+bool ShallowMul(const Poly *p, const Poly *q, unsigned depth, Poly *result, bool *exact);
+
+/**
+ * Wylicza wartość wielomianu o głębokości co najwyżej @p depth w punkcie
+ * @p x bez rekurencji, tak jak @ref PolyAt. Odmawia, jeśli wykładniki
+ * nie mieszczą się w upakowanym kluczu.
+ * @param[in] p : wielomian
+ * @param[in] x : punkt
+ * @param[in] depth : ograniczenie głębokości wielomianu, najwyżej @ref SHALLOW_MAX_DEPTH
+ * @param[out] result : @f$p(x, x_0, x_1, \ldots)@f$, jeśli wartość została policzona
+ * @return czy wartość została policzona
+ */
+bool ShallowAt(const Poly *p, poly_coeff_t x, unsigned depth, Poly *result);
+
+#endif /* __SHALLOW_H__ */
@@ -0,0 +1,173 @@
+/** @file
+  Plik wymiany kalkulatora. Wielomiany są zapisywane w postaci upakowanej:
+  nagłówek z liczbą wyrazów i układem wykładników, a po nim tablica wyrazów,
+  każdy od początku strony, żeby dało się go odwzorować przez mmap bez
+  kopiowania. Plik rośnie od końca; zwolnione miejsce jest odzyskiwane,
+  gdy było ostatnie w pliku albo gdy plik opustoszeje.
+  @author Aleksandra Grzyb
+  @copyright Uniwersytet Warszawski
+  @date 2017-05-20
+  */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include "spill.h"
+#include "utils.h"
+#define SPILL_DIR "/tmp" ///<katalog pliku wymiany, gdy TMPDIR nie jest ustawione
+#define SPILL_TEMPLATE "/polyspill.XXXXXX" ///<wzorzec nazwy pliku wymiany dla mkstemp
+#define SPILL_PATH_LENGTH 4096 ///<maksymalna długość ścieżki pliku wymiany
+#define SPILL_HEADER 4 ///<liczba słów nagłówka: wyrazy, zmienne, bity, słowa wykładników
+#define SPILL_PAGE 4096 ///<rozmiar strony, gdy system go nie podaje
+
+/**
+ * Miejsce w pliku wymiany.
+ */
+struct SpillHandle {
+	off_t offset; ///<początek w pliku, wielokrotność rozmiaru strony
+	size_t bytes; ///<liczba zapisanych bajtów razem z nagłówkiem
+	void *mapping; ///<odwzorowanie z @ref SpillView lub NULL
+	bool copied; ///<czy odwzorowanie jest kopią wczytaną bez mmap
+};
+
+static int spillFd = -1; ///<deskryptor pliku wymiany lub -1, gdy plik nie istnieje
+static off_t spillEnd = 0; ///<koniec zajętej części pliku
+static size_t spillHandles = 0; ///<liczba zajętych miejsc
+static size_t spillBytes = 0; ///<liczba bajtów w zajętych miejscach
+
+/**
+ * Tworzy plik wymiany i usuwa go z katalogu.
+ * @return true jeśli plik udało się utworzyć
+ */
+static bool SpillOpen(void) {
+	const char *dir = getenv("TMPDIR");
+	if (dir == NULL || *dir == '\0')
+		dir = SPILL_DIR;
+	char path[SPILL_PATH_LENGTH];
+	if (snprintf(path, sizeof(path), "%s%s", dir, SPILL_TEMPLATE) >= (int)sizeof(path))
+		return false;
+	spillFd = mkstemp(path);
+	if (spillFd < 0)
+		return false;
+	unlink(path);
+	return true;
+}
+
+/**
+ * Zwraca rozmiar strony pamięci.
+ * @return liczba bajtów
+ */
+static size_t PageSize(void) {
+	long size = sysconf(_SC_PAGESIZE);
+	return size > 0 ? (size_t)size : SPILL_PAGE;
+}
+
+/**
+ * Zapisuje dane w pliku wymiany od zadanego miejsca.
+ * @param[in] data : dane
+ * @param[in] bytes : liczba bajtów
+ * @param[in] offset : miejsce w pliku
+ * @return true jeśli zapisano wszystkie bajty
+ */
+static bool WriteAll(const void *data, size_t bytes, off_t offset) {
+	const char *ptr = (const char *)data;
+	while (bytes > 0) {
+		ssize_t written = pwrite(spillFd, ptr, bytes, offset);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		ptr += written;
+		bytes -= (size_t)written;
+		offset += written;
+	}
+	return true;
+}
+
+SpillHandle *SpillStore(const PackedPoly *p) {
+	if (spillFd < 0 && !SpillOpen())
+		return NULL;
+	uint64_t header[SPILL_HEADER] = {p->size, p->vars, p->bits, p->words};
+	size_t termBytes = p->size * (p->words + 1) * sizeof(uint64_t);
+	if (!WriteAll(header, sizeof(header), spillEnd)
+			|| !WriteAll(p->terms, termBytes, spillEnd + (off_t)sizeof(header)))
+		return NULL;
+	SpillHandle *h = (SpillHandle *)malloc(sizeof(SpillHandle));
+	assert(h != NULL);
+	h->offset = spillEnd;
+	h->bytes = sizeof(header) + termBytes;
+	h->mapping = NULL;
+	h->copied = false;
+	size_t page = PageSize();
+	spillEnd += (off_t)((h->bytes + page - 1) / page * page);
+	spillHandles++;
+	spillBytes += h->bytes;
+	return h;
+}
+
+PackedPoly SpillView(SpillHandle *h) {
+	if (h->mapping == NULL) {
+		h->mapping = mmap(NULL, h->bytes, PROT_READ, MAP_PRIVATE, spillFd, h->offset);
+		if (h->mapping == MAP_FAILED) {
+			/* Bez odwzorowania czytamy wielomian do zwykłej pamięci. */
+			h->mapping = malloc(h->bytes);
+			assert(h->mapping != NULL);
+			h->copied = true;
+			size_t done = 0;
+			while (done < h->bytes) {
+				ssize_t got = pread(spillFd, (char *)h->mapping + done, h->bytes - done, h->offset + (off_t)done);
+				assert(got > 0 || (got < 0 && errno == EINTR));
+				if (got > 0)
+					done += (size_t)got;
+			}
+		}
+	}
+	uint64_t *words = (uint64_t *)h->mapping;
+	PackedPoly p = PackedZero();
+	p.size = p.capacity = (size_t)words[0];
+	p.vars = (unsigned)words[1];
+	p.bits = (unsigned)words[2];
+	p.words = (unsigned)words[3];
+	p.terms = p.size > 0 ? words + SPILL_HEADER : NULL;
+	return p;
+}
+
+void SpillFree(SpillHandle *h) {
+	if (h == NULL)
+		return;
+	if (h->copied)
+		free(h->mapping);
+	else if (h->mapping != NULL)
+		munmap(h->mapping, h->bytes);
+	size_t page = PageSize();
+	if (h->offset + (off_t)((h->bytes + page - 1) / page * page) == spillEnd)
+		spillEnd = h->offset;
+	spillHandles--;
+	spillBytes -= h->bytes;
+	free(h);
+	if (spillHandles > 0)
+		return;
+	/* Pusty plik zaczynamy od początku; obcięcie tylko oddaje miejsce na dysku. */
+	spillEnd = 0;
+	if (ftruncate(spillFd, 0) != 0)
+		return;
+}
+
+size_t SpillBytes(void) {
+	return spillBytes;
+}
+
+void SpillStop(void) {
+	assert(spillHandles == 0);
+	if (spillFd >= 0)
+		close(spillFd);
+	spillFd = -1;
+	spillEnd = 0;
+}
@@ -0,0 +1,56 @@
+/** @file
+   Interfejs pliku wymiany: wielomianów w postaci upakowanej odłożonych
+   na dysk, żeby zwolnić pamięć
+
+   @author Aleksandra Grzyb
+   @copyright Uniwersytet Warszawski
+   @date 2017-05-20
+*/
+
+#ifndef __SPILL_H__
+#define __SPILL_H__
+
+#include <stddef.h>
+#include "packed.h"
+
+/**
+ * Miejsce w pliku wymiany zajmowane przez jeden wielomian.
+ */
+typedef struct SpillHandle SpillHandle;
+
+/**
+ * Zapisuje wielomian w pliku wymiany. Plik jest tworzony przy pierwszym
+ * zapisie w katalogu ze zmiennej środowiskowej `TMPDIR` albo w `/tmp`
+ * i od razu usuwany z katalogu, więc znika razem z procesem.
+ * @param[in] p : wielomian
+ * @return miejsce w pliku albo NULL, jeśli nie udało się zapisać
+ */
+SpillHandle *SpillStore(const PackedPoly *p);
+
+/**
+ * Odwzorowuje zapisany wielomian w pamięci. Zwrócony wielomian jest tylko
+ * do odczytu i ważny do wywołania @ref SpillFree; nie wolno go niszczyć.
+ * @param[in] h : miejsce w pliku
+ * @return wielomian w postaci upakowanej
+ */
+PackedPoly SpillView(SpillHandle *h);
+
+/**
+ * Zwalnia miejsce w pliku wymiany razem z odwzorowaniem z @ref SpillView.
+ * Gdy plik nie zawiera już żadnego wielomianu, jest obcinany do zera.
+ * @param[in] h : miejsce w pliku lub NULL
+ */
+void SpillFree(SpillHandle *h);
+
+/**
+ * Zwraca liczbę bajtów wielomianów zapisanych w pliku wymiany.
+ * @return liczba bajtów
+ */
+size_t SpillBytes(void);
+
+/**
+ * Zamyka plik wymiany. Wszystkie miejsca muszą być już zwolnione.
+ */
+void SpillStop(void);
+
+#endif /* __SPILL_H__ */
@@ -0,0 +1,91 @@
+/** @file
+  Statystyki wykonania komend kalkulatora.
+  @author Aleksandra Grzyb
+  @copyright Uniwersytet Warszawski
+  @date 2017-05-20
+  */
+#define _POSIX_C_SOURCE 200809L
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <assert.h>
+#include "stats.h"
+#include "utils.h"
+#define SUB_BITS 2 ///<log2(STATS_SUB_BUCKETS)
+#define NS_IN_S 1000000000ULL ///<liczba nanosekund w sekundzie
+#define PERCENT 100 ///<sto procent
+
+/** Statystyki wszystkich komend */
+static CommandStats stats[STATS_COMMANDS];
+
+/** Blokada zapisu statystyk, które w trybie równoległym zapisują wątki puli */
+static atomic_flag lock = ATOMIC_FLAG_INIT;
+
+void StatsReset(void) {
+	memset(stats, 0, sizeof(stats));
+}
+
+uint64_t StatsNow(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * NS_IN_S + (uint64_t)t.tv_nsec;
+}
+
+/**
+ * Wyznacza przedział histogramu dla czasu.
+ * @param[in] ns : czas w nanosekundach
+ * @return numer przedziału
+ */
+static unsigned Bucket(uint64_t ns) {
+	if (ns < STATS_SUB_BUCKETS)
+		return (unsigned)ns;
+	unsigned msb = 63 - (unsigned)__builtin_clzll(ns);
+	unsigned sub = (unsigned)(ns >> (msb - SUB_BITS)) & (STATS_SUB_BUCKETS - 1);
+	unsigned index = (msb - SUB_BITS + 1) * STATS_SUB_BUCKETS + sub;
+	return index < STATS_BUCKETS ? index : STATS_BUCKETS - 1;
+}
+
+/**
+ * Wyznacza największy czas należący do przedziału histogramu.
+ * @param[in] index : numer przedziału
+ * @return górne ograniczenie przedziału w nanosekundach
+ */
+static uint64_t BucketLimit(unsigned index) {
+	if (index < STATS_SUB_BUCKETS)
+		return index;
+	unsigned msb = index / STATS_SUB_BUCKETS - 1 + SUB_BITS;
+	uint64_t sub = index % STATS_SUB_BUCKETS;
+	return ((STATS_SUB_BUCKETS + sub + 1) << (msb - SUB_BITS)) - 1;
+}
+
+void StatsRecord(unsigned index, uint64_t ns, uint64_t termsIn, uint64_t termsOut) {
+	assert(index < STATS_COMMANDS);
+	CommandStats *s = &stats[index];
+	while (atomic_flag_test_and_set_explicit(&lock, memory_order_acquire));
+	s->count++;
+	s->totalNs += ns;
+	if (ns > s->maxNs)
+		s->maxNs = ns;
+	s->termsIn += termsIn;
+	s->termsOut += termsOut;
+	s->buckets[Bucket(ns)]++;
+	atomic_flag_clear_explicit(&lock, memory_order_release);
+}
+
+const CommandStats *StatsGet(unsigned index) {
+	assert(index < STATS_COMMANDS);
+	return &stats[index];
+}
+
+uint64_t StatsPercentile(const CommandStats *stats, unsigned percent) {
+	uint64_t rank = (stats->count * percent + PERCENT - 1) / PERCENT;
+	uint64_t seen = 0;
+	if (rank == 0)
+		rank = 1;
+	for (unsigned i = 0 ; i < STATS_BUCKETS ; i++) {
+		seen += stats->buckets[i];
+		if (seen >= rank)
+			return BucketLimit(i) < stats->maxNs ? BucketLimit(i) : stats->maxNs;
+	}
+	return stats->maxNs;
+}
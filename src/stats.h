@@ -0,0 +1,73 @@
+/** @file
+   Interfejs statystyk wykonania komend kalkulatora
+
+   @author Aleksandra Grzyb
+   @copyright Uniwersytet Warszawski
+   @date 2017-05-20
+*/
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdint.h>
+
+/** Maksymalna liczba rozróżnianych komend */
+#define STATS_COMMANDS 64
+
+/** Liczba podprzedziałów histogramu w każdej potędze dwójki */
+#define STATS_SUB_BUCKETS 4
+
+/** Liczba przedziałów histogramu (czasy do około 2^47 ns) */
+#define STATS_BUCKETS (48 * STATS_SUB_BUCKETS)
+
+/**
+ * Statystyki jednej komendy.
+ * Histogram czasów ma przedziały jak w HDR Histogram: każda potęga dwójki
+ * jest podzielona na @ref STATS_SUB_BUCKETS równych części, więc błąd
+ * względny odczytanego percentyla nie przekracza 25%.
+ */
+typedef struct CommandStats {
+	uint64_t count; ///<liczba wykonań
+	uint64_t totalNs; ///<łączny czas wykonania w nanosekundach
+	uint64_t maxNs; ///<najdłuższe wykonanie w nanosekundach
+	uint64_t termsIn; ///<łączna liczba jednomianów argumentów
+	uint64_t termsOut; ///<łączna liczba jednomianów wyników
+	uint64_t buckets[STATS_BUCKETS]; ///<histogram czasów wykonania
+} CommandStats;
+
+/**
+ * Zeruje wszystkie statystyki.
+ */
+void StatsReset(void);
+
+/**
+ * Zwraca bieżący czas zegara monotonicznego.
+ * @return czas w nanosekundach
+ */
+uint64_t StatsNow(void);
+
+/**
+ * Zapisuje jedno wykonanie komendy.
+ * @param[in] index : numer komendy, mniejszy od @ref STATS_COMMANDS
+ * @param[in] ns : czas wykonania w nanosekundach
+ * @param[in] termsIn : liczba jednomianów argumentów
+ * @param[in] termsOut : liczba jednomianów wyniku
+ */
+void StatsRecord(unsigned index, uint64_t ns, uint64_t termsIn, uint64_t termsOut);
+
+/**
+ * Zwraca statystyki komendy.
+ * @param[in] index : numer komendy
+ * @return statystyki komendy
+ */
+const CommandStats *StatsGet(unsigned index);
+
+/**
+ * Odczytuje percentyl czasu wykonania z histogramu.
+ * @param[in] stats : statystyki komendy
+ * @param[in] percent : percentyl z przedziału [0, 100]
+ * @return górne ograniczenie przedziału zawierającego percentyl w nanosekundach
+ */
+uint64_t StatsPercentile(const CommandStats *stats, unsigned percent);
+
+#endif /* __STATS_H__ */
@@ -0,0 +1,167 @@
+/** @file
+  Zapis przebiegu wykonania w formacie Chrome Trace.
+  Każdy wątek zapisuje zdarzenia do własnego bufora bez synchronizacji;
+  bufory są jednorazowo dopinane bez blokad do globalnej listy, którą
+  @ref TraceStop przegląda po zakończeniu pracy wątków.
+  @author Aleksandra Grzyb
+  @copyright Uniwersytet Warszawski
+  @date 2017-05-20
+  */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <assert.h>
+#include "trace.h"
+#include "stats.h"
+#include "utils.h"
+#define CHUNK_EVENTS 4096 ///<liczba zdarzeń w jednym kawałku bufora
+#define MAX_DEPTH 64 ///<maksymalne zagnieżdżenie przedziałów
+#define MIN_NESTED_NS 1000 ///<najkrótszy zapisywany przedział zagnieżdżony
+#define MAX_EVENT_LENGTH 512 ///<maksymalna długość zapisu jednego zdarzenia
+#define NS_IN_US 1000.0 ///<liczba nanosekund w mikrosekundzie
+
+bool traceEnabled = false;
+
+/**
+ * Zamknięty przedział czasu.
+ */
+typedef struct TraceEvent {
+	const char *name; ///<nazwa przedziału
+	const char *argName; ///<nazwa argumentu
+	long arg; ///<wartość argumentu
+	uint64_t start; ///<początek w nanosekundach
+	uint64_t duration; ///<długość w nanosekundach
+} TraceEvent;
+
+/**
+ * Kawałek bufora zdarzeń.
+ */
+typedef struct TraceChunk {
+	TraceEvent events[CHUNK_EVENTS]; ///<zdarzenia
+	unsigned size; ///<liczba zapisanych zdarzeń
+	struct TraceChunk *next; ///<poprzedni kawałek
+} TraceChunk;
+
+/**
+ * Bufor zdarzeń jednego wątku wraz ze stosem otwartych przedziałów.
+ */
+typedef struct TraceBuffer {
+	unsigned tid; ///<numer wątku w zapisie
+	TraceChunk *chunks; ///<kawałki bufora, od najnowszego
+	TraceEvent open[MAX_DEPTH]; ///<otwarte przedziały
+	unsigned depth; ///<liczba otwartych przedziałów
+	struct TraceBuffer *next; ///<bufor kolejnego wątku
+} TraceBuffer;
+
+/** Bufory wszystkich wątków */
+static _Atomic(TraceBuffer *) buffers = NULL;
+
+/** Ostatnio nadany numer wątku */
+static atomic_uint lastTid = 0;
+
+/** Bufor bieżącego wątku */
+static _Thread_local TraceBuffer *buffer = NULL;
+
+/** Plik wynikowy */
+static FILE *traceFile = NULL;
+
+/** Chwila włączenia zapisu */
+static uint64_t traceStart = 0;
+
+/**
+ * Tworzy bufor bieżącego wątku i dopina go do listy buforów.
+ * @return bufor bieżącego wątku
+ */
+static TraceBuffer *ThreadBuffer(void) {
+	if (buffer == NULL) {
+		buffer = (TraceBuffer *)calloc(1, sizeof(TraceBuffer));
+		assert(buffer != NULL);
+		buffer->tid = atomic_fetch_add(&lastTid, 1) + 1;
+		buffer->next = atomic_load(&buffers);
+		while (!atomic_compare_exchange_weak(&buffers, &(buffer->next), buffer));
+	}
+	return buffer;
+}
+
+bool TraceStart(const char *path) {
+	traceFile = fopen(path, "w");
+	if (traceFile == NULL)
+		return false;
+	traceStart = StatsNow();
+	traceEnabled = true;
+	return true;
+}
+
+void TraceBeginSpan(const char *name, const char *argName, long arg) {
+	TraceBuffer *b = ThreadBuffer();
+	if (b->depth < MAX_DEPTH)
+		b->open[b->depth] = (TraceEvent) {.name = name, .argName = argName, .arg = arg, .start = StatsNow()};
+	b->depth++;
+}
+
+void TraceEndSpan(void) {
+	TraceBuffer *b = ThreadBuffer();
+	assert(b->depth > 0);
+	b->depth--;
+	if (b->depth >= MAX_DEPTH)
+		return;
+	TraceEvent *event = &(b->open[b->depth]);
+	event->duration = StatsNow() - event->start;
+	if (b->depth > 0 && event->duration < MIN_NESTED_NS)
+		return;
+	if (b->chunks == NULL || b->chunks->size == CHUNK_EVENTS) {
+		TraceChunk *chunk = (TraceChunk *)malloc(sizeof(TraceChunk));
+		assert(chunk != NULL);
+		chunk->size = 0;
+		chunk->next = b->chunks;
+		b->chunks = chunk;
+	}
+	b->chunks->events[b->chunks->size++] = *event;
+}
+
+/**
+ * Zapisuje zdarzenia z kawałków bufora, od najstarszego.
+ * @param[in] chunk : najnowszy kawałek
+ * @param[in] tid : numer wątku
+ * @param[in] first : czy nie zapisano jeszcze żadnego zdarzenia
+ * @return czy nadal nie zapisano żadnego zdarzenia
+ */
+static bool WriteChunks(TraceChunk *chunk, unsigned tid, bool first) {
+	if (chunk == NULL)
+		return first;
+	first = WriteChunks(chunk->next, tid, first);
+	char line[MAX_EVENT_LENGTH];
+	for (unsigned i = 0 ; i < chunk->size ; i++) {
+		TraceEvent *e = &(chunk->events[i]);
+		snprintf(line, sizeof(line),
+				"%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%ld,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"%s\":%ld}}",
+				first ? "\n" : ",\n", e->name, (long)getpid(), tid,
+				(e->start - traceStart) / NS_IN_US, e->duration / NS_IN_US, e->argName, e->arg);
+		fputs(line, traceFile);
+		first = false;
+	}
+	free(chunk);
+	return first;
+}
+
+void TraceStop(void) {
+	if (!traceEnabled)
+		return;
+	traceEnabled = false;
+	fputs("{\"traceEvents\":[", traceFile);
+	bool first = true;
+	TraceBuffer *b = atomic_exchange(&buffers, NULL);
+	while (b != NULL) {
+		TraceBuffer *next = b->next;
+		first = WriteChunks(b->chunks, b->tid, first);
+		free(b);
+		b = next;
+	}
+	fputs("\n],\"displayTimeUnit\":\"ns\"}\n", traceFile);
+	fclose(traceFile);
+	traceFile = NULL;
+	buffer = NULL;
+}
@@ -0,0 +1,65 @@
+/** @file
+   Interfejs zapisu przebiegu wykonania w formacie Chrome Trace
+
+   @author Aleksandra Grzyb
+   @copyright Uniwersytet Warszawski
+   @date 2017-05-20
+*/
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdbool.h>
+
+/** Czy zapis przebiegu jest włączony */
+extern bool traceEnabled;
+
+/**
+ * Włącza zapis przebiegu do pliku.
+ * @param[in] path : plik wynikowy
+ * @return true jeśli plik udało się otworzyć, false w przeciwnym razie
+ */
+bool TraceStart(const char *path);
+
+/**
+ * Wyłącza zapis przebiegu i zapisuje zdarzenia wszystkich wątków do pliku
+ * jako JSON Chrome Trace (`chrome://tracing`, Perfetto).
+ * Wolno ją wywołać dopiero, gdy pozostałe wątki skończyły pracę.
+ */
+void TraceStop(void);
+
+/**
+ * Otwiera przedział czasu w bieżącym wątku. Wersja wołana, gdy zapis jest włączony.
+ * @param[in] name : nazwa przedziału, musi żyć do @ref TraceStop
+ * @param[in] argName : nazwa argumentu przedziału, musi żyć do @ref TraceStop
+ * @param[in] arg : wartość argumentu
+ */
+void TraceBeginSpan(const char *name, const char *argName, long arg);
+
+/**
+ * Zamyka ostatnio otwarty przedział w bieżącym wątku.
+ * Wersja wołana, gdy zapis jest włączony.
+ */
+void TraceEndSpan(void);
+
+/**
+ * Otwiera przedział czasu w bieżącym wątku.
+ * Przedziały zagnieżdżone krótsze niż mikrosekunda są pomijane.
+ * @param[in] name : nazwa przedziału, musi żyć do @ref TraceStop
+ * @param[in] argName : nazwa argumentu przedziału, musi żyć do @ref TraceStop
+ * @param[in] arg : wartość argumentu
+ */
+static inline void TraceBegin(const char *name, const char *argName, long arg) {
+	if (traceEnabled)
+		TraceBeginSpan(name, argName, arg);
+}
+
+/**
+ * Zamyka ostatnio otwarty przedział w bieżącym wątku.
+ */
+static inline void TraceEnd(void) {
+	if (traceEnabled)
+		TraceEndSpan();
+}
+
+#endif /* __TRACE_H__ */
@@ -4,10 +4,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <pthread.h>
 #include "cmocka.h"
 #define UTILS_H
 #define MAX_INT_LENGTH 40
+#define MAX_TRACE_LENGTH 4096
 #include "poly.h"
+#include "ring.h"
+#include "memory.h"
+#include "libpoly.h"
+#include "packed.h"
+#include "spill.h"
+#include "budget.h"
 /**
  *Pomocniczy bufor dla fprintf i printf
  */
@@ -24,7 +32,12 @@ static int input_stream_position = 0;
 static int input_stream_end = 0;
 int read_char_count = 0;
 
-extern int calc_poly_main();
+extern int calc_poly_main(int argc, char *argv[]);
+
+/**
+ * Argumenty wywołania kalkulatora bez opcji.
+ **/
+static char *no_args[] = {"calc_poly", NULL};
 
 /**
  * Funkcja wołana przed każdym testem korzystającym z stdout lub stderr.
@@ -108,6 +121,48 @@ int mock_printf(const char *format, ...) {
 	return return_value;
 }
 
+/** Blokada alokatora cmocki, z którego korzystają też wątki robocze. */
+static pthread_mutex_t alloc_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Atrapa funkcji calloc przekazująca wywołanie cmocce pod blokadą.
+ **/
+void *mock_calloc(size_t number_of_elements, size_t size, const char *file, int line) {
+	pthread_mutex_lock(&alloc_lock);
+	void *ptr = _test_calloc(number_of_elements, size, file, line);
+	pthread_mutex_unlock(&alloc_lock);
+	return ptr;
+}
+
+/**
+ * Atrapa funkcji malloc przekazująca wywołanie cmocce pod blokadą.
+ **/
+void *mock_malloc(const size_t size, const char *file, const int line) {
+	pthread_mutex_lock(&alloc_lock);
+	void *ptr = _test_malloc(size, file, line);
+	pthread_mutex_unlock(&alloc_lock);
+	return ptr;
+}
+
+/**
+ * Atrapa funkcji realloc przekazująca wywołanie cmocce pod blokadą.
+ **/
+void *mock_realloc(void *ptr, const size_t size, const char *file, const int line) {
+	pthread_mutex_lock(&alloc_lock);
+	void *result = _test_realloc(ptr, size, file, line);
+	pthread_mutex_unlock(&alloc_lock);
+	return result;
+}
+
+/**
+ * Atrapa funkcji free przekazująca wywołanie cmocce pod blokadą.
+ **/
+void mock_free(void *const ptr, const char *file, const int line) {
+	pthread_mutex_lock(&alloc_lock);
+	_test_free(ptr, file, line);
+	pthread_mutex_unlock(&alloc_lock);
+}
+
 /**
  * Funkcja inicjująca dane wejściowe dla programu korzystającego ze stdin.
  **/
@@ -129,6 +184,7 @@ static void test_PolyCompose(void **state) {
 	
 	assert_true(PolyIsEq(&p, &result));
 	PolyDestroy(&result);
+	ScratchRelease();
 }
 
 static void test_PolyCompose2(void **state) {
@@ -142,6 +198,7 @@ static void test_PolyCompose2(void **state) {
 	
 	assert_true(PolyIsEq(&p, &result));
 	PolyDestroy(&result);
+	ScratchRelease();
 }
 
 static void test_PolyCompose3(void **state) {
@@ -153,6 +210,7 @@ static void test_PolyCompose3(void **state) {
 	
 	assert_true(PolyIsEq(&p, &result));
 	PolyDestroy(&result);
+	ScratchRelease();
 }
 
 static void test_PolyCompose4(void **state) {
@@ -166,6 +224,7 @@ static void test_PolyCompose4(void **state) {
 	
 	assert_true(PolyIsEq(&p, &result));
 	PolyDestroy(&result);
+	ScratchRelease();
 }
 
 static void test_PolyCompose5(void **state) {
@@ -186,6 +245,7 @@ static void test_PolyCompose5(void **state) {
 	PolyDestroy(&p);
 	PolyDestroy(&result);
 	PolyDestroy(&result2);
+	ScratchRelease();
 }
 
 static void test_PolyCompose6(void ** state) {
@@ -207,6 +267,7 @@ static void test_PolyCompose6(void ** state) {
 	PolyDestroy(&p);
 	PolyDestroy(&result);
 	PolyDestroy(&result2);
+	ScratchRelease();
 }
 
 static void test_PolyCompose7(void ** state) {
@@ -231,12 +292,48 @@ static void test_PolyCompose7(void ** state) {
 	PolyDestroy(&x[0]);
 	PolyDestroy(&result);
 	PolyDestroy(&result2);
+	ScratchRelease();
+}
+
+static void test_PolyCompose8(void ** state) {
+	(void)state;
+	poly_coeff_t coefs[] = {3, 5, 2};
+	poly_exp_t exps[] = {2, 3, 7};
+	Poly tmp = PolyFromCoeff(3);
+	Poly tmp2 = PolyFromCoeff(5);
+	Poly tmp3 = PolyFromCoeff(2);
+	Poly tmp4 = PolyFromCoeff(2);
+	Poly tmp5 = PolyFromCoeff(1);
+	Mono mono[] = {MonoFromPoly(&tmp, 2), MonoFromPoly(&tmp2, 3), MonoFromPoly(&tmp3, 7)};
+	Mono mono2[] = {MonoFromPoly(&tmp4, 1), MonoFromPoly(&tmp5, 0)};
+	Poly p = PolyAddMonos(3, mono);
+	Poly x[] = {PolyAddMonos(2, mono2)};
+
+	Poly result = PolyCompose(&p, 1, x);
+	Poly result2 = PolyZero();
+	for (int i = 0 ; i < 3 ; i++) {
+		Poly power = PolyExp(&x[0], exps[i]);
+		Poly coef = PolyFromCoeff(coefs[i]);
+		Poly term = PolyMul(&power, &coef);
+		Poly sum = PolyAdd(&result2, &term);
+		PolyDestroy(&power);
+		PolyDestroy(&term);
+		PolyDestroy(&result2);
+		result2 = sum;
+	}
+
+	assert_true(PolyIsEq(&result2, &result));
+	PolyDestroy(&p);
+	PolyDestroy(&x[0]);
+	PolyDestroy(&result);
+	PolyDestroy(&result2);
+	ScratchRelease();
 }
 
 static void test_no_parameter(void **state) {
 	(void)state;
 	init_input_stream("COMPOSE\n");
-	assert_int_equal(calc_poly_main(), 0);
+	assert_int_equal(calc_poly_main(1, no_args), 0);
 	assert_string_equal(printf_buffer, "");
 	assert_string_equal(fprintf_buffer, "ERROR 1 WRONG COUNT\n");
 
@@ -245,7 +342,7 @@ static void test_no_parameter(void **state) {
 static void test_min_parameter(void **state) {
 	(void)state;
 	init_input_stream("(3,3)\nCOMPOSE 0\nPRINT\n");
-	assert_int_equal(calc_poly_main(), 0);
+	assert_int_equal(calc_poly_main(1, no_args), 0);
 	assert_string_equal(printf_buffer, "0\n");
 	assert_string_equal(fprintf_buffer, "");
 }
@@ -255,7 +352,7 @@ static void test_max_unsigned_parameter(void ** state) {
 	char in[MAX_INT_LENGTH];
        	sprintf(in, "%s%u%c", "COMPOSE ",INT_MAX, '\n');
 	init_input_stream(in);
-	assert_int_equal(calc_poly_main(), 0);
+	assert_int_equal(calc_poly_main(1, no_args), 0);
 	assert_string_equal(printf_buffer, "");
 	assert_string_equal(fprintf_buffer, "ERROR 1 STACK UNDERFLOW\n");
 }
@@ -266,7 +363,7 @@ static void test_max_unsigned_plus_one_parameter(void ** state) {
 	char in[MAX_INT_LENGTH];
        	sprintf(in, "%s%li%c", "COMPOSE ",(long)INT_MAX + 1, '\n');
 	init_input_stream(in);
-	assert_int_equal(calc_poly_main(), 0);
+	assert_int_equal(calc_poly_main(1, no_args), 0);
 	assert_string_equal(printf_buffer, "");
 	assert_string_equal(fprintf_buffer, "ERROR 1 STACK UNDERFLOW\n");
 }
@@ -277,7 +374,7 @@ static void test_much_more_than_unsigned_parameter(void ** state) {
 	char in[MAX_INT_LENGTH];
        	sprintf(in, "%s%li%c", "COMPOSE ", LONG_MAX, '\n');
 	init_input_stream(in);
-	assert_int_equal(calc_poly_main(), 0);
+	assert_int_equal(calc_poly_main(1, no_args), 0);
 	assert_string_equal(printf_buffer, "");
 	assert_string_equal(fprintf_buffer, "ERROR 1 WRONG COUNT\n");
 }
@@ -285,7 +382,7 @@ static void test_much_more_than_unsigned_parameter(void ** state) {
 static void test_letter_parameter(void **state) {
 	(void)state;
 	init_input_stream("COMPOSE asasf\n");
-	assert_int_equal(calc_poly_main(), 0);
+	assert_int_equal(calc_poly_main(1, no_args), 0);
 	assert_string_equal(printf_buffer, "");
 	assert_string_equal(fprintf_buffer, "ERROR 1 WRONG COUNT\n");
 }
@@ -294,11 +391,624 @@ static void test_letter_parameter(void **state) {
 static void test_numb_letter_parameter(void **state) {
 	(void)state;
 	init_input_stream("COMPOSE 898asasf\n");
-	assert_int_equal(calc_poly_main(), 0);
+	assert_int_equal(calc_poly_main(1, no_args), 0);
 	assert_string_equal(printf_buffer, "");
 	assert_string_equal(fprintf_buffer, "ERROR 1 WRONG COUNT\n");
 }
 
+static void test_PolyBuilder(void **state) {
+	(void)state;
+	PolyBuilder builder = PolyBuilderNew(0);
+	for (int i = 0 ; i < 64 ; i++) {
+		Poly coef = PolyFromCoeff(i % 2 == 0 ? 2 : -1);
+		Mono mono = MonoFromPoly(&coef, (i / 2 * 37) % 300 + 1);
+		PolyBuilderPush(&builder, &mono);
+	}
+	Poly coef = PolyFromCoeff(-1);
+	Mono mono = MonoFromPoly(&coef, 1);
+	PolyBuilderPush(&builder, &mono);
+	coef = PolyFromCoeff(5);
+	mono = MonoFromPoly(&coef, 0);
+	PolyBuilderPush(&builder, &mono);
+
+	Poly result = PolyBuilderFinish(&builder);
+
+	assert_int_equal(result.coef, 5);
+	int count = 0;
+	poly_exp_t exp = 1;
+	for (List *l = result.monos ; l != NULL ; l = l->next, count++) {
+		assert_true(l->value.exp > exp);
+		assert_true(PolyIsCoeff(&(l->value.p)));
+		assert_int_equal(l->value.p.coef, 1);
+		exp = l->value.exp;
+	}
+	assert_int_equal(count, 31);
+	PolyDestroy(&result);
+	ScratchRelease();
+}
+
+static void test_DenseMul(void **state) {
+	(void)state;
+	Mono monosP[300], monosQ[100];
+	for (int i = 0 ; i < 300 ; i++) {
+		Poly coef = PolyFromCoeff(i + 1);
+		monosP[i] = MonoFromPoly(&coef, i);
+	}
+	for (int i = 0 ; i < 100 ; i++) {
+		Poly coef = PolyFromCoeff(i % 7 - 3);
+		monosQ[i] = MonoFromPoly(&coef, i);
+	}
+	Poly p = PolyAddMonos(300, monosP);
+	Poly q = PolyAddMonos(100, monosQ);
+	Poly result = PolyMul(&p, &q);
+
+	long expected[399] = {0};
+	for (int i = 0 ; i < 300 ; i++)
+		for (int j = 0 ; j < 100 ; j++)
+			expected[i + j] += (i + 1) * (j % 7 - 3);
+	assert_int_equal(result.coef, expected[0]);
+	int exp = 1;
+	for (List *l = result.monos ; l != NULL ; l = l->next, exp++) {
+		while (expected[exp] == 0)
+			exp++;
+		assert_int_equal(l->value.exp, exp);
+		assert_true(PolyIsCoeff(&(l->value.p)));
+		assert_int_equal(l->value.p.coef, expected[exp]);
+	}
+	assert_int_equal(exp, 399);
+	Poly value = PolyAt(&result, -1);
+	Poly valueP = PolyAt(&p, -1);
+	Poly valueQ = PolyAt(&q, -1);
+	assert_int_equal(value.coef, valueP.coef * valueQ.coef);
+	PolyDestroy(&p);
+	PolyDestroy(&q);
+	PolyDestroy(&result);
+	ScratchRelease();
+}
+
+static void test_PolyExp(void **state) {
+	(void)state;
+	Poly x = PolyFromCoeff(1);
+	Mono monoX = MonoFromPoly(&x, 1);
+	Poly y = PolyAddMonos(1, &monoX);
+	Poly c = PolyFromCoeff(3);
+	Mono monos[] = {MonoFromPoly(&y, 0), MonoFromPoly(&c, 2), MonoFromPoly(&x, 5)};
+	x = PolyFromCoeff(1);
+	Poly p = PolyAddMonos(3, monos);
+
+	Poly square = PolySqr(&p);
+	Poly product = PolyMul(&p, &p);
+	assert_true(PolyIsEq(&square, &product));
+	PolyDestroy(&product);
+	product = PolyMul(&square, &p);
+	Poly power = PolyExp(&p, 3);
+	assert_true(PolyIsEq(&power, &product));
+	PolyDestroy(&square);
+	PolyDestroy(&product);
+	PolyDestroy(&power);
+	PolyDestroy(&p);
+
+	Poly one = PolyFromCoeff(1);
+	Mono binomial[] = {MonoFromPoly(&one, 0), MonoFromPoly(&x, 1)};
+	p = PolyAddMonos(2, binomial);
+	power = PolyExp(&p, 10);
+	long expected = 1;
+	assert_int_equal(power.coef, 1);
+	int exp = 1;
+	for (List *l = power.monos ; l != NULL ; l = l->next, exp++) {
+		expected = expected * (11 - exp) / exp;
+		assert_int_equal(l->value.exp, exp);
+		assert_int_equal(l->value.p.coef, expected);
+	}
+	assert_int_equal(exp, 11);
+	PolyDestroy(&power);
+	PolyDestroy(&p);
+	ScratchRelease();
+}
+
+static void test_ShallowMul(void **state) {
+	(void)state;
+	Poly one = PolyFromCoeff(1);
+	Mono monoY = MonoFromPoly(&one, 1);
+	Poly y = PolyAddMonos(1, &monoY);
+	Poly minusY = PolyNeg(&y);
+	Mono sum[] = {MonoFromPoly(&y, 0), MonoFromPoly(&one, 1)};
+	Mono difference[] = {MonoFromPoly(&minusY, 0), MonoFromPoly(&one, 1)};
+	Poly p = PolyAddMonos(2, sum);
+	Poly q = PolyAddMonos(2, difference);
+	assert_int_equal(PolyDepth(&p), 2);
+
+	Poly product = PolyMul(&p, &q);
+	Poly minusY2 = PolyFromCoeff(-1);
+	Mono monoY2 = MonoFromPoly(&minusY2, 2);
+	Poly y2 = PolyAddMonos(1, &monoY2);
+	Mono squares[] = {MonoFromPoly(&y2, 0), MonoFromPoly(&one, 2)};
+	Poly expected = PolyAddMonos(2, squares);
+	assert_true(PolyIsEq(&product, &expected));
+	assert_int_equal(product.coef, 0);
+	assert_int_equal(product.monos->value.exp, 0);
+	assert_int_equal(product.monos->value.depth, 2);
+
+	Poly value = PolyAt(&product, 3);
+	assert_int_equal(value.coef, 9);
+	assert_int_equal(value.monos->value.exp, 2);
+	assert_int_equal(value.monos->value.p.coef, -1);
+	assert_null(value.monos->next);
+
+	Poly t = PolyFromCoeff(-1);
+	Poly square = PolyFromCoeff(1);
+	for (int level = 0 ; level < 3 ; level++) {
+		Mono monoT = MonoFromPoly(&t, level == 0 ? 1 << 21 : 0);
+		Mono monoSquare = MonoFromPoly(&square, level == 0 ? 1 << 22 : 0);
+		t = PolyAddMonos(1, &monoT);
+		square = PolyAddMonos(1, &monoSquare);
+	}
+	assert_int_equal(PolyDepth(&t), 3);
+	Poly general = PolyMul(&t, &t);
+	assert_true(PolyIsEq(&general, &square));
+	PolyDestroy(&general);
+	PolyDestroy(&square);
+	PolyDestroy(&t);
+	PolyDestroy(&value);
+	PolyDestroy(&expected);
+	PolyDestroy(&product);
+	PolyDestroy(&p);
+	PolyDestroy(&q);
+	ScratchRelease();
+}
+
+static void test_MulStrategy(void **state) {
+	(void)state;
+	Poly p = PolyFromCoeff(3);
+	Poly q = PolyFromCoeff(-2);
+	for (int level = 0 ; level < 5 ; level++) {
+		Poly p1 = PolyClone(&p), p2 = PolyClone(&p);
+		Poly q1 = PolyClone(&q), q2 = PolyClone(&q);
+		Mono monosP[] = {MonoFromPoly(&p, 0), MonoFromPoly(&p1, 2), MonoFromPoly(&p2, 5)};
+		Mono monosQ[] = {MonoFromPoly(&q, 1), MonoFromPoly(&q1, 3), MonoFromPoly(&q2, 4)};
+		p = PolyAddMonos(3, monosP);
+		q = PolyAddMonos(3, monosQ);
+	}
+	Poly expected = PolyMul(&p, &q);
+	for (MulStrategy strategy = MUL_SCHOOLBOOK ; strategy <= MUL_HASH ; strategy++) {
+		PolyMulSetStrategy(strategy);
+		assert_int_equal(PolyMulGetStrategy(), strategy);
+		Poly product = PolyMul(&p, &q);
+		assert_true(PolyIsEq(&product, &expected));
+		PolyDestroy(&product);
+	}
+	PolyMulSetStrategy(MUL_AUTO);
+	PolyDestroy(&expected);
+	PolyDestroy(&p);
+	PolyDestroy(&q);
+	ScratchRelease();
+}
+
+static void test_PolyMulTrunc(void **state) {
+	(void)state;
+	Poly one = PolyFromCoeff(1);
+	Poly two = PolyFromCoeff(2);
+	Poly inner = PolyFromCoeff(1);
+	Mono monosY[] = {MonoFromPoly(&one, 0), MonoFromPoly(&inner, 1)};
+	Poly y = PolyAddMonos(2, monosY);
+	Poly x = PolyFromCoeff(3);
+	Mono monosP[] = {MonoFromPoly(&two, 0), MonoFromPoly(&y, 1), MonoFromPoly(&x, 2)};
+	Poly p = PolyAddMonos(3, monosP);
+	Poly full = PolyMul(&p, &p);
+	Poly same = PolyMulTrunc(&p, &p, PolyDeg(&full));
+	assert_true(PolyIsEq(&same, &full));
+	for (poly_exp_t d = -1 ; d < PolyDeg(&full) ; d++) {
+		Poly truncated = PolyMulTrunc(&p, &p, d);
+		Poly power = PolyExpTrunc(&p, 2, d);
+		assert_true(PolyDeg(&truncated) <= d);
+		assert_true(PolyIsEq(&truncated, &power));
+		Poly rest = PolySub(&full, &truncated);
+		Poly unit = PolyFromCoeff(1);
+		Poly lower = PolyMulTrunc(&rest, &unit, d);
+		assert_true(PolyIsZero(&lower));
+		PolyDestroy(&lower);
+		PolyDestroy(&rest);
+		PolyDestroy(&power);
+		PolyDestroy(&truncated);
+	}
+	PolyDestroy(&same);
+	PolyDestroy(&full);
+	PolyDestroy(&p);
+	ScratchRelease();
+}
+
+static void test_PolyMulChecked(void **state) {
+	(void)state;
+	Poly big = PolyFromCoeff((poly_coeff_t)1 << 62);
+	Poly minusOne = PolyFromCoeff(-1);
+	Mono monos[] = {MonoFromPoly(&big, 1), MonoFromPoly(&minusOne, 0)};
+	Poly p = PolyAddMonos(2, monos);
+	Poly result;
+	assert_true(PolyMulChecked(&p, &minusOne, &result));
+	Poly expected = PolyNeg(&p);
+	assert_true(PolyIsEq(&result, &expected));
+	PolyDestroy(&result);
+	PolyDestroy(&expected);
+
+	Poly two = PolyFromCoeff(2);
+	assert_false(PolyMulChecked(&p, &two, &result));
+	expected = PolyMul(&p, &two);
+	assert_true(PolyIsEq(&result, &expected));
+	PolyDestroy(&result);
+	PolyDestroy(&expected);
+
+	Poly deep = PolyFromCoeff((poly_coeff_t)1 << 40);
+	for (int level = 0 ; level < 5 ; level++) {
+		Mono mono = MonoFromPoly(&deep, 1);
+		deep = PolyAddMonos(1, &mono);
+	}
+	assert_false(PolyMulChecked(&deep, &deep, &result));
+	expected = PolyMul(&deep, &deep);
+	assert_true(PolyIsEq(&result, &expected));
+	PolyDestroy(&result);
+	PolyDestroy(&expected);
+	assert_true(PolyMulChecked(&deep, &minusOne, &result));
+	expected = PolyNeg(&deep);
+	assert_true(PolyIsEq(&result, &expected));
+	PolyDestroy(&result);
+	PolyDestroy(&expected);
+	PolyDestroy(&deep);
+	PolyDestroy(&p);
+	ScratchRelease();
+}
+
+static void test_PolyProbablyEq(void **state) {
+	(void)state;
+	PolyProbableSeed(0x2545f4914f6cdd1du);
+	Poly x = PolyFromCoeff(1);
+	Poly c = PolyFromCoeff(3);
+	Mono monos[] = {MonoFromPoly(&x, 1), MonoFromPoly(&c, 0)};
+	Poly p = PolyAddMonos(2, monos);
+	Poly square = PolyMul(&p, &p);
+	Poly power = PolyExp(&p, 2);
+	assert_true(PolyProbablyEq(&square, &power, 4));
+	Poly shift = PolyFromCoeff(2305843009213693951L);
+	Poly shifted = PolyAdd(&square, &shift);
+	assert_false(PolyIsEq(&square, &shifted));
+	assert_false(PolyProbablyEq(&square, &shifted, 1));
+	assert_false(PolyProbablyEq(&square, &p, 1));
+	PolyDestroy(&shifted);
+	PolyDestroy(&power);
+	PolyDestroy(&square);
+	PolyDestroy(&p);
+	ScratchRelease();
+}
+
+static void test_PolyMultiAt(void **state) {
+	(void)state;
+	PolyBuilder builder = PolyBuilderNew(0);
+	for (poly_exp_t e = 0 ; e < 300 ; e++) {
+		Poly c = PolyFromCoeff((poly_coeff_t)(e * 7919 % 101) - 50);
+		Mono m = MonoFromPoly(&c, e);
+		PolyBuilderPush(&builder, &m);
+	}
+	Poly p = PolyBuilderFinish(&builder);
+	poly_coeff_t x[200];
+	Poly values[200];
+	for (int i = 0 ; i < 200 ; i++)
+		x[i] = (poly_coeff_t)((uint64_t)i * 6364136223846793005u - 3u);
+	x[1] = x[0];
+	PolyMultiAt(&p, 200, x, values);
+	for (int i = 0 ; i < 200 ; i++) {
+		Poly expected = PolyAt(&p, x[i]);
+		assert_true(PolyIsEq(&(values[i]), &expected));
+		PolyDestroy(&expected);
+		PolyDestroy(&(values[i]));
+	}
+	Poly c = PolyFromCoeff(2);
+	Mono m = MonoFromPoly(&p, 1);
+	Mono monos[] = {m, MonoFromPoly(&c, 0)};
+	Poly q = PolyAddMonos(2, monos);
+	PolyMultiAt(&q, 3, x, values);
+	for (int i = 0 ; i < 3 ; i++) {
+		Poly expected = PolyAt(&q, x[i]);
+		assert_true(PolyIsEq(&(values[i]), &expected));
+		PolyDestroy(&expected);
+		PolyDestroy(&(values[i]));
+	}
+	PolyDestroy(&q);
+	ScratchRelease();
+}
+
+static void test_Spill(void **state) {
+	(void)state;
+	Poly x = PolyFromCoeff(1);
+	Mono m = MonoFromPoly(&x, 1);
+	Poly inner = PolyAddMonos(1, &m);
+	Poly two = PolyFromCoeff(2);
+	Mono monos[] = {MonoFromPoly(&inner, 3), MonoFromPoly(&two, 0)};
+	Poly base = PolyAddMonos(2, monos);
+	Poly p = PolyExp(&base, 6);
+	PackedPoly packed = PackedFromPoly(&p);
+	PackedPoly zero = PackedZero();
+	SpillHandle *h = SpillStore(&packed);
+	SpillHandle *empty = SpillStore(&zero);
+	assert_true(h != NULL && empty != NULL);
+	assert_true(SpillBytes() > packed.size * sizeof(uint64_t));
+	PackedPoly view = SpillView(h);
+	assert_true(PackedIsEq(&view, &packed));
+	Poly back = PackedToPoly(&view);
+	assert_true(PolyIsEq(&back, &p));
+	view = SpillView(empty);
+	assert_true(PackedIsZero(&view));
+	SpillFree(h);
+	SpillFree(empty);
+	assert_int_equal(SpillBytes(), 0);
+	SpillStop();
+	PolyDestroy(&back);
+	PackedDestroy(&packed);
+	PolyDestroy(&p);
+	PolyDestroy(&base);
+	ScratchRelease();
+}
+
+static void test_Budget(void **state) {
+	(void)state;
+	Mono monos[50];
+	for (int i = 0 ; i < 50 ; i++) {
+		Poly one = PolyFromCoeff(1);
+		monos[i] = MonoFromPoly(&one, i);
+	}
+	Poly p = PolyAddMonos(50, monos);
+	Poly one = PolyFromCoeff(1);
+	Poly x = PolyFromCoeff(1);
+	Mono shift[] = {MonoFromPoly(&one, 0), MonoFromPoly(&x, 1)};
+	Poly q = PolyAddMonos(2, shift);
+	Poly expected = PolyMul(&p, &p);
+	assert_int_equal(PolyNodes(&expected), 98);
+	BudgetCost cost = BudgetMulCost(&p, &p);
+	assert_int_equal(cost.terms, 99);
+	assert_int_equal(cost.bytes, 99 * sizeof(List));
+	cost = BudgetExpCost(&p, 2);
+	assert_int_equal(cost.terms, 99);
+	cost = BudgetExpCost(&p, 0);
+	assert_int_equal(cost.terms, 0);
+	Poly composed = PolyCompose(&p, 1, &q);
+	cost = BudgetComposeCost(&p, 1, &q);
+	assert_true(cost.terms >= PolyNodes(&composed));
+	/* Iloczyn ma więcej jednomianów na wyraz niż czynniki. */
+	Poly y = PolyFromCoeff(1);
+	Mono my = MonoFromPoly(&y, 1);
+	Poly inner = PolyAddMonos(1, &my);
+	Mono mxy = MonoFromPoly(&inner, 1);
+	Poly xy = PolyAddMonos(1, &mxy);
+	Poly product = PolyMul(&xy, &q);
+	assert_int_equal(PolyNodes(&product), 4);
+	cost = BudgetMulCost(&xy, &q);
+	assert_int_equal(cost.terms, 4);
+	Poly sum = PolyAdd(&product, &q);
+	Poly power = PolyExp(&sum, 3);
+	cost = BudgetExpCost(&sum, 3);
+	assert_true(cost.terms >= PolyNodes(&power));
+	Poly substitutes[] = {sum, xy};
+	Poly substituted = PolyCompose(&power, 2, substitutes);
+	cost = BudgetComposeCost(&power, 2, substitutes);
+	assert_true(cost.terms >= PolyNodes(&substituted));
+	PolyDestroy(&substituted);
+	PolyDestroy(&power);
+	PolyDestroy(&sum);
+	PolyDestroy(&product);
+	PolyDestroy(&xy);
+	assert_false(BudgetStop());
+	Budget tight = {.terms = 10, .bytes = 0, .ms = 0};
+	BudgetStart(&tight);
+	Poly result = PolyMul(&p, &p);
+	assert_true(BudgetStop());
+	PolyDestroy(&result);
+	Budget wide = {.terms = 1000, .bytes = 0, .ms = 0};
+	BudgetStart(&wide);
+	result = PolyMul(&p, &p);
+	assert_false(BudgetStop());
+	assert_true(PolyIsEq(&result, &expected));
+	PolyDestroy(&result);
+	Budget small = {.terms = 0, .bytes = 10 * sizeof(List), .ms = 0};
+	BudgetStart(&small);
+	result = PolyCompose(&p, 1, &q);
+	assert_true(BudgetStop());
+	PolyDestroy(&result);
+	PolyDestroy(&composed);
+	PolyDestroy(&expected);
+	PolyDestroy(&p);
+	PolyDestroy(&q);
+	ScratchRelease();
+}
+
+static void test_PolyContext(void **state) {
+	(void)state;
+	Poly one = PolyFromCoeff(1);
+	Poly two = PolyFromCoeff(2);
+	Mono monos[] = {MonoFromPoly(&one, 1), MonoFromPoly(&two, 0)};
+	Poly p = PolyAddMonos(2, monos);
+	Poly expected = PolyExp(&p, 5);
+	PolyContext *ctx = PolyContextNew();
+	assert_int_equal(PolyContextBytes(ctx), 0);
+	Poly square = PolyMulCtx(ctx, &p, &p);
+	Poly power = PolyMulCtx(ctx, &square, &square);
+	Poly result = PolyMulCtx(ctx, &power, &p);
+	assert_true(PolyIsEq(&result, &expected));
+	Poly at = PolyAtCtx(ctx, &result, -2);
+	assert_true(PolyIsZero(&at));
+	assert_true(PolyContextBytes(ctx) > 0);
+	PolyContextReset(ctx);
+	assert_int_equal(PolyContextBytes(ctx), 0);
+	Poly clone = PolyCloneCtx(ctx, &expected);
+	assert_true(PolyIsEq(&clone, &expected));
+	PolyContextDestroy(ctx);
+	PolyDestroy(&expected);
+	PolyDestroy(&p);
+	ScratchRelease();
+}
+
+static void test_scratch(void **state) {
+	(void)state;
+	ScratchMark outer = ScratchSave();
+	char *a = (char *)ScratchAlloc(100);
+	a[0] = 'a';
+	char *grown = (char *)ScratchGrow(a, 100, 1000);
+	assert_true(grown == a);
+	ScratchMark inner = ScratchSave();
+	char *b = (char *)ScratchAlloc(1 << 20);
+	b[(1 << 20) - 1] = 'b';
+	assert_true(ScratchBytes() >= (1 << 20));
+	ScratchRestore(inner);
+	char *c = (char *)ScratchAlloc(10);
+	grown = (char *)ScratchGrow(a, 1000, 2000);
+	assert_true(grown != a && grown != c);
+	assert_int_equal(grown[0], 'a');
+	ScratchRestore(outer);
+	assert_true(ScratchBytes() >= (1 << 20));
+	ScratchRelease();
+	assert_int_equal(ScratchBytes(), 0);
+}
+
+static void test_ring(void **state) {
+	(void)state;
+	Ring r;
+	int values[6];
+	void *item;
+	RingInit(&r, 4);
+	assert_false(RingTryPop(&r, &item));
+	for (int round = 0 ; round < 2 ; round++) {
+		for (int i = 0 ; i < 4 ; i++)
+			assert_true(RingTryPush(&r, &values[i + round]));
+		assert_false(RingTryPush(&r, &values[5]));
+		for (int i = 0 ; i < 3 ; i++)
+			assert_true(RingPop(&r) == &values[i + round]);
+		RingPush(&r, NULL);
+		assert_true(RingTryPop(&r, &item));
+		assert_true(item == &values[3 + round]);
+		assert_true(RingPop(&r) == NULL);
+	}
+	assert_false(RingTryPop(&r, &item));
+	RingDestroy(&r);
+}
+
+static void test_libpoly(void **state) {
+	(void)state;
+	const char *texts[] = {"(1,1)+(2,0)", "((1,2),1)", "(1,1)(1,2)"};
+	LibPoly *polys[3];
+	assert_int_equal(LibPolyParseBatch(3, texts, polys), 2);
+	assert_true(polys[2] == NULL);
+	int ops[] = {LIBPOLY_MUL, LIBPOLY_ADD, LIBPOLY_AT, LIBPOLY_DEG, LIBPOLY_IS_EQ, LIBPOLY_EXP};
+	const LibPoly *p[] = {polys[0], polys[0], polys[0], polys[1], polys[0], polys[0]};
+	const LibPoly *q[] = {polys[0], polys[1], NULL, NULL, polys[1], NULL};
+	long args[] = {0, 0, -2, 0, 0, 2};
+	LibPoly *results[6];
+	long values[6];
+	assert_int_equal(LibPolyRun(6, ops, p, q, args, results, values), 6);
+	char buffer[64];
+	assert_int_equal(LibPolyFormat(results[0], buffer, sizeof(buffer)), 17);
+	assert_string_equal(buffer, "(4,0)+(4,1)+(1,2)");
+	LibPolyFormat(results[1], buffer, sizeof(buffer));
+	assert_string_equal(buffer, "(2,0)+((1,0)+(1,2),1)");
+	LibPolyFormat(results[2], buffer, sizeof(buffer));
+	assert_string_equal(buffer, "0");
+	assert_true(results[3] == NULL);
+	assert_int_equal(values[3], 3);
+	assert_int_equal(values[4], 0);
+	assert_true(results[4] == NULL);
+	LibPolyFormat(results[5], buffer, sizeof(buffer));
+	assert_string_equal(buffer, "(4,0)+(4,1)+(1,2)");
+	assert_int_equal(LibPolyFormat(results[0], buffer, 6), 17);
+	assert_string_equal(buffer, "(4,0)");
+	ops[0] = LIBPOLY_DEG_BY;
+	assert_int_equal(LibPolyRun(1, ops, p, q, NULL, results + 3, values), 0);
+	LibPolyFreeBatch(6, results);
+	LibPolyFreeBatch(3, polys);
+	ScratchRelease();
+}
+
+static void test_packed(void **state) {
+	(void)state;
+	char *args[] = {"calc_poly", "--engine=packed", NULL};
+	init_input_stream("((1,2),1)+(-1,0)\n(((1,300),1),1)+(1,1)\nCLONE\nMUL\nADD\nDEG_BY 1\nAT 2\nPRINT\nZERO\nIS_ZERO\n");
+	assert_int_equal(calc_poly_main(2, args), 0);
+	assert_string_equal(printf_buffer, "2\n(3,0)+((8,300),1)+((2,0)+(4,600),2)\n1\n");
+	assert_string_equal(fprintf_buffer, "");
+}
+
+static void test_stats(void **state) {
+	(void)state;
+	init_input_stream("ZERO\nZERO\nSTATS\n");
+	assert_int_equal(calc_poly_main(1, no_args), 0);
+	assert_true(strncmp(printf_buffer, "STATS ZERO count=2 ", strlen("STATS ZERO count=2 ")) == 0);
+	assert_true(strstr(printf_buffer, " terms_in=0 terms_out=0\n") != NULL);
+	assert_true(strstr(printf_buffer, "STATS STATS") == NULL);
+	assert_string_equal(fprintf_buffer, "");
+}
+
+static void test_memory(void **state) {
+	(void)state;
+	init_input_stream("(1,1)\n((1,1),2)\nMEMORY 1\nMEMORY x\n");
+	assert_int_equal(calc_poly_main(1, no_args), 0);
+	assert_true(strncmp(printf_buffer, "MEMORY live_bytes=", strlen("MEMORY live_bytes=")) == 0);
+	assert_true(strstr(printf_buffer, " stack=2\nMEMORY TOP 1 slot=0 ") != NULL);
+	assert_true(strstr(printf_buffer, " nodes=3\n") != NULL);
+	assert_true(strstr(printf_buffer, "MEMORY TOP 2") == NULL);
+	assert_string_equal(fprintf_buffer, "ERROR 4 WRONG COUNT\n");
+}
+
+static void test_cache(void **state) {
+	(void)state;
+	init_input_stream("(1,1)\nCLONE\nCACHE 100000\nMUL\n(1,1)\nCLONE\nMUL\nIS_EQ\nCACHE\nCACHE CLEAR\nCACHE\nCACHE x\n");
+	assert_int_equal(calc_poly_main(1, no_args), 0);
+	assert_true(strncmp(printf_buffer, "1\nCACHE limit_bytes=100000 bytes=", strlen("1\nCACHE limit_bytes=100000 bytes=")) == 0);
+	assert_true(strstr(printf_buffer, " entries=1 hits=1 misses=1\n") != NULL);
+	assert_true(strstr(printf_buffer, "\nCACHE limit_bytes=100000 bytes=0 entries=0 hits=0 misses=0\n") != NULL);
+	assert_string_equal(fprintf_buffer, "ERROR 12 WRONG VALUE\n");
+}
+
+static void test_registers(void **state) {
+	(void)state;
+	init_input_stream("(1,1)\nSTORE x\nLOAD x\nLOAD x\nMUL\nSTORE x\nLOAD x\nDROP x\nPRINT\nLOAD x\nSTORE\n");
+	assert_int_equal(calc_poly_main(1, no_args), 0);
+	assert_string_equal(printf_buffer, "(1,2)\n");
+	assert_string_equal(fprintf_buffer, "ERROR 10 WRONG NAME\nERROR 11 WRONG NAME\n");
+}
+
+static void test_parallel(void **state) {
+	(void)state;
+	const char *script = "(1,1)+(1,0)\nCLONE\nMUL\nCLONE\nMUL\n((1,2),1)+(3,0)\nCLONE\nADD\n"
+			"CLONE\nMUL\nPRINT\n(2,3)\nCLONE\nMUL\nADD\nPRINT\nMUL\nPRINT\nPOP\nADD\n"
+			"(1,4)+(5,0)\nCLONE\nMUL\nCLONE\nADD\nDEG\nPRINT\n";
+	char *args[] = {"calc_poly", "--parallel", "2", NULL};
+	static char out[sizeof(printf_buffer)], err[sizeof(fprintf_buffer)];
+	init_input_stream(script);
+	assert_int_equal(calc_poly_main(1, no_args), 0);
+	memcpy(out, printf_buffer, sizeof(out));
+	memcpy(err, fprintf_buffer, sizeof(err));
+	assert_string_equal(err, "ERROR 20 STACK UNDERFLOW\n");
+	test_setup(NULL);
+	init_input_stream(script);
+	assert_int_equal(calc_poly_main(3, args), 0);
+	assert_string_equal(printf_buffer, out);
+	assert_string_equal(fprintf_buffer, err);
+}
+
+static void test_trace(void **state) {
+	(void)state;
+	char *args[] = {"calc_poly", "--trace", "test_trace.json", NULL};
+	char trace[MAX_TRACE_LENGTH] = {0};
+	init_input_stream("(1,1)\n(1,1)\nMUL\n");
+	assert_int_equal(calc_poly_main(3, args), 0);
+	FILE *file = fopen("test_trace.json", "r");
+	assert_non_null(file);
+	size_t length = fread(trace, 1, sizeof(trace) - 1, file);
+	fclose(file);
+	remove("test_trace.json");
+	assert_true(length > 0);
+	assert_true(strncmp(trace, "{\"traceEvents\":[", strlen("{\"traceEvents\":[")) == 0);
+	assert_true(strstr(trace, "{\"name\":\"MUL\",\"ph\":\"X\"") != NULL);
+	assert_true(strstr(trace, "\"args\":{\"line\":3}") != NULL);
+	assert_string_equal(printf_buffer, "");
+	assert_string_equal(fprintf_buffer, "");
+}
+
 int main() {
 	const struct CMUnitTest tests[] = {
 		cmocka_unit_test(test_PolyCompose),
@@ -308,13 +1018,36 @@ int main() {
 		cmocka_unit_test(test_PolyCompose5),
 		cmocka_unit_test(test_PolyCompose6),
 		cmocka_unit_test(test_PolyCompose7), 
+		cmocka_unit_test(test_PolyCompose8),
+		cmocka_unit_test(test_PolyBuilder),
+		cmocka_unit_test(test_DenseMul),
+		cmocka_unit_test(test_PolyExp),
+		cmocka_unit_test(test_ShallowMul),
+		cmocka_unit_test(test_PolyMulChecked),
+		cmocka_unit_test(test_MulStrategy),
+		cmocka_unit_test(test_PolyMulTrunc),
+		cmocka_unit_test(test_PolyProbablyEq),
+		cmocka_unit_test(test_PolyMultiAt),
+		cmocka_unit_test(test_Spill),
+		cmocka_unit_test(test_Budget),
+		cmocka_unit_test(test_PolyContext),
+		cmocka_unit_test(test_scratch),
+		cmocka_unit_test(test_ring),
+		cmocka_unit_test(test_libpoly),
+		cmocka_unit_test_setup(test_packed, test_setup),
 		cmocka_unit_test_setup(test_no_parameter, test_setup),
 		cmocka_unit_test_setup(test_min_parameter, test_setup),
 		cmocka_unit_test_setup(test_max_unsigned_parameter, test_setup),
 		cmocka_unit_test_setup(test_max_unsigned_plus_one_parameter, test_setup),
 		cmocka_unit_test_setup(test_much_more_than_unsigned_parameter, test_setup),
 		cmocka_unit_test_setup(test_letter_parameter, test_setup),
-		cmocka_unit_test_setup(test_numb_letter_parameter, test_setup)
+		cmocka_unit_test_setup(test_numb_letter_parameter, test_setup),
+		cmocka_unit_test_setup(test_stats, test_setup),
+		cmocka_unit_test_setup(test_memory, test_setup),
+		cmocka_unit_test_setup(test_cache, test_setup),
+		cmocka_unit_test_setup(test_registers, test_setup),
+		cmocka_unit_test_setup(test_parallel, test_setup),
+		cmocka_unit_test_setup(test_trace, test_setup)
 
 	};
 	return cmocka_run_group_tests(tests, NULL, NULL);
@@ -49,29 +49,31 @@ extern int mock_fprintf(FILE * const file, const char *format, ...);
 void mock_assert(const int result, const char* expression, const char *file,
                  const int line);
 
-/* Redirect calloc, malloc, realloc and free to _test_malloc, _test_calloc,
- * _test_realloc and _test_free, respectively, so cmocka can check for memory
- * leaks. */
+/* Redirect calloc, malloc, realloc and free to functions in the test
+ * application which call _test_calloc, _test_malloc, _test_realloc and
+ * _test_free, respectively, so cmocka can check for memory leaks. The
+ * wrappers serialize the calls, because cmocka's allocator is not thread-safe
+ * and worker threads allocate too. */
 #ifdef calloc
 #undef calloc
 #endif /* calloc */
-#define calloc(num, size) _test_calloc(num, size, __FILE__, __LINE__)
+#define calloc(num, size) mock_calloc(num, size, __FILE__, __LINE__)
 #ifdef malloc
 #undef malloc
 #endif /* malloc */
-#define malloc(size) _test_malloc(size, __FILE__, __LINE__)
+#define malloc(size) mock_malloc(size, __FILE__, __LINE__)
 #ifdef realloc
 #undef realloc
 #endif /* realloc */
-#define realloc(ptr, size) _test_realloc(ptr, size, __FILE__, __LINE__)
+#define realloc(ptr, size) mock_realloc(ptr, size, __FILE__, __LINE__)
 #ifdef free
 #undef free
 #endif /* free */
-#define free(ptr) _test_free(ptr, __FILE__, __LINE__)
-void* _test_calloc(size_t number_of_elements, size_t size, const char* file, int line);
-void* _test_malloc(const size_t size, const char* file, const int line);
-void* _test_realloc(void* ptr, const size_t size, const char* file, const int line);
-void _test_free(void* const ptr, const char* file, const int line);
+#define free(ptr) mock_free(ptr, __FILE__, __LINE__)
+void* mock_calloc(size_t number_of_elements, size_t size, const char* file, int line);
+void* mock_malloc(const size_t size, const char* file, const int line);
+void* mock_realloc(void* ptr, const size_t size, const char* file, const int line);
+void mock_free(void* const ptr, const char* file, const int line);
 
 /* Redirect scanf to a function in the test application so it's possible to
  * test the standard input. */
@@ -84,8 +86,8 @@ extern int mock_scanf(const char *format, ...);
 
 /* Function main is defined in the unit test so redefine name of the main
  * function here. */
-#define main() calc_poly_main()
-int calc_poly_main();
+#define main calc_poly_main
+int calc_poly_main(int argc, char *argv[]);
 
 /* All functions in this object need to be exposed to the test application,
  * so redefine static to nothing. Do not do it - it dangerous! */
@@ -93,4 +95,52 @@ int calc_poly_main();
 
 #endif /* UNIT_TESTING */
 
+/* If this is being built for the benchmarks. */
+#ifdef BENCHMARK
+
+#include <stdio.h>
+
+/* Redirect calloc, malloc and realloc to counting functions in the benchmark
+ * application so it's possible to report allocations per operation. */
+#ifdef calloc
+#undef calloc
+#endif /* calloc */
+#define calloc(num, size) bench_calloc(num, size)
+#ifdef malloc
+#undef malloc
+#endif /* malloc */
+#define malloc(size) bench_malloc(size)
+#ifdef realloc
+#undef realloc
+#endif /* realloc */
+#define realloc(ptr, size) bench_realloc(ptr, size)
+void* bench_calloc(size_t number_of_elements, size_t size);
+void* bench_malloc(size_t size);
+void* bench_realloc(void* ptr, size_t size);
+
+/* Redirect scanf, printf and fprintf to memory buffers in the benchmark
+ * application so it's possible to measure parsing and printing. */
+#ifdef scanf
+#undef scanf
+#endif /* scanf */
+#define scanf(...) bench_scanf(__VA_ARGS__)
+#ifdef printf
+#undef printf
+#endif /* printf */
+#define printf(...) bench_printf(__VA_ARGS__)
+#ifdef fprintf
+#undef fprintf
+#endif /* fprintf */
+#define fprintf(...) bench_fprintf(__VA_ARGS__)
+extern int bench_scanf(const char *format, ...);
+extern int bench_printf(const char *format, ...);
+extern int bench_fprintf(FILE * const file, const char *format, ...);
+
+/* Function main is defined in the benchmark so redefine name of the main
+ * function here. */
+#define main calc_poly_main
+int calc_poly_main(int argc, char *argv[]);
+
+#endif /* BENCHMARK */
+
 #endif /* UTILS_H*/